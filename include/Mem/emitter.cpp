@@ -0,0 +1,236 @@
+﻿#include "emitter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+	using mem::x86::Register;
+
+	// Recommended multi-byte NOPs, indexed by size
+	constexpr std::uint8_t nops[mem::x86::Emitter::maxNopSize + 1][mem::x86::Emitter::maxNopSize] =
+	{
+		{},
+		{ 0x90 },
+		{ 0x66, 0x90 },
+		{ 0x0F, 0x1F, 0x00 },
+		{ 0x0F, 0x1F, 0x40, 0x00 },
+		{ 0x0F, 0x1F, 0x44, 0x00, 0x00 },
+		{ 0x66, 0x0F, 0x1F, 0x44, 0x00, 0x00 },
+		{ 0x0F, 0x1F, 0x80, 0x00, 0x00, 0x00, 0x00 },
+		{ 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 },
+		{ 0x66, 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 },
+	};
+
+	constexpr std::uint8_t Low(const Register reg) { return static_cast<std::uint8_t>(reg) & 7; }
+	constexpr bool IsExtended(const Register reg) { return static_cast<std::uint8_t>(reg) >= 8; }
+
+	template<typename T>
+	std::uint8_t* Store(std::uint8_t* p, const T value)
+	{
+		memcpy(p, &value, sizeof(T));
+		return p + sizeof(T);
+	}
+}
+
+std::uint8_t* mem::x86::Emitter::Reserve(const size_t nSize) noexcept
+{
+	if (bFailed || buffer.size() - size < nSize)
+	{
+		bFailed = true;
+		return nullptr;
+	}
+	std::uint8_t* p = buffer.data() + size;
+	size += nSize;
+	return p;
+}
+
+bool mem::x86::Emitter::Displacement(const std::uintptr_t target, const size_t nSize, const size_t nBytes, std::int32_t& displacement) const noexcept
+{
+	const std::uintptr_t next = address + size + nSize;
+	// Outside long mode the address space wraps at 4 GB, rel32 reaches everything
+	const auto distance = bIs64 ? static_cast<std::int64_t>(target - next) : static_cast<std::int64_t>(static_cast<std::int32_t>(static_cast<std::uint32_t>(target - next)));
+	const std::int64_t limit = std::int64_t{ 1 } << (nBytes * 8 - 1);
+	if (distance < -limit || distance >= limit) return false;
+	displacement = static_cast<std::int32_t>(distance);
+	return true;
+}
+
+mem::x86::Emitter& mem::x86::Emitter::Jmp(const std::uintptr_t target)
+{
+	std::int32_t displacement;
+	if (Displacement(target, 2, 1, displacement))
+	{
+		if (std::uint8_t* p = Reserve(2))
+		{
+			p[0] = 0xEB;
+			p[1] = static_cast<std::uint8_t>(displacement);
+		}
+		return *this;
+	}
+	if (Displacement(target, relJmpSize, 4, displacement)) return JmpRel32(target);
+	return JmpAbsolute(target);
+}
+
+mem::x86::Emitter& mem::x86::Emitter::JmpRel32(const std::uintptr_t target)
+{
+	std::int32_t displacement;
+	if (!Displacement(target, relJmpSize, 4, displacement))
+	{
+		bFailed = true;
+		return *this;
+	}
+	if (std::uint8_t* p = Reserve(relJmpSize))
+	{
+		*p++ = 0xE9;
+		Store(p, displacement);
+	}
+	return *this;
+}
+
+mem::x86::Emitter& mem::x86::Emitter::JmpAbsolute(const std::uintptr_t target)
+{
+	if (!bIs64)
+	{
+		bFailed = true;
+		return *this;
+	}
+	if (std::uint8_t* p = Reserve(absJmpSize))
+	{
+		// jmp qword ptr [rip+0]
+		constexpr std::uint8_t jmp[] = { 0xFF, 0x25, 0x00, 0x00, 0x00, 0x00 };
+		memcpy(p, jmp, sizeof(jmp));
+		Store(p + sizeof(jmp), static_cast<std::uint64_t>(target));
+	}
+	return *this;
+}
+
+mem::x86::Emitter& mem::x86::Emitter::Call(const std::uintptr_t target)
+{
+	std::int32_t displacement;
+	if (Displacement(target, 5, 4, displacement))
+	{
+		if (std::uint8_t* p = Reserve(5))
+		{
+			*p++ = 0xE8;
+			Store(p, displacement);
+		}
+		return *this;
+	}
+
+	if (!bIs64)
+	{
+		bFailed = true;
+		return *this;
+	}
+	if (std::uint8_t* p = Reserve(16))
+	{
+		// call qword ptr [rip+2]; jmp +8; address
+		constexpr std::uint8_t call[] = { 0xFF, 0x15, 0x02, 0x00, 0x00, 0x00, 0xEB, 0x08 };
+		memcpy(p, call, sizeof(call));
+		Store(p + sizeof(call), static_cast<std::uint64_t>(target));
+	}
+	return *this;
+}
+
+mem::x86::Emitter& mem::x86::Emitter::Push(const Register reg)
+{
+	if (IsExtended(reg) && !bIs64)
+	{
+		bFailed = true;
+		return *this;
+	}
+	if (std::uint8_t* p = Reserve(IsExtended(reg) ? 2 : 1))
+	{
+		if (IsExtended(reg)) *p++ = 0x41;
+		*p = 0x50 + Low(reg);
+	}
+	return *this;
+}
+
+mem::x86::Emitter& mem::x86::Emitter::Pop(const Register reg)
+{
+	if (IsExtended(reg) && !bIs64)
+	{
+		bFailed = true;
+		return *this;
+	}
+	if (std::uint8_t* p = Reserve(IsExtended(reg) ? 2 : 1))
+	{
+		if (IsExtended(reg)) *p++ = 0x41;
+		*p = 0x58 + Low(reg);
+	}
+	return *this;
+}
+
+mem::x86::Emitter& mem::x86::Emitter::Mov(const Register reg, const std::uint64_t value)
+{
+	if (!bIs64 && (IsExtended(reg) || value > std::numeric_limits<std::uint32_t>::max()))
+	{
+		bFailed = true;
+		return *this;
+	}
+
+	// mov r32, imm32, the upper half zeroed
+	if (value <= std::numeric_limits<std::uint32_t>::max())
+	{
+		if (std::uint8_t* p = Reserve(IsExtended(reg) ? 6 : 5))
+		{
+			if (IsExtended(reg)) *p++ = 0x41;
+			*p++ = 0xB8 + Low(reg);
+			Store(p, static_cast<std::uint32_t>(value));
+		}
+		return *this;
+	}
+
+	const std::uint8_t rex = IsExtended(reg) ? 0x49 : 0x48;
+	// mov r/m64, imm32, sign extended
+	if (const auto signedValue = static_cast<std::int64_t>(value); signedValue >= std::numeric_limits<std::int32_t>::min() && signedValue < 0)
+	{
+		if (std::uint8_t* p = Reserve(7))
+		{
+			*p++ = rex;
+			*p++ = 0xC7;
+			*p++ = 0xC0 + Low(reg);
+			Store(p, static_cast<std::int32_t>(signedValue));
+		}
+		return *this;
+	}
+
+	// mov r64, imm64
+	if (std::uint8_t* p = Reserve(10))
+	{
+		*p++ = rex;
+		*p++ = 0xB8 + Low(reg);
+		Store(p, value);
+	}
+	return *this;
+}
+
+mem::x86::Emitter& mem::x86::Emitter::Ret()
+{
+	if (std::uint8_t* p = Reserve(1)) *p = 0xC3;
+	return *this;
+}
+
+mem::x86::Emitter& mem::x86::Emitter::Nop(size_t nSize)
+{
+	std::uint8_t* p = Reserve(nSize);
+	if (!p) return *this;
+
+	while (nSize)
+	{
+		const size_t n = std::min(nSize, maxNopSize);
+		memcpy(p, nops[n], n);
+		p += n;
+		nSize -= n;
+	}
+	return *this;
+}
+
+mem::x86::Emitter& mem::x86::Emitter::Bytes(const std::span<const std::uint8_t> bytes)
+{
+	if (std::uint8_t* p = Reserve(bytes.size()); p && !bytes.empty()) memcpy(p, bytes.data(), bytes.size());
+	return *this;
+}
@@ -0,0 +1,62 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace mem::x86
+{
+	enum class Register : std::uint8_t
+	{
+		Rax, Rcx, Rdx, Rbx, Rsp, Rbp, Rsi, Rdi,
+		R8, R9, R10, R11, R12, R13, R14, R15
+	};
+
+	// Encoder for the few instructions hooks need, writing into a caller buffer without allocating.
+	// Branches take absolute targets and use the shortest encoding reaching them from 'address', where the code will run
+	// (the buffer itself by default). Once an instruction doesn't fit or can't be encoded nothing more is written and Failed() is true.
+	class Emitter
+	{
+	public:
+		static constexpr size_t relJmpSize = 5;
+		static constexpr size_t absJmpSize = 14;	// jmp [rip+0] followed by the address
+		static constexpr size_t maxNopSize = 9;
+
+		Emitter(std::span<std::uint8_t> buffer, std::uintptr_t address, bool bIs64 = sizeof(void*) == 8) noexcept : buffer(buffer), address(address), bIs64(bIs64) {}
+		explicit Emitter(const std::span<std::uint8_t> buffer) noexcept : Emitter(buffer, reinterpret_cast<std::uintptr_t>(buffer.data())) {}
+
+		// jmp rel8 / rel32, else jmp [rip+0] (x64, no register clobbered)
+		Emitter& Jmp(std::uintptr_t target);
+		// Always jmp rel32 (5 bytes), fails when the target is out of reach
+		Emitter& JmpRel32(std::uintptr_t target);
+		// Always jmp [rip+0] (14 bytes, x64)
+		Emitter& JmpAbsolute(std::uintptr_t target);
+		// call rel32, else call [rip+2] / jmp +8 / address (x64)
+		Emitter& Call(std::uintptr_t target);
+		Emitter& Push(Register reg);
+		Emitter& Pop(Register reg);
+		// mov r32, imm32 (zero-extended) / mov r64, simm32 / mov r64, imm64, whichever is shortest
+		Emitter& Mov(Register reg, std::uint64_t value);
+		Emitter& Ret();
+		// Multi-byte NOPs, largest first
+		Emitter& Nop(size_t nSize);
+		Emitter& Bytes(std::span<const std::uint8_t> bytes);
+
+		[[nodiscard]] size_t Size() const noexcept { return size; }
+		// Runtime address of the next instruction
+		[[nodiscard]] std::uintptr_t Address() const noexcept { return address + size; }
+		[[nodiscard]] bool Failed() const noexcept { return bFailed; }
+		[[nodiscard]] std::span<const std::uint8_t> Code() const noexcept { return buffer.first(size); }
+
+	private:
+		std::span<std::uint8_t> buffer;
+		std::uintptr_t address;
+		size_t size = 0;
+		bool bIs64;
+		bool bFailed = false;
+
+		// Room for nSize more bytes, null (and failed) if there isn't
+		std::uint8_t* Reserve(size_t nSize) noexcept;
+		// Displacement from the end of an instruction of nSize bytes to the target, false if it doesn't fit nBytes
+		bool Displacement(std::uintptr_t target, size_t nSize, size_t nBytes, std::int32_t& displacement) const noexcept;
+	};
+}
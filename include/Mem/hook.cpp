@@ -1,11 +1,20 @@
 ﻿#include "hook.h"
 
+#include "emitter.h"
 #include "mem.h"
+#include "patch.h"
+#include "trampoline.h"
 
 void Hook::SetupHook() const
 {
-	/// Memory Allocation
-	this->detour = static_cast<UINT8*>(mem::AllocateMemory(this->address, PAGE_READWRITE));
+	/// Memory Allocation (shares a block reserved near the target with the other hooks)
+	const size_t detourSize = this->codeLen + std::max(this->len.relative, this->len.absolute) + ABS_JMP_SIZE;
+	this->detour = static_cast<UINT8*>(mem::TrampolineArena::Default().Allocate(this->address, detourSize));
+	if (!this->detour) return;
+
+	// Detour and original code are written together: each page touched is unprotected once
+	mem::PatchTransaction transaction;
+	bool bEncoded;
 
 	/// Detouring (near)
 	if (const intptr_t distance = static_cast<intptr_t>(reinterpret_cast<uintptr_t>(this->detour) - reinterpret_cast<uintptr_t>(this->address) - REL_JMP_SIZE); distance >= INT32_MIN && distance <= INT32_MAX)
@@ -13,45 +22,49 @@ void Hook::SetupHook() const
 		size_t nWritten = 0;
 
 		// Detour Function
-		mem::Write(this->detour, this->code, this->codeLen, &nWritten);													// DETOUR CODE
-		mem::Write(this->detour + nWritten, this->originalBytes, this->len.relative, &nWritten);					// ORIGINAL CODE
-		mem::RelativeJump(this->detour + nWritten, -static_cast<intptr_t>(distance + nWritten + REL_JMP_SIZE));	// jmp original
+		transaction.Write(this->detour, this->code, this->codeLen, &nWritten);																		// DETOUR CODE
+		transaction.Write(this->detour + nWritten, this->originalBytes, this->len.relative, &nWritten);											// ORIGINAL CODE
+		const auto jmpOriginal = mem::detail::RelativeJumpBytes(-static_cast<intptr_t>(distance + nWritten + REL_JMP_SIZE));
+		transaction.Write(this->detour + nWritten, jmpOriginal);																					// jmp original
 
         // Original
-		mem::RelativeJump(this->address, distance);																		// jmp detour
-		mem::Nop(this->address + REL_JMP_SIZE, this->len.relative - REL_JMP_SIZE);
+		const auto jmpDetour = mem::detail::RelativeJumpBytes(distance);
+		transaction.Write(this->address, jmpDetour);																								// jmp detour
+		transaction.Write(this->address + REL_JMP_SIZE, mem::detail::NopBytes(this->len.relative - REL_JMP_SIZE));
+
+		bEncoded = !jmpOriginal.empty() && !jmpDetour.empty();
 	}
 	/// Detouring (far)
 	else
 	{
-		constexpr BYTE pop_rax[] = {0x58};
-
 		size_t nWritten = 0;
 
 		// Detour Function
-		const uintptr_t diff = this->len.absolute - ABS_JMP_SIZE;
-		const uintptr_t gateway = reinterpret_cast<uintptr_t>(this->address) + (this->len.absolute - diff - sizeof(pop_rax));
-
-		mem::Write(this->detour, pop_rax, sizeof(pop_rax), &nWritten);									// pop rax
-		mem::Write(this->detour + nWritten, this->code, this->codeLen, &nWritten);					// DETOUR CODE
-		mem::Write(this->detour + nWritten, this->originalBytes, this->len.absolute, &nWritten);		// ORIGINAL CODE
-		mem::AbsoluteJump(this->detour + nWritten, &gateway);										// jmp original
-
-		nWritten = 0;
-
-		// Original
-		mem::AbsoluteJump(this->address, this->detour, &nWritten);											// jmp detour
-		mem::Patch(this->address + nWritten, pop_rax, sizeof(pop_rax));						// pop rax
-		mem::Nop(this->address + ABS_JMP_SIZE, diff);
+		const uintptr_t gateway = reinterpret_cast<uintptr_t>(this->address) + this->len.absolute;
+		transaction.Write(this->detour, this->code, this->codeLen, &nWritten);								// DETOUR CODE
+		transaction.Write(this->detour + nWritten, this->originalBytes, this->len.absolute, &nWritten);		// ORIGINAL CODE
+		const auto jmpOriginal = mem::detail::AbsoluteJumpBytes(&gateway);
+		transaction.Write(this->detour + nWritten, jmpOriginal);											// jmp original
+
+		// Original (jmp [rip+0] clobbers no register, so neither side needs a pop rax)
+		std::vector<BYTE> original(this->len.absolute);
+		const bool bDetour = !mem::x86::Emitter(original, reinterpret_cast<uintptr_t>(this->address)).JmpAbsolute(reinterpret_cast<uintptr_t>(this->detour)).Nop(this->len.absolute - ABS_JMP_SIZE).Failed();
+		transaction.Write(this->address, original);															// jmp detour
+
+		bEncoded = !jmpOriginal.empty() && bDetour;
 	}
 
-	DWORD lpflOldProtect;
-	VirtualProtect(this->detour, this->codeLen, PAGE_EXECUTE_READ, &lpflOldProtect);
+	// Nothing is written when a jump can't be encoded
+	if (!bEncoded || !transaction.Commit())
+	{
+		mem::TrampolineArena::Default().Free(this->detour);
+		this->detour = nullptr;
+	}
 }
 
-Hook::Hook(void* moduleHandle, const char* pattern, const size_t length): code(nullptr)
+Hook::Hook(UINT8* address, const size_t length): code(nullptr)
 {
-	this->address = mem::PatternScan<std::uint8_t*>(moduleHandle, pattern);
+	this->address = address;
 	if (!this->address) return;
 
 	this->bDisabled = false;
@@ -59,9 +72,9 @@ Hook::Hook(void* moduleHandle, const char* pattern, const size_t length): code(n
 	memcpy(originalBytes, address, codeLen);
 }
 
-Hook::Hook(void* moduleHandle, const char* pattern, const LengthPatched length, BYTE* code, const size_t codeLen)
+Hook::Hook(UINT8* address, const LengthPatched length, BYTE* code, const size_t codeLen)
 {
-	this->address = mem::PatternScan<std::uint8_t*>(moduleHandle, pattern);
+	this->address = address;
 	if (!this->address) return;
 
 	this->bDisabled = false;
@@ -71,9 +84,9 @@ Hook::Hook(void* moduleHandle, const char* pattern, const LengthPatched length,
 	memcpy(originalBytes, address, std::max(length.relative, length.absolute));
 }
 
-Hook::Hook(void* moduleHandle, const char* pattern, BYTE* code, const size_t codeLen)
+Hook::Hook(UINT8* address, BYTE* code, const size_t codeLen)
 {
-	this->address = mem::PatternScan<std::uint8_t*>(moduleHandle, pattern);
+	this->address = address;
 	if (!this->address) return;
 
 	this->bDisabled = false;
@@ -82,6 +95,18 @@ Hook::Hook(void* moduleHandle, const char* pattern, BYTE* code, const size_t cod
 	memcpy(originalBytes, address, codeLen);
 }
 
+Hook::Hook(void* moduleHandle, const char* pattern, const size_t length): Hook(mem::PatternScan<UINT8*>(moduleHandle, pattern), length) {}
+
+Hook::Hook(void* moduleHandle, const char* pattern, const LengthPatched length, BYTE* code, const size_t codeLen): Hook(mem::PatternScan<UINT8*>(moduleHandle, pattern), length, code, codeLen) {}
+
+Hook::Hook(void* moduleHandle, const char* pattern, BYTE* code, const size_t codeLen): Hook(mem::PatternScan<UINT8*>(moduleHandle, pattern), code, codeLen) {}
+
+Hook::Hook(void* moduleHandle, const mem::SignatureView& signature, const size_t length): Hook(mem::PatternScan<UINT8*>(moduleHandle, signature), length) {}
+
+Hook::Hook(void* moduleHandle, const mem::SignatureView& signature, const LengthPatched length, BYTE* code, const size_t codeLen): Hook(mem::PatternScan<UINT8*>(moduleHandle, signature), length, code, codeLen) {}
+
+Hook::Hook(void* moduleHandle, const mem::SignatureView& signature, BYTE* code, const size_t codeLen): Hook(mem::PatternScan<UINT8*>(moduleHandle, signature), code, codeLen) {}
+
 void Hook::Enable()
 {
 	bStatus = true;
@@ -94,7 +119,8 @@ void Hook::Disable()
 	bStatus = false;
 	if (bDisabled) return;
 	mem::Patch(address, originalBytes, std::max(len.relative, len.absolute));
-	VirtualFree(detour, 0, MEM_RELEASE);
+	mem::TrampolineArena::Default().Free(detour);
+	detour = nullptr;
 }
 
 void Hook::NopEnable()
@@ -1,6 +1,8 @@
 ﻿#pragma once
 #include <windows.h>
 
+#include "signature.h"
+
 enum JMP_SIZE : INT8
 {
 	ABS_JMP_SIZE = 14,
@@ -30,9 +32,17 @@ struct Hook
 	BYTE* code;
 	size_t codeLen;
 
+	Hook(UINT8* address, size_t length);
+	Hook(UINT8* address, LengthPatched length, BYTE* code, size_t codeLen);
+	Hook(UINT8* address, BYTE* code, size_t codeLen);
+
 	Hook(void* moduleHandle, const char* pattern, size_t length);
 	Hook(void* moduleHandle, const char* pattern, LengthPatched length, BYTE* code, size_t codeLen);
 	Hook(void* moduleHandle, const char* pattern, BYTE* code, size_t codeLen);
+
+	Hook(void* moduleHandle, const mem::SignatureView& signature, size_t length);
+	Hook(void* moduleHandle, const mem::SignatureView& signature, LengthPatched length, BYTE* code, size_t codeLen);
+	Hook(void* moduleHandle, const mem::SignatureView& signature, BYTE* code, size_t codeLen);
 	
 	
 	void Enable();
@@ -1,34 +1,727 @@
 ﻿#include "mem.h"
+#include "emitter.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <span>
+#include <thread>
+#include <intrin.h>
+#include <immintrin.h>
+
+// MSVC emits AVX2 in any function, GCC and clang (tools/ builds) only in functions targeting it. The kernels are picked at runtime.
+#if defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+namespace
+{
+	bool IsAligned(const BYTE* pAddress)
+	{
+		return (reinterpret_cast<uintptr_t>(pAddress) & 3) == 0;
+	}
+
+	bool Verify(const BYTE* pCandidate, const mem::SignatureView& signature)
+	{
+		for (size_t i = 0; i < signature.size; i++)
+		{
+			if ((pCandidate[i] & signature.mask[i]) != signature.bytes[i]) return false;
+		}
+		return true;
+	}
+
+	// Each kernel scans candidates [n, last] and returns the index of the first match, or SIZE_MAX.
+	// Loads never go past pBase + last + signature.size - 1, so they stay inside the scanned range.
+	size_t ScanScalar(const BYTE* pBase, size_t n, const size_t last, const mem::SignatureView& signature, const bool bFastScan)
+	{
+		const BYTE first = signature.bytes[signature.anchor];
+		const BYTE second = signature.bytes[signature.secondAnchor];
+
+		for (; n <= last; n++)
+		{
+			if (pBase[n + signature.anchor] == first && pBase[n + signature.secondAnchor] == second && (!bFastScan || IsAligned(pBase + n)) && Verify(pBase + n, signature))
+			{
+				return n;
+			}
+		}
+		return SIZE_MAX;
+	}
+
+	size_t ScanSSE2(const BYTE* pBase, size_t n, const size_t last, const mem::SignatureView& signature, const bool bFastScan)
+	{
+		const __m128i first = _mm_set1_epi8(static_cast<char>(signature.bytes[signature.anchor]));
+		const __m128i second = _mm_set1_epi8(static_cast<char>(signature.bytes[signature.secondAnchor]));
+
+		for (; last - n >= 15 && n <= last; n += 16)
+		{
+			const __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pBase + n + signature.anchor));
+			const __m128i blockSecond = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pBase + n + signature.secondAnchor));
+
+			auto bits = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockSecond, second))));
+			while (bits)
+			{
+				const size_t candidate = n + std::countr_zero(bits);
+				if ((!bFastScan || IsAligned(pBase + candidate)) && Verify(pBase + candidate, signature)) return candidate;
+				bits &= bits - 1;
+			}
+		}
+		return n <= last ? ScanScalar(pBase, n, last, signature, bFastScan) : SIZE_MAX;
+	}
+
+	TARGET_AVX2 size_t ScanAVX2(const BYTE* pBase, size_t n, const size_t last, const mem::SignatureView& signature, const bool bFastScan)
+	{
+		const __m256i first = _mm256_set1_epi8(static_cast<char>(signature.bytes[signature.anchor]));
+		const __m256i second = _mm256_set1_epi8(static_cast<char>(signature.bytes[signature.secondAnchor]));
+
+		for (; last - n >= 31 && n <= last; n += 32)
+		{
+			const __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pBase + n + signature.anchor));
+			const __m256i blockSecond = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pBase + n + signature.secondAnchor));
+
+			auto bits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockSecond, second))));
+			while (bits)
+			{
+				const size_t candidate = n + std::countr_zero(bits);
+				if ((!bFastScan || IsAligned(pBase + candidate)) && Verify(pBase + candidate, signature)) return candidate;
+				bits &= bits - 1;
+			}
+		}
+		return n <= last ? ScanSSE2(pBase, n, last, signature, bFastScan) : SIZE_MAX;
+	}
+
+	enum class SimdLevel : std::uint8_t
+	{
+		None,
+		SSE2,
+		AVX2
+	};
+
+	SimdLevel DetectSimdLevel()
+	{
+		int info[4]{};
+		__cpuid(info, 0);
+		const int maxLeaf = info[0];
+
+		__cpuid(info, 1);
+		const bool bSSE2 = info[3] & (1 << 26);
+		const bool bOSXSAVE = info[2] & (1 << 27);
+		const bool bAVX = info[2] & (1 << 28);
+
+		if (maxLeaf >= 7 && bOSXSAVE && bAVX && (_xgetbv(0) & 6) == 6)
+		{
+			__cpuidex(info, 7, 0);
+			if (info[1] & (1 << 5)) return SimdLevel::AVX2;
+		}
+		return bSSE2 ? SimdLevel::SSE2 : SimdLevel::None;
+	}
+
+	const SimdLevel simdLevel = DetectSimdLevel();
+
+	// Anchored kernel FindPattern runs, capped by the CPU
+	SimdLevel LevelOf(const mem::detail::ScanKernel kernel)
+	{
+		switch (kernel)
+		{
+		case mem::detail::ScanKernel::Scalar:
+			return SimdLevel::None;
+		case mem::detail::ScanKernel::SSE2:
+			return std::min(simdLevel, SimdLevel::SSE2);
+		default:
+			return simdLevel;
+		}
+	}
+
+	// Shift-or (bitap) automaton: bit i of a state is clear while the last i + 1 bytes match the first i + 1 pattern bytes.
+	// Every position costs the same whatever the pattern, wildcards included. Patterns longer than 64 bytes are
+	// filtered on their first 64 bytes, then verified.
+	class ShiftOr
+	{
+	public:
+		explicit ShiftOr(const mem::SignatureView& signature) : length(std::min<size_t>(signature.size, 64)), hit(1ull << (length - 1))
+		{
+			masks.fill(~0ull);
+
+			std::uint64_t wildcards = 0;
+			for (size_t i = 0; i < length; i++)
+			{
+				const std::uint64_t bit = 1ull << i;
+				if (signature.mask[i] == 0x00) wildcards |= bit;
+				else if (signature.mask[i] == 0xFF) masks[signature.bytes[i]] &= ~bit;
+				else
+				{
+					for (size_t c = 0; c < masks.size(); c++)
+					{
+						if ((c & signature.mask[i]) == signature.bytes[i]) masks[c] &= ~bit;
+					}
+				}
+			}
+			for (auto& mask : masks) mask &= ~wildcards;
+		}
+
+		// Same contract as the anchored kernels
+		size_t Scan(const BYTE* pBase, size_t n, const size_t last, const mem::SignatureView& signature, const bool bFastScan) const
+		{
+			const auto accept = [&](const size_t candidate)
+			{
+				return (!bFastScan || IsAligned(pBase + candidate)) && (length == signature.size || Verify(pBase + candidate, signature));
+			};
+
+			// A single state chain is latency bound, so rounds run 4 independent lanes over consecutive blocks.
+			// Lane k feeds the bytes of candidates [n + k * block, n + (k + 1) * block).
+			constexpr size_t block = 16 * 1024;
+			for (; last - n + 1 >= 4 * block; n += 4 * block)
+			{
+				const BYTE* p0 = pBase + n;
+				const BYTE* p1 = p0 + block;
+				const BYTE* p2 = p1 + block;
+				const BYTE* p3 = p2 + block;
+				std::uint64_t s0 = ~0ull, s1 = ~0ull, s2 = ~0ull, s3 = ~0ull;
+
+				size_t found = SIZE_MAX;
+				for (size_t i = 0; i < block + length - 1; i++)
+				{
+					s0 = s0 << 1 | masks[p0[i]];
+					s1 = s1 << 1 | masks[p1[i]];
+					s2 = s2 << 1 | masks[p2[i]];
+					s3 = s3 << 1 | masks[p3[i]];
+					if (!(s0 & s1 & s2 & s3 & hit)) [[unlikely]]
+					{
+						// Lowest accepted lane wins, later positions of the same lane can't be lower
+						const std::uint64_t states[] = { s0, s1, s2, s3 };
+						for (size_t k = 0; k < 4; k++)
+						{
+							const size_t candidate = n + k * block + i + 1 - length;
+							if (!(states[k] & hit) && candidate < found && accept(candidate)) found = candidate;
+						}
+					}
+				}
+				if (found != SIZE_MAX) return found;
+			}
+
+			std::uint64_t state = ~0ull;
+			for (size_t i = n; i < last + length; i++)
+			{
+				state = state << 1 | masks[pBase[i]];
+				if (!(state & hit) && accept(i + 1 - length)) return i + 1 - length;
+			}
+			return SIZE_MAX;
+		}
+
+		// Whole range scan where bytes marked in the relocation map (rva = RVA of pBase) match any pattern byte.
+		// Pages without relocations take the plain update, the others clear the mismatch bits of their relocated bytes.
+		size_t ScanRelocated(const BYTE* pBase, const size_t nSize, const mem::SignatureView& signature, const mem::RelocationMap& relocations, const DWORD rva) const
+		{
+			constexpr DWORD pageSize = mem::RelocationMap::pageSize;
+			const size_t last = nSize - signature.size;
+			const auto accept = [&](const size_t candidate)
+			{
+				if (candidate > last) return false;
+				for (size_t i = length; i < signature.size; i++)
+				{
+					if ((pBase[candidate + i] & signature.mask[i]) != signature.bytes[i] && !relocations.IsRelocated(static_cast<DWORD>(rva + candidate + i))) return false;
+				}
+				return true;
+			};
+
+			std::uint64_t state = ~0ull;
+			for (size_t i = 0; i < nSize;)
+			{
+				const DWORD pageRva = static_cast<DWORD>(rva + i);
+				const size_t pageEnd = std::min<size_t>(nSize, i + (pageSize - pageRva % pageSize));
+				if (const std::uint64_t* pBitmap = relocations.PageBitmap(pageRva))
+				{
+					for (; i < pageEnd; i++)
+					{
+						const DWORD bit = static_cast<DWORD>(rva + i) % pageSize;
+						const std::uint64_t relocated = 0 - (pBitmap[bit / 64] >> (bit % 64) & 1);
+						state = state << 1 | (masks[pBase[i]] & ~relocated);
+						if (!(state & hit) && accept(i + 1 - length)) return i + 1 - length;
+					}
+				}
+				else
+				{
+					for (; i < pageEnd; i++)
+					{
+						state = state << 1 | masks[pBase[i]];
+						if (!(state & hit) && accept(i + 1 - length)) return i + 1 - length;
+					}
+				}
+			}
+			return SIZE_MAX;
+		}
+
+	private:
+		std::array<std::uint64_t, 256> masks;
+		size_t length;
+		std::uint64_t hit;
+	};
+
+	// The anchored kernels slow down when the anchor pair keeps matching without the rest of the pattern, while shift-or runs at a constant
+	// ~1.5-3 GB/s. For the 53-byte x86 Steam present pattern (tools/shiftorbench.cpp), AVX2 drops from ~9 GB/s to ~3 GB/s with one such candidate
+	// every 32 bytes and crosses shift-or around one every 16 bytes. Long patterns switch over once a sample of the range shows that density.
+	bool PreferShiftOr(const BYTE* pBase, const size_t start, const size_t last, const mem::SignatureView& signature)
+	{
+		constexpr size_t minPatternSize = 16;
+		constexpr size_t minRange = 4 * 1024 * 1024;
+		constexpr size_t sampleCount = 4;
+		constexpr size_t sampleSize = 4 * 1024;
+		constexpr size_t crossoverStride = 16;
+
+		if (signature.size < minPatternSize || last - start + 1 < minRange) return false;
+
+		const BYTE first = signature.bytes[signature.anchor];
+		const BYTE second = signature.bytes[signature.secondAnchor];
+		const size_t stride = (last - start + 1) / sampleCount;
+
+		size_t nHits = 0;
+		for (size_t sample = 0; sample < sampleCount; sample++)
+		{
+			const BYTE* pSample = pBase + start + sample * stride;
+			for (size_t i = 0; i < sampleSize; i++)
+			{
+				nHits += pSample[i + signature.anchor] == first && pSample[i + signature.secondAnchor] == second;
+			}
+		}
+		return nHits * crossoverStride >= sampleCount * sampleSize;
+	}
+}
+
+const BYTE* mem::detail::FindPattern(const BYTE* pBase, const size_t nSize, const SignatureView& signature, const bool bFastScan, const ScanKernel kernel)
+{
+	if (!pBase || signature.empty() || signature.size > nSize) return nullptr;
+
+	// Fast scan: check only 4-byte aligned addresses.
+	const size_t start = bFastScan ? (0 - reinterpret_cast<uintptr_t>(pBase)) & 3 : 0;
+	const size_t last = nSize - signature.size;
+	if (start > last) return nullptr;
+
+	if (signature.wildcardsOnly())
+	{
+		return pBase + start; // Anything matches
+	}
+
+	// Without a fully masked byte to anchor on (nibble wildcards and alternatives only), shift-or takes every position
+	size_t match;
+	if (signature.anchor == SignatureView::npos || kernel == ScanKernel::ShiftOr || (kernel == ScanKernel::Auto && PreferShiftOr(pBase, start, last, signature)))
+	{
+		match = ShiftOr(signature).Scan(pBase, start, last, signature, bFastScan);
+	}
+	else switch (LevelOf(kernel))
+	{
+	case SimdLevel::AVX2:
+		match = ScanAVX2(pBase, start, last, signature, bFastScan);
+		break;
+	case SimdLevel::SSE2:
+		match = ScanSSE2(pBase, start, last, signature, bFastScan);
+		break;
+	default:
+		match = ScanScalar(pBase, start, last, signature, bFastScan);
+		break;
+	}
+	return match != SIZE_MAX ? pBase + match : nullptr;
+}
+
+const BYTE* mem::detail::FindPatternRelocated(const BYTE* pBase, const size_t nSize, const SignatureView& signature, const RelocationMap& relocations, const DWORD rva)
+{
+	if (!pBase || signature.empty() || signature.size > nSize) return nullptr;
+	if (relocations.Empty()) return FindPattern(pBase, nSize, signature, false);
+
+	// Anchors may sit on relocated bytes, so candidates can't come from the anchored kernels
+	const size_t match = ShiftOr(signature).ScanRelocated(pBase, nSize, signature, relocations, rva);
+	return match != SIZE_MAX ? pBase + match : nullptr;
+}
+
+namespace
+{
+	// Non-wildcard bytes of the candidate that differ from the signature, stops counting once above limit
+	size_t CountMismatches(const BYTE* pCandidate, const mem::SignatureView& signature, const size_t limit)
+	{
+		size_t nMismatches = 0;
+		size_t i = 0;
+		if (simdLevel != SimdLevel::None)
+		{
+			for (; i + 16 <= signature.size && nMismatches <= limit; i += 16)
+			{
+				const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pCandidate + i));
+				const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(signature.mask + i));
+				const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(signature.bytes + i));
+				const auto equal = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(data, mask), bytes)));
+				nMismatches += std::popcount(~equal & 0xFFFF);
+			}
+		}
+		for (; i < signature.size && nMismatches <= limit; i++)
+		{
+			nMismatches += (pCandidate[i] & signature.mask[i]) != signature.bytes[i];
+		}
+		return nMismatches;
+	}
+
+	// Splits the fixed bytes of a signature in nPieces consecutive sub-signatures with about as many fixed bytes each
+	std::vector<mem::SignatureView> SplitSignature(const mem::SignatureView& signature, const size_t nPieces)
+	{
+		std::vector<size_t> fixed;
+		for (size_t i = 0; i < signature.size; i++)
+		{
+			if (signature.mask[i]) fixed.push_back(i);
+		}
+		if (fixed.size() < nPieces) return {};
+
+		std::vector<mem::SignatureView> pieces(nPieces);
+		for (size_t k = 0; k < nPieces; k++)
+		{
+			// Pieces start and end on fixed bytes
+			const size_t first = fixed[k * fixed.size() / nPieces];
+			const size_t last = fixed[(k + 1) * fixed.size() / nPieces - 1];
+
+			auto& piece = pieces[k];
+			piece.bytes = signature.bytes + first;
+			piece.mask = signature.mask + first;
+			piece.size = last - first + 1;
+			mem::detail::SelectAnchors(piece);
+		}
+		return pieces;
+	}
+}
+
+void mem::detail::FindPatternFuzzy(const BYTE* pBase, const size_t nSize, const SignatureView& signature, const size_t maxMismatches, std::vector<FuzzyMatch>& results)
+{
+	if (!pBase || signature.empty() || signature.size > nSize) return;
+
+	const auto pieces = SplitSignature(signature, maxMismatches + 1);
+	const size_t last = nSize - signature.size;
+	for (size_t k = 0; k < pieces.size(); k++)
+	{
+		const auto& piece = pieces[k];
+		const size_t offset = piece.bytes - signature.bytes;
+
+		// Piece k finds the candidates where it is the first piece matching exactly
+		const BYTE* pEnd = pBase + last + offset + piece.size;
+		for (const BYTE* pPiece = FindPattern(pBase + offset, last + piece.size, piece, false); pPiece; pPiece = FindPattern(pPiece + 1, pEnd - pPiece - 1, piece, false))
+		{
+			const BYTE* pCandidate = pPiece - offset;
+			if (std::any_of(pieces.begin(), pieces.begin() + k, [&](const SignatureView& previous) { return Verify(pCandidate + (previous.bytes - signature.bytes), previous); })) continue;
+
+			if (const size_t nMismatches = CountMismatches(pCandidate, signature, maxMismatches); nMismatches <= maxMismatches)
+			{
+				results.push_back({ const_cast<std::uint8_t*>(pCandidate), nMismatches });
+			}
+		}
+	}
+}
+
+namespace
+{
+	std::vector<mem::FuzzyMatch> RankFuzzyMatches(std::vector<mem::FuzzyMatch> matches, const size_t maxResults)
+	{
+		const auto byRank = [](const mem::FuzzyMatch& a, const mem::FuzzyMatch& b) { return a.mismatches != b.mismatches ? a.mismatches < b.mismatches : a.address < b.address; };
+		if (matches.size() > maxResults)
+		{
+			std::ranges::partial_sort(matches, matches.begin() + static_cast<std::ptrdiff_t>(maxResults), byRank);
+			matches.resize(maxResults);
+		}
+		else std::ranges::sort(matches, byRank);
+		return matches;
+	}
+}
+
+std::vector<mem::FuzzyMatch> mem::PatternScanFuzzy(void* hModule, const SignatureView& signature, const size_t maxMismatches, const size_t maxResults, const SectionFilter& sections)
+{
+	std::vector<FuzzyMatch> matches;
+	for (const auto& range : detail::ModuleRanges(hModule, sections))
+	{
+		detail::FindPatternFuzzy(range.data(), range.size(), signature, maxMismatches, matches);
+	}
+	return RankFuzzyMatches(std::move(matches), maxResults);
+}
+
+std::vector<mem::FuzzyMatch> mem::PatternScanFuzzy(const PBYTE pBase, const DWORD dwSize, const SignatureView& signature, const size_t maxMismatches, const size_t maxResults)
+{
+	std::vector<FuzzyMatch> matches;
+	detail::FindPatternFuzzy(pBase, dwSize, signature, maxMismatches, matches);
+	return RankFuzzyMatches(std::move(matches), maxResults);
+}
 
 namespace
 {
-	void FillWithAlignedNOPs(BYTE* pAddress, const size_t nSize)
+	// Anchor-byte bucket table for batched scans: each byte value lists the pending signatures anchored on it.
+	class AnchorBuckets
 	{
-		// Define multi-byte NOPs
-		static const std::vector<std::vector<BYTE>> opcodes = {
-			{0x66, 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00}, // 9-byte NOP
-			{0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00},       // 8-byte NOP
-			{0x0F, 0x1F, 0x80, 0x00, 0x00, 0x00, 0x00},             // 7-byte NOP
-			{0x66, 0x0F, 0x1F, 0x44, 0x00, 0x00},                   // 6-byte NOP
-			{0x0F, 0x1F, 0x44, 0x00, 0x00},                         // 5-byte NOP
-			{0x0F, 0x1F, 0x40, 0x00},                               // 4-byte NOP
-			{0x0F, 0x1F, 0x00},                                     // 3-byte NOP
-			{0x66, 0x90},                                           // 2-byte NOP
-			{0x90}                                                  // 1-byte NOP
-		};
+	public:
+		AnchorBuckets(std::span<const mem::SignatureView> signatures, std::span<const BYTE*> results)
+		{
+			for (size_t i = 0; i < signatures.size(); i++)
+			{
+				if (results[i] || signatures[i].anchor == mem::SignatureView::npos) continue;
+				const BYTE value = signatures[i].bytes[signatures[i].anchor];
+				buckets[value].push_back(i);
+				lowNibbleSets[value >> 7][value & 0x0F] |= static_cast<BYTE>(1 << (value >> 4 & 7));
+				pending++;
+			}
+		}
 
-		size_t offset = 0;
+		[[nodiscard]] bool Done() const noexcept { return pending == 0; }
+
+		// Checks every signature anchored on pBase[position], recording (and retiring) the ones that match there.
+		void Probe(const BYTE* pBase, const size_t nSize, const size_t position, std::span<const mem::SignatureView> signatures, std::span<const BYTE*> results, const size_t start, const bool bFastScan)
+		{
+			auto& bucket = buckets[pBase[position]];
+			for (size_t i = 0; i < bucket.size();)
+			{
+				const size_t index = bucket[i];
+				const mem::SignatureView& signature = signatures[index];
 
-		// Fill the memory region with the largest possible NOPs
-		for (const auto& nop : opcodes) {
-			while (nSize - offset >= nop.size()) {
-				memcpy(pAddress + offset, nop.data(), nop.size());
-				offset += nop.size();
+				if (position >= start + signature.anchor && position - signature.anchor + signature.size <= nSize)
+				{
+					const BYTE* pCandidate = pBase + position - signature.anchor;
+					if (pCandidate[signature.secondAnchor] == signature.bytes[signature.secondAnchor] && (!bFastScan || IsAligned(pCandidate)) && Verify(pCandidate, signature))
+					{
+						results[index] = pCandidate;
+						bucket[i] = bucket.back();
+						bucket.pop_back();
+						pending--;
+						continue;
+					}
+				}
+				i++;
 			}
 		}
+
+		[[nodiscard]] bool Contains(const BYTE value) const noexcept { return !buckets[value].empty(); }
+
+		// Byte-set membership tables for PSHUFB: indexed by the low nibble, one bit per high nibble (0-7 and 8-15).
+		alignas(16) BYTE lowNibbleSets[2][16]{};
+
+	private:
+		std::vector<size_t> buckets[256];
+		size_t pending = 0;
+	};
+
+	void ScanBatchScalar(const BYTE* pBase, const size_t nSize, size_t position, AnchorBuckets& table, std::span<const mem::SignatureView> signatures, std::span<const BYTE*> results, const size_t start, const bool bFastScan)
+	{
+		for (; position < nSize && !table.Done(); position++)
+		{
+			if (table.Contains(pBase[position])) table.Probe(pBase, nSize, position, signatures, results, start, bFastScan);
+		}
+	}
+
+	TARGET_AVX2 void ScanBatchAVX2(const BYTE* pBase, const size_t nSize, AnchorBuckets& table, std::span<const mem::SignatureView> signatures, std::span<const BYTE*> results, const size_t start, const bool bFastScan)
+	{
+		const __m256i lowSet = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(table.lowNibbleSets[0])));
+		const __m256i highSet = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(table.lowNibbleSets[1])));
+		const __m256i bitForNibble = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+		const __m256i nibbleMask = _mm256_set1_epi8(0x0F);
+		const __m256i eight = _mm256_set1_epi8(8);
+
+		size_t position = 0;
+		for (; position + 32 <= nSize && !table.Done(); position += 32)
+		{
+			const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pBase + position));
+			const __m256i low = _mm256_and_si256(block, nibbleMask);
+			const __m256i high = _mm256_and_si256(_mm256_srli_epi16(block, 4), nibbleMask);
+
+			// Bytes with the high nibble >= 8 look up the second table
+			const __m256i isLowHalf = _mm256_cmpgt_epi8(eight, high);
+			const __m256i sets = _mm256_blendv_epi8(_mm256_shuffle_epi8(highSet, low), _mm256_shuffle_epi8(lowSet, low), isLowHalf);
+			const __m256i bits = _mm256_shuffle_epi8(bitForNibble, high);
+			const __m256i hits = _mm256_cmpeq_epi8(_mm256_and_si256(sets, bits), _mm256_setzero_si256());
+
+			auto candidates = ~static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+			while (candidates)
+			{
+				table.Probe(pBase, nSize, position + std::countr_zero(candidates), signatures, results, start, bFastScan);
+				candidates &= candidates - 1;
+			}
+		}
+		ScanBatchScalar(pBase, nSize, position, table, signatures, results, start, bFastScan);
 	}
 }
 
+void mem::detail::FindPatterns(const BYTE* pBase, const size_t nSize, const std::span<const SignatureView> signatures, const std::span<const BYTE*> results, const bool bFastScan)
+{
+	if (!pBase) return;
+
+	// Signatures without an anchor byte can't be bucketed, they are scanned on their own
+	for (size_t i = 0; i < signatures.size(); i++)
+	{
+		if (!results[i] && signatures[i].anchor == SignatureView::npos) results[i] = FindPattern(pBase, nSize, signatures[i], bFastScan);
+	}
+
+	const size_t start = bFastScan ? (0 - reinterpret_cast<uintptr_t>(pBase)) & 3 : 0;
+
+	AnchorBuckets table(signatures, results);
+	if (table.Done()) return;
+
+	if (simdLevel == SimdLevel::AVX2) ScanBatchAVX2(pBase, nSize, table, signatures, results, start, bFastScan);
+	else ScanBatchScalar(pBase, nSize, 0, table, signatures, results, start, bFastScan);
+}
+
+const BYTE* mem::detail::FindPatternParallel(const BYTE* pBase, const size_t nSize, const SignatureView& signature, const bool bFastScan, unsigned nThreads)
+{
+	constexpr size_t chunkSize = 8 * 1024 * 1024;
+
+	if (!pBase || signature.empty() || signature.size > nSize) return nullptr;
+	if (!nThreads) nThreads = std::clamp(std::thread::hardware_concurrency(), 1u, 8u);
+
+	const size_t nCandidates = nSize - signature.size + 1;
+	const size_t nChunks = (nCandidates + chunkSize - 1) / chunkSize;
+	if (nThreads == 1 || nChunks < 2) return FindPattern(pBase, nSize, signature, bFastScan);
+
+	std::atomic<size_t> nextChunk{ 0 };
+	std::atomic<size_t> bestMatch{ SIZE_MAX };
+
+	const auto worker = [&]
+	{
+		for (size_t chunk = nextChunk++; chunk < nChunks; chunk = nextChunk++)
+		{
+			const size_t begin = chunk * chunkSize;
+			if (begin >= bestMatch.load(std::memory_order_relaxed)) return; // Every remaining chunk is above a known match
+
+			// Overlap the next chunk by signature.size - 1 so matches crossing the boundary are found
+			const size_t length = std::min(chunkSize, nCandidates - begin) + signature.size - 1;
+			if (const BYTE* pMatch = FindPattern(pBase + begin, length, signature, bFastScan))
+			{
+				const size_t offset = pMatch - pBase;
+				size_t current = bestMatch.load(std::memory_order_relaxed);
+				while (offset < current && !bestMatch.compare_exchange_weak(current, offset, std::memory_order_relaxed)) {}
+				return;
+			}
+		}
+	};
+
+	std::vector<std::jthread> workers;
+	workers.reserve(std::min<size_t>(nThreads, nChunks) - 1);
+	for (size_t i = 1; i < std::min<size_t>(nThreads, nChunks); i++) workers.emplace_back(worker);
+	worker();
+	workers.clear(); // Joins
+
+	const size_t match = bestMatch.load();
+	return match != SIZE_MAX ? pBase + match : nullptr;
+}
+
+std::vector<std::span<const BYTE>> mem::detail::ModuleRanges(void* hModule, const SectionFilter& sections)
+{
+	const PEView image(static_cast<HMODULE>(hModule));
+	if (!image.IsValid()) return {};
+
+	std::vector<std::span<const BYTE>> ranges;
+	for (const auto& section : image.SectionRanges(sections))
+	{
+		// Skip pages that aren't committed or readable (guard pages, reserved tails, ...)
+		const BYTE* pAddress = section.data();
+		const BYTE* pEnd = section.data() + section.size();
+		MEMORY_BASIC_INFORMATION mbi;
+		while (pAddress < pEnd && VirtualQuery(pAddress, &mbi, sizeof(mbi)))
+		{
+			const BYTE* pRegionEnd = std::min(static_cast<const BYTE*>(mbi.BaseAddress) + mbi.RegionSize, pEnd);
+			if (mbi.State == MEM_COMMIT && !(mbi.Protect & (PAGE_NOACCESS | PAGE_GUARD)))
+			{
+				if (!ranges.empty() && ranges.back().data() + ranges.back().size() == pAddress)
+				{
+					ranges.back() = { ranges.back().data(), static_cast<size_t>(pRegionEnd - ranges.back().data()) };
+				}
+				else ranges.emplace_back(pAddress, pRegionEnd);
+			}
+			pAddress = pRegionEnd;
+		}
+	}
+	return ranges;
+}
+
+std::vector<std::span<const BYTE>> mem::detail::RegionRanges(RegionProvider& regions, const RegionAccess access)
+{
+	std::vector<std::span<const BYTE>> ranges;
+	for (const auto& region : *regions.Snapshot())
+	{
+		if (HasAccess(region.access, access)) ranges.push_back(region.Bytes());
+	}
+	return ranges;
+}
+
+uintptr_t mem::detail::ResolveCapture(const BYTE* pMatch, const Capture& capture)
+{
+	const BYTE* pOperand = pMatch + capture.offset;
+	const uintptr_t instructionEnd = reinterpret_cast<uintptr_t>(pOperand) + capture.size() + capture.trailing;
+
+	uintptr_t address = 0;
+	switch (capture.type)
+	{
+	case CaptureType::Rel8:
+		address = instructionEnd + static_cast<int8_t>(*pOperand);
+		break;
+	case CaptureType::Rel32:
+		address = instructionEnd + *reinterpret_cast<const int32_t*>(pOperand);
+		break;
+	case CaptureType::Abs32:
+		address = *reinterpret_cast<const uint32_t*>(pOperand);
+		break;
+	case CaptureType::Abs64:
+		address = static_cast<uintptr_t>(*reinterpret_cast<const uint64_t*>(pOperand));
+		break;
+	}
+
+	__try
+	{
+		for (BYTE i = 0; i < capture.derefs && address; i++)
+		{
+			address = *reinterpret_cast<const uintptr_t*>(address);
+		}
+		return address;
+	}
+	__except (EXCEPTION_EXECUTE_HANDLER)
+	{
+		return 0;
+	}
+}
+
+mem::PatternMatches mem::PatternScanAll(void* hModule, const SignatureView& signature, const bool bFastScan, const SectionFilter& sections)
+{
+	return { detail::ModuleRanges(hModule, sections), signature, bFastScan };
+}
+
+mem::PatternMatches mem::PatternScanAll(const PBYTE pBase, const DWORD dwSize, const SignatureView& signature, const bool bFastScan)
+{
+	if (!pBase) return {};
+	return { std::span<const BYTE>(pBase, dwSize), signature, bFastScan };
+}
+
+mem::PatternMatches mem::PatternScanAll(RegionProvider& regions, const SignatureView& signature, const RegionAccess access, const bool bFastScan)
+{
+	return { detail::RegionRanges(regions, access), signature, bFastScan };
+}
+
+size_t mem::CountMatches(const PatternMatches& matches, const size_t limit)
+{
+	size_t nCount = 0;
+	for (auto it = matches.begin(); nCount < limit && it != matches.end(); ++it) nCount++;
+	return nCount;
+}
+
+std::vector<std::uint8_t*> mem::PatternScanBatch(void* hModule, const std::span<const SignatureView> signatures, const bool bFastScan, const SectionFilter& sections)
+{
+	std::vector<const BYTE*> matches(signatures.size());
+	for (const auto& range : detail::ModuleRanges(hModule, sections))
+	{
+		detail::FindPatterns(range.data(), range.size(), signatures, matches, bFastScan);
+	}
+
+	std::vector<std::uint8_t*> results(signatures.size());
+	std::ranges::transform(matches, results.begin(), [](const BYTE* pMatch) { return const_cast<std::uint8_t*>(pMatch); });
+	return results;
+}
+
+std::vector<std::uint8_t*> mem::PatternScanBatch(const PBYTE pBase, const DWORD dwSize, const std::span<const SignatureView> signatures, const bool bFastScan)
+{
+	std::vector<const BYTE*> matches(signatures.size());
+	detail::FindPatterns(pBase, dwSize, signatures, matches, bFastScan);
+
+	std::vector<std::uint8_t*> results(signatures.size());
+	std::ranges::transform(matches, results.begin(), [](const BYTE* pMatch) { return const_cast<std::uint8_t*>(pMatch); });
+	return results;
+}
+
 void* mem::AllocateMemory(const LPVOID lpAddress, const DWORD flAllocationType)
 {
 	SYSTEM_INFO sysInfo;
@@ -73,30 +766,45 @@ void* mem::AllocateMemory(const LPVOID lpAddress, const DWORD flAllocationType)
 	return nullptr;
 }
 
-void mem::AbsoluteJump(void* const pSource, const void* pDestination, size_t* const nWritten)
+std::vector<BYTE> mem::detail::AbsoluteJumpBytes(const void* pDestination)
 {
-	BYTE opcodes[] = {
-		0x50,														// push rax
-		0x48, 0xB8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	// mov rax, address
-		0xFF, 0xE0,													// jmp rax
-	};
-	constexpr size_t instructionsSize = sizeof(opcodes);
+	uintptr_t destination;
+	memcpy(&destination, pDestination, sizeof(uintptr_t));
 
-	memcpy(&opcodes[3], pDestination, sizeof(uintptr_t));
-	Patch(pSource, opcodes, instructionsSize);
+	std::vector<BYTE> opcodes(x86::Emitter::absJmpSize);
+	if (x86::Emitter(opcodes, 0).JmpAbsolute(destination).Failed()) opcodes.clear();
+	return opcodes;
+}
 
-	if (nWritten) *nWritten += instructionsSize;
+std::vector<BYTE> mem::detail::RelativeJumpBytes(const uintptr_t ulDistance)
+{
+	// Emitted at 0, the target is the distance from the end of the jmp
+	std::vector<BYTE> opcodes(x86::Emitter::relJmpSize);
+	if (x86::Emitter(opcodes, 0).JmpRel32(ulDistance + opcodes.size()).Failed()) opcodes.clear();
+	return opcodes;
 }
 
-void mem::RelativeJump(void* const pSource, const uintptr_t ulDistance)
+std::vector<BYTE> mem::detail::NopBytes(const size_t nSize)
 {
-	BYTE opcodes[] = {
-		0xE9, 0x00, 0x00, 0x00, 0x00 // jmp address
-	};
-	constexpr size_t instructionsSize = sizeof(opcodes);
+	std::vector<BYTE> nops(nSize);
+	x86::Emitter(nops).Nop(nSize);
+	return nops;
+}
 
-	memcpy(&opcodes[1], &ulDistance, sizeof(int32_t));
-	Patch(pSource, opcodes, instructionsSize);
+bool mem::AbsoluteJump(void* const pSource, const void* pDestination, size_t* const nWritten)
+{
+	const auto opcodes = detail::AbsoluteJumpBytes(pDestination);
+	if (opcodes.empty()) return false;
+	Patch(pSource, opcodes.data(), opcodes.size(), nWritten);
+	return true;
+}
+
+bool mem::RelativeJump(void* const pSource, const uintptr_t ulDistance)
+{
+	const auto opcodes = detail::RelativeJumpBytes(ulDistance);
+	if (opcodes.empty()) return false;
+	Patch(pSource, opcodes.data(), opcodes.size());
+	return true;
 }
 
 void mem::Patch(void* const pAddress, const BYTE* pCode, const size_t nSize, size_t* const nWritten)
@@ -120,16 +828,14 @@ void mem::Nop(void* const pAddress, const size_t nSize)
 {
 	DWORD flOldProtect;
 	VirtualProtect(pAddress, nSize, PAGE_EXECUTE_READWRITE, &flOldProtect);
-	FillWithAlignedNOPs(static_cast<BYTE*>(pAddress), nSize);
+	x86::Emitter({ static_cast<BYTE*>(pAddress), nSize }).Nop(nSize);
 	VirtualProtect(pAddress, nSize, flOldProtect, &flOldProtect);
 }
 
 void mem::NopEx(const HANDLE hProcess, void* pAddress, const size_t nSize)
 {
-	const auto nopArray = new BYTE[nSize];
-	FillWithAlignedNOPs(nopArray, nSize);
-	PatchEx(hProcess, pAddress, nopArray, nSize);
-	delete[] nopArray;
+	const auto nops = detail::NopBytes(nSize);
+	PatchEx(hProcess, pAddress, nops.data(), nSize);
 }
 
 void mem::Write(void* pAddress, const BYTE* pData, const size_t nSize, size_t* const nWritten)
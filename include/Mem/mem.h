@@ -1,12 +1,20 @@
 ﻿#pragma once
+#include <iterator>
+#include <ranges>
+#include <span>
 #include <vector>
 #include <windows.h>
 
+#include "pe.h"
+#include "region.h"
+#include "signature.h"
+
 namespace mem
 {
 	void* AllocateMemory(LPVOID lpAddress, DWORD flAllocationType = PAGE_EXECUTE_READWRITE);
-	void AbsoluteJump(void* pSource, const void* pDestination, size_t* nWritten = nullptr);
-	void RelativeJump(void* pSource, uintptr_t ulDistance);
+	// False (nothing written) when the jump can't be encoded: absolute jumps outside x64, relative ones beyond ±2 GB
+	bool AbsoluteJump(void* pSource, const void* pDestination, size_t* nWritten = nullptr);
+	bool RelativeJump(void* pSource, uintptr_t ulDistance);
 
 	void Patch(void* pAddress, const BYTE* pCode, size_t nSize, size_t* nWritten = nullptr);
 	void PatchEx(HANDLE hProcess, void* pAddress, const BYTE* pCode, size_t nSize);
@@ -14,12 +22,194 @@ namespace mem
 	void NopEx(HANDLE hProcess, void* pAddress, size_t nSize);
 	void Write(void* pAddress, const BYTE* pData, size_t nSize, size_t* nWritten = nullptr);
 
+	// Module scans only look at the sections selected by the filter (code by default)
+	template<typename T = std::uint8_t*>
+	T PatternScan(void* hModule, const char* pattern, bool bFastScan = false, const SectionFilter& sections = SectionFilter::Code);
+	template<typename T = std::uint8_t*>
+	T PatternScan(void* hModule, const SignatureView& signature, bool bFastScan = false, const SectionFilter& sections = SectionFilter::Code);
+	// Code-style signature: raw bytes and an "xx??x" mask of the same length
+	template<typename T = std::uint8_t*>
+	T PatternScan(void* hModule, const char* pattern, const char* mask, bool bFastScan = false, const SectionFilter& sections = SectionFilter::Code);
 	template<typename T = std::uint8_t*>
-	T PatternScan(void* hModule, const char* pattern, bool bFastScan);
+	T PatternScan(void* hModule, const std::vector<const char*>& patterns, bool bFastScan = false, const SectionFilter& sections = SectionFilter::Code);
 	template<typename T = std::uint8_t*>
-	T PatternScan(void* hModule, const std::vector<const char*>& patterns, bool bFastScan);
+	T PatternScan(void* hModule, const std::vector<SignatureView>& signatures, bool bFastScan = false, const SectionFilter& sections = SectionFilter::Code);
 	template<typename T = std::uint8_t*>
 	T PatternScan(PBYTE pBase, DWORD dwSize, const char* pattern, bool bFastScan);
+	template<typename T = std::uint8_t*>
+	T PatternScan(PBYTE pBase, DWORD dwSize, const SignatureView& signature, bool bFastScan);
+
+	// Scan of every region of the provider granting 'access' (executable code by default), in address order.
+	// Works the same on any platform the provider supports, e.g. against /proc/self/maps on Linux.
+	template<typename T = std::uint8_t*>
+	T PatternScan(RegionProvider& regions, const SignatureView& signature, RegionAccess access = RegionAccess::Read | RegionAccess::Execute, bool bFastScan = false);
+
+	// Module scan where bytes rewritten by base relocations match any pattern byte, so absolute addresses in x86 code don't need "??"
+	// and one signature works across rebased loads. The relocation bitmap of the module is built once (RelocationMap::ForModule).
+	template<typename T = std::uint8_t*>
+	T PatternScanRelocated(void* hModule, const SignatureView& signature, const SectionFilter& sections = SectionFilter::Code);
+
+	struct FuzzyMatch
+	{
+		std::uint8_t* address;
+		size_t mismatches;	// Non-wildcard bytes that differ
+	};
+
+	// Approximate scan for signatures broken by small updates: positions where at most maxMismatches non-wildcard bytes differ,
+	// fewest mismatches first (then lowest address), at most maxResults of them. Empty when the signature has no more than maxMismatches fixed bytes.
+	std::vector<FuzzyMatch> PatternScanFuzzy(void* hModule, const SignatureView& signature, size_t maxMismatches, size_t maxResults = 8, const SectionFilter& sections = SectionFilter::Code);
+	std::vector<FuzzyMatch> PatternScanFuzzy(PBYTE pBase, DWORD dwSize, const SignatureView& signature, size_t maxMismatches, size_t maxResults = 8);
+
+	std::vector<std::uint8_t*> PatternScanBatch(void* hModule, std::span<const SignatureView> signatures, bool bFastScan = false, const SectionFilter& sections = SectionFilter::Code);
+	std::vector<std::uint8_t*> PatternScanBatch(PBYTE pBase, DWORD dwSize, std::span<const SignatureView> signatures, bool bFastScan = false);
+
+	// Address referenced by a marked operand of a match ("48 8B 05 [rel32]": the address loaded by the mov), after its dereferences.
+	// Returns T{} if the signature has no such capture or a dereferenced pointer can't be read.
+	template<typename T = std::uint8_t*>
+	T ResolveCapture(const BYTE* pMatch, const SignatureView& signature, size_t index = 0);
+	// PatternScan + ResolveCapture
+	template<typename T = std::uint8_t*>
+	T PatternScanCapture(void* hModule, const SignatureView& signature, size_t index = 0, bool bFastScan = false, const SectionFilter& sections = SectionFilter::Code);
+
+	class PatternMatches;
+
+	// Every match in address order (overlapping ones included), found lazily while iterating:
+	//	for (std::uint8_t* pMatch : mem::PatternScanAll(hModule, signature)) ...
+	// The signature bytes must outlive the returned range.
+	PatternMatches PatternScanAll(void* hModule, const SignatureView& signature, bool bFastScan = false, const SectionFilter& sections = SectionFilter::Code);
+	PatternMatches PatternScanAll(PBYTE pBase, DWORD dwSize, const SignatureView& signature, bool bFastScan = false);
+	PatternMatches PatternScanAll(RegionProvider& regions, const SignatureView& signature, RegionAccess access = RegionAccess::Read | RegionAccess::Execute, bool bFastScan = false);
+
+	// Number of matches, stops scanning once 'limit' is reached (CountMatches(matches, 2) == 1 means the signature is unique)
+	size_t CountMatches(const PatternMatches& matches, size_t limit = SIZE_MAX);
+
+	namespace detail
+	{
+		// Bytes written by AbsoluteJump / RelativeJump / Nop, to batch them in a PatchTransaction. Empty when the jump can't be encoded.
+		std::vector<BYTE> AbsoluteJumpBytes(const void* pDestination);
+		std::vector<BYTE> RelativeJumpBytes(uintptr_t ulDistance);
+		std::vector<BYTE> NopBytes(size_t nSize);
+
+		// Matchers of FindPattern. Auto picks one from the CPU and the pattern, the others force it (benchmarks): SIMD levels the CPU
+		// lacks fall back to the next lower one, and signatures without an anchor always go through ShiftOr.
+		enum class ScanKernel : std::uint8_t
+		{
+			Auto,
+			Scalar,
+			SSE2,
+			AVX2,
+			ShiftOr
+		};
+
+		// Returns the first position where (pBase[n + i] & mask[i]) == bytes[i] holds for the whole signature, or nullptr.
+		// Candidates are located through the signature anchors (SSE2/AVX2 when available), then verified.
+		const BYTE* FindPattern(const BYTE* pBase, size_t nSize, const SignatureView& signature, bool bFastScan, ScanKernel kernel = ScanKernel::Auto);
+
+		// Same as FindPattern for many signatures at once, in a single pass over the range: results[i] receives the first match of signatures[i].
+		// Pending signatures are bucketed by anchor byte, so each position is only checked against the signatures anchored on its value.
+		// Signatures whose result is already set are skipped, so consecutive ranges can be chained.
+		void FindPatterns(const BYTE* pBase, size_t nSize, std::span<const SignatureView> signatures, std::span<const BYTE*> results, bool bFastScan);
+
+		// Same result as FindPattern, the range is split in overlapping chunks (by signature size - 1) scanned by up to nThreads workers (0 = hardware threads, at most 8).
+		// Chunks are taken in address order and skipped once a lower match is known, so the lowest match is always returned.
+		const BYTE* FindPatternParallel(const BYTE* pBase, size_t nSize, const SignatureView& signature, bool bFastScan, unsigned nThreads = 0);
+
+		// Appends every position of the range within maxMismatches of the signature (unsorted).
+		// The fixed bytes are split in maxMismatches + 1 pieces, one of which has to match exactly: candidates come from exact scans of the pieces,
+		// then the whole signature is compared 16 bytes at a time (SSE2) with the mismatches counted by popcount.
+		void FindPatternFuzzy(const BYTE* pBase, size_t nSize, const SignatureView& signature, size_t maxMismatches, std::vector<FuzzyMatch>& results);
+
+		// FindPattern where bytes marked in the relocation map match anything, rva is the RVA of pBase
+		const BYTE* FindPatternRelocated(const BYTE* pBase, size_t nSize, const SignatureView& signature, const RelocationMap& relocations, DWORD rva);
+
+		// Target of a capture at pMatch, 0 on failure
+		uintptr_t ResolveCapture(const BYTE* pMatch, const Capture& capture);
+
+		// Ranges at least this big are scanned in parallel by PatternScan
+		constexpr size_t parallelScanThreshold = 200 * 1024 * 1024;
+
+		// Committed, readable parts of the module sections matching the filter, in address order
+		std::vector<std::span<const BYTE>> ModuleRanges(void* hModule, const SectionFilter& sections);
+		// Regions of the provider granting 'access', in address order
+		std::vector<std::span<const BYTE>> RegionRanges(RegionProvider& regions, RegionAccess access);
+	}
+
+	class PatternMatches : public std::ranges::view_interface<PatternMatches>
+	{
+	public:
+		class iterator
+		{
+		public:
+			using value_type = std::uint8_t*;
+			using difference_type = std::ptrdiff_t;
+
+			iterator() = default;
+
+			value_type operator*() const noexcept { return const_cast<value_type>(pMatch); }
+
+			iterator& operator++()
+			{
+				Advance(pMatch + 1);
+				return *this;
+			}
+
+			iterator operator++(int)
+			{
+				auto previous = *this;
+				++*this;
+				return previous;
+			}
+
+			bool operator==(std::default_sentinel_t) const noexcept { return pMatch == nullptr; }
+
+		private:
+			friend PatternMatches;
+
+			const PatternMatches* pOwner = nullptr;
+			size_t nRange = 0;
+			const BYTE* pMatch = nullptr;
+
+			iterator(const PatternMatches* pOwner) : pOwner(pOwner)
+			{
+				if (const auto ranges = pOwner->Ranges(); !ranges.empty()) Advance(ranges.front().data());
+			}
+
+			// Next match at or after pFrom, moving on to the following ranges when the current one is exhausted
+			void Advance(const BYTE* pFrom)
+			{
+				const auto ranges = pOwner->Ranges();
+				for (; nRange < ranges.size(); pFrom = ++nRange < ranges.size() ? ranges[nRange].data() : nullptr)
+				{
+					const auto& range = ranges[nRange];
+					const size_t nOffset = static_cast<size_t>(pFrom - range.data());
+					if (nOffset >= range.size()) continue;
+
+					if ((pMatch = detail::FindPattern(pFrom, range.size() - nOffset, pOwner->signature, pOwner->bFastScan))) return;
+				}
+				pMatch = nullptr;
+			}
+		};
+
+		PatternMatches() = default;
+		PatternMatches(std::span<const BYTE> range, const SignatureView& signature, const bool bFastScan) : range(range), signature(signature), bFastScan(bFastScan) {}
+		PatternMatches(std::vector<std::span<const BYTE>> ranges, const SignatureView& signature, const bool bFastScan) : moduleRanges(std::move(ranges)), signature(signature), bFastScan(bFastScan) {}
+
+		[[nodiscard]] iterator begin() const { return iterator(this); }
+		[[nodiscard]] std::default_sentinel_t end() const noexcept { return {}; }
+
+	private:
+		std::span<const BYTE> range;
+		std::vector<std::span<const BYTE>> moduleRanges;
+		SignatureView signature;
+		bool bFastScan = false;
+
+		[[nodiscard]] std::span<const std::span<const BYTE>> Ranges() const noexcept
+		{
+			if (!moduleRanges.empty()) return moduleRanges;
+			if (range.empty()) return {};
+			return { &range, 1 };
+		}
+	};
 
 	template <typename T>
 	T FindDMAAddy(const uintptr_t uAddress, const std::vector<unsigned int>& offsets)
@@ -65,77 +255,135 @@ namespace mem
 	}
 
 	template<typename T>
-	T PatternScan(void* hModule, const char* pattern, const bool bFastScan = false)
+	T ResolveCapture(const BYTE* pMatch, const SignatureView& signature, const size_t index)
+	{
+		if (!pMatch || index >= signature.captureCount) return T{};
+		return reinterpret_cast<T>(detail::ResolveCapture(pMatch, signature.captures[index]));
+	}
+
+	template<typename T>
+	T PatternScanCapture(void* hModule, const SignatureView& signature, const size_t index, const bool bFastScan, const SectionFilter& sections)
 	{
-		const auto moduleBase = static_cast<std::uint8_t*>(hModule);
-		const auto ntHeaders = reinterpret_cast<PIMAGE_NT_HEADERS>(moduleBase + static_cast<PIMAGE_DOS_HEADER>(hModule)->e_lfanew);
-		return reinterpret_cast<T>(PatternScan(moduleBase, ntHeaders->OptionalHeader.SizeOfImage, pattern, bFastScan));
+		return ResolveCapture<T>(PatternScan(hModule, signature, bFastScan, sections), signature, index);
 	}
 
 	template<typename T>
-	T PatternScan(void* hModule, const std::vector<const char*>& patterns, const bool bFastScan = false)
+	T PatternScan(void* hModule, const char* pattern, const bool bFastScan, const SectionFilter& sections)
 	{
-		for (const auto& pattern : patterns)
+		const size_t patternSize = strlen(pattern);
+		const auto patternBytes = static_cast<PBYTE>(_alloca(detail::PatternCapacity(patternSize)));
+		const auto patternMask = static_cast<PBYTE>(_alloca(detail::PatternCapacity(patternSize)));
+
+		SignatureView signature{ patternBytes, patternMask };
+		if (!detail::ParsePattern({ pattern, patternSize }, patternBytes, patternMask, signature.size)) return T{};
+		detail::SelectAnchors(signature);
+
+		return PatternScan<T>(hModule, signature, bFastScan, sections);
+	}
+
+	template<typename T>
+	T PatternScan(void* hModule, const SignatureView& signature, const bool bFastScan, const SectionFilter& sections)
+	{
+		for (const auto& range : detail::ModuleRanges(hModule, sections))
 		{
-			if (auto address = PatternScan<std::uint8_t*>(hModule, pattern, bFastScan))
+			if (auto address = PatternScan<std::uint8_t*>(const_cast<PBYTE>(range.data()), static_cast<DWORD>(range.size()), signature, bFastScan))
 				return reinterpret_cast<T>(address);
 		}
-		return reinterpret_cast<T>(nullptr);
+		return T{};
 	}
 
-#define INRANGE(x,a,b)		((x) >= (a) && (x) <= (b)) 
-#define getBits(x)			(INRANGE((x),'0','9') ? ((x) - '0') : (((x)&(~0x20)) - 'A' + 0xa))
-#define getByte(x)			(getBits((x)[0]) << 4 | getBits((x)[1]))
+	template<typename T>
+	T PatternScan(RegionProvider& regions, const SignatureView& signature, const RegionAccess access, const bool bFastScan)
+	{
+		for (const auto& range : detail::RegionRanges(regions, access))
+		{
+			if (const BYTE* pMatch = detail::FindPattern(range.data(), range.size(), signature, bFastScan))
+				return reinterpret_cast<T>(const_cast<PBYTE>(pMatch));
+		}
+		return T{};
+	}
 
 	template<typename T>
-	T PatternScan(const PBYTE pBase, const DWORD dwSize, const char* pattern, const bool bFastScan)
+	T PatternScan(void* hModule, const char* pattern, const char* mask, const bool bFastScan, const SectionFilter& sections)
 	{
-		const size_t patternSize = strlen(pattern);
-		const auto patternBase = static_cast<PBYTE>(_alloca(patternSize));
-		const auto maskBase = static_cast<bool*>(_alloca(patternSize));
-		PBYTE patternBytes = patternBase;
-		bool* patternMask = maskBase;
+		const size_t patternSize = strlen(mask);
+		const auto patternBytes = static_cast<PBYTE>(_alloca(patternSize));
+		const auto patternMask = static_cast<PBYTE>(_alloca(patternSize));
+
+		SignatureView signature{ patternBytes, patternMask };
+		if (!detail::ParseCodePattern(pattern, { mask, patternSize }, patternBytes, patternMask, signature.size)) return T{};
+		detail::SelectAnchors(signature);
 
-		size_t nBytes = 0;
+		return PatternScan<T>(hModule, signature, bFastScan, sections);
+	}
 
-		while (*pattern)
+	template<typename T>
+	T PatternScanRelocated(void* hModule, const SignatureView& signature, const SectionFilter& sections)
+	{
+		const RelocationMap& relocations = RelocationMap::ForModule(static_cast<HMODULE>(hModule));
+		for (const auto& range : detail::ModuleRanges(hModule, sections))
 		{
-			if (*pattern == ' ') pattern++;
-			if (*pattern == '?')
-			{
-				pattern++;
-				if (*pattern == '?') pattern++;
-				*patternBytes++ = 0;
-				*patternMask++ = false;
-			}
-			else
-			{
-				*patternBytes++ = getByte(pattern);
-				*patternMask++ = true;
-				pattern += 2;
-			}
-			nBytes++;
+			const DWORD rva = static_cast<DWORD>(range.data() - static_cast<const BYTE*>(hModule));
+			if (const BYTE* pMatch = detail::FindPatternRelocated(range.data(), range.size(), signature, relocations, rva))
+				return reinterpret_cast<T>(const_cast<PBYTE>(pMatch));
 		}
+		return T{};
+	}
+
+	template<typename T>
+	T PatternScan(void* hModule, const std::vector<const char*>& patterns, const bool bFastScan, const SectionFilter& sections)
+	{
+		std::vector<BYTE> storage;
+		std::vector<SignatureView> signatures(patterns.size());
 
-		// Fast scan: check only 4-byte aligned addresses.
-		const DWORD step = bFastScan ? 4 : 1;
-		const DWORD alignedStart = bFastScan ? static_cast<DWORD>((reinterpret_cast<uintptr_t>(pBase) + 3 & ~3) - reinterpret_cast<uintptr_t>(pBase)) : 0;
+		size_t nTotal = 0;
+		for (const auto& pattern : patterns) nTotal += detail::PatternCapacity(strlen(pattern));
+		storage.resize(nTotal * 2);
 
-		for (DWORD n = alignedStart; n <= dwSize - nBytes; n += step)
+		PBYTE pStorage = storage.data();
+		for (size_t i = 0; i < patterns.size(); i++)
 		{
-			if (pBase[n] == patternBase[0] && pBase[n + nBytes - 1] == patternBase[nBytes - 1])
-			{
-				size_t pos = 1;
-				while (pos < nBytes && (pBase[n + pos] == patternBase[pos] || !maskBase[pos]))
-				{
-					pos++;
-				}
-				if (pos == nBytes)
-				{
-					return reinterpret_cast<T>(pBase + n);
-				}
-			}
+			const size_t patternSize = strlen(patterns[i]);
+			const size_t capacity = detail::PatternCapacity(patternSize);
+			SignatureView& signature = signatures[i];
+			signature.bytes = pStorage;
+			signature.mask = pStorage + capacity;
+			if (detail::ParsePattern({ patterns[i], patternSize }, pStorage, pStorage + capacity, signature.size)) detail::SelectAnchors(signature);
+			else signature.size = 0;
+			pStorage += capacity * 2;
+		}
+		return PatternScan<T>(hModule, signatures, bFastScan, sections);
+	}
+
+	template<typename T>
+	T PatternScan(void* hModule, const std::vector<SignatureView>& signatures, const bool bFastScan, const SectionFilter& sections)
+	{
+		// One pass for every alternative, the first one (in order) that matched wins
+		for (const auto address : PatternScanBatch(hModule, signatures, bFastScan, sections))
+		{
+			if (address) return reinterpret_cast<T>(address);
 		}
-		return reinterpret_cast<T>(nullptr);
+		return T{};
+	}
+
+	template<typename T>
+	T PatternScan(const PBYTE pBase, const DWORD dwSize, const char* pattern, const bool bFastScan)
+	{
+		const size_t patternSize = strlen(pattern);
+		const auto patternBytes = static_cast<PBYTE>(_alloca(detail::PatternCapacity(patternSize)));
+		const auto patternMask = static_cast<PBYTE>(_alloca(detail::PatternCapacity(patternSize)));
+
+		SignatureView signature{ patternBytes, patternMask };
+		if (!detail::ParsePattern({ pattern, patternSize }, patternBytes, patternMask, signature.size)) return T{};
+		detail::SelectAnchors(signature);
+
+		return PatternScan<T>(pBase, dwSize, signature, bFastScan);
+	}
+
+	template<typename T>
+	T PatternScan(const PBYTE pBase, const DWORD dwSize, const SignatureView& signature, const bool bFastScan)
+	{
+		const BYTE* pMatch = dwSize >= detail::parallelScanThreshold ? detail::FindPatternParallel(pBase, dwSize, signature, bFastScan) : detail::FindPattern(pBase, dwSize, signature, bFastScan);
+		return reinterpret_cast<T>(const_cast<PBYTE>(pMatch));
 	}
 }
\ No newline at end of file
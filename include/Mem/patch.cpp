@@ -0,0 +1,219 @@
+﻿#include "patch.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "region.h"
+#endif
+
+namespace
+{
+#ifdef _WIN32
+	class VirtualProtectProtector final : public mem::PageProtector
+	{
+	public:
+		// VirtualProtect reports the protection of the first page only, the range is cut where VirtualQuery sees another one
+		size_t Unprotect(const std::uintptr_t address, const size_t size, std::uint32_t& previous) override
+		{
+			MEMORY_BASIC_INFORMATION mbi;
+			if (!VirtualQuery(reinterpret_cast<LPCVOID>(address), &mbi, sizeof(mbi)) || mbi.State != MEM_COMMIT) return 0;
+
+			const size_t nSize = std::min(size, reinterpret_cast<std::uintptr_t>(mbi.BaseAddress) + mbi.RegionSize - address);
+			if ((mbi.Protect & (PAGE_READWRITE | PAGE_EXECUTE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_WRITECOPY)) && !(mbi.Protect & PAGE_GUARD))
+			{
+				previous = alreadyWritable;
+				return nSize;
+			}
+
+			DWORD flOldProtect;
+			if (!VirtualProtect(reinterpret_cast<LPVOID>(address), nSize, PAGE_EXECUTE_READWRITE, &flOldProtect)) return 0;
+			previous = flOldProtect;
+			return nSize;
+		}
+
+		bool Restore(const std::uintptr_t address, const size_t size, const std::uint32_t previous) override
+		{
+			DWORD flOldProtect;
+			return VirtualProtect(reinterpret_cast<LPVOID>(address), size, previous, &flOldProtect);
+		}
+	};
+#elif defined(__linux__)
+	// mprotect doesn't return the previous protection, it comes from the cached region list (trusted until invalidated, as for safe reads)
+	class MprotectProtector final : public mem::PageProtector
+	{
+	public:
+		size_t Unprotect(const std::uintptr_t address, const size_t size, std::uint32_t& previous) override
+		{
+			const auto region = mem::RegionProvider::Default().Find(address);
+			if (!region) return 0;
+
+			int protection = 0;
+			if (mem::HasAccess(region->access, mem::RegionAccess::Read)) protection |= PROT_READ;
+			if (mem::HasAccess(region->access, mem::RegionAccess::Write)) protection |= PROT_WRITE;
+			if (mem::HasAccess(region->access, mem::RegionAccess::Execute)) protection |= PROT_EXEC;
+
+			const size_t nSize = std::min(size, region->End() - address);
+			if (protection & PROT_WRITE)
+			{
+				previous = alreadyWritable;
+				return nSize;
+			}
+			if (mprotect(reinterpret_cast<void*>(address), nSize, protection | PROT_READ | PROT_WRITE)) return 0;
+			previous = static_cast<std::uint32_t>(protection);
+			return nSize;
+		}
+
+		bool Restore(const std::uintptr_t address, const size_t size, const std::uint32_t previous) override
+		{
+			return mprotect(reinterpret_cast<void*>(address), size, static_cast<int>(previous)) == 0;
+		}
+	};
+#endif
+}
+
+size_t mem::PageProtector::PageSize() const noexcept
+{
+#ifdef _WIN32
+	static const size_t pageSize = []
+	{
+		SYSTEM_INFO sysInfo;
+		GetSystemInfo(&sysInfo);
+		return static_cast<size_t>(sysInfo.dwPageSize);
+	}();
+#else
+	static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+	return pageSize;
+}
+
+mem::PageProtector& mem::PageProtector::Default()
+{
+#ifdef _WIN32
+	static VirtualProtectProtector protector;
+#else
+	static MprotectProtector protector;
+#endif
+	return protector;
+}
+
+// Unprotects the pages touched by the writes once, as runs of consecutive pages, runs fn, then restores them
+template<typename Fn>
+bool mem::PatchTransaction::Apply(Fn&& fn)
+{
+	struct Run
+	{
+		std::uintptr_t address;
+		size_t size;
+		std::uint32_t previous;
+	};
+
+	const std::uintptr_t pageMask = protector.PageSize() - 1;
+	std::vector<Run> spans;
+	spans.reserve(entries.size());
+	for (const auto& entry : entries)
+	{
+		const std::uintptr_t first = entry.address & ~pageMask;
+		spans.push_back({ first, ((entry.address + entry.size + pageMask) & ~pageMask) - first, 0 });
+	}
+	std::ranges::sort(spans, {}, &Run::address);
+
+	// Overlapping or adjacent page spans merged
+	std::vector<Run> runs;
+	for (const auto& span : spans)
+	{
+		if (!runs.empty() && span.address <= runs.back().address + runs.back().size)
+		{
+			runs.back().size = std::max(runs.back().size, span.address + span.size - runs.back().address);
+		}
+		else runs.push_back(span);
+	}
+
+	stats.writes = entries.size();
+	stats.pages = 0;
+	for (const auto& run : runs) stats.pages += run.size / (pageMask + 1);
+	stats.naiveSyscalls += 2 * entries.size();
+
+	// A run is split where the protection changes, each part restored to its own
+	std::vector<Run> unprotected;
+	for (const auto& run : runs)
+	{
+		for (std::uintptr_t address = run.address; address < run.address + run.size;)
+		{
+			std::uint32_t previous = 0;
+			const size_t nSize = protector.Unprotect(address, run.address + run.size - address, previous);
+			if (!nSize)
+			{
+				stats.syscalls++;
+				// Nothing written yet, put the pages already changed back
+				for (const auto& part : unprotected)
+				{
+					stats.syscalls++;
+					protector.Restore(part.address, part.size, part.previous);
+				}
+				return false;
+			}
+			if (previous != PageProtector::alreadyWritable)
+			{
+				stats.syscalls++;
+				unprotected.push_back({ address, nSize, previous });
+			}
+			address += nSize;
+		}
+	}
+	stats.runs = unprotected.size();
+
+	fn();
+
+	for (const auto& part : unprotected)
+	{
+		stats.syscalls++;
+		protector.Restore(part.address, part.size, part.previous);
+	}
+	return true;
+}
+
+void mem::PatchTransaction::Write(void* pAddress, const void* pData, const size_t nSize, size_t* const nWritten)
+{
+	if (nWritten) *nWritten += nSize;
+	if (!nSize) return;
+
+	entries.push_back({ reinterpret_cast<std::uintptr_t>(pAddress), bytes.size(), nSize });
+	bytes.insert(bytes.end(), static_cast<const std::uint8_t*>(pData), static_cast<const std::uint8_t*>(pData) + nSize);
+}
+
+bool mem::PatchTransaction::Commit()
+{
+	if (bCommitted) return false;
+
+	original.resize(bytes.size());
+	bCommitted = Apply([this]
+	{
+		for (const auto& entry : entries)
+		{
+			memcpy(original.data() + entry.offset, reinterpret_cast<const void*>(entry.address), entry.size);
+			memcpy(reinterpret_cast<void*>(entry.address), bytes.data() + entry.offset, entry.size);
+		}
+	});
+	return bCommitted;
+}
+
+bool mem::PatchTransaction::Rollback()
+{
+	if (!bCommitted) return false;
+
+	// Reverse order, so overlapping writes end up with the bytes from before the first one
+	bCommitted = !Apply([this]
+	{
+		for (auto entry = entries.rbegin(); entry != entries.rend(); ++entry)
+		{
+			memcpy(reinterpret_cast<void*>(entry->address), original.data() + entry->offset, entry->size);
+		}
+	});
+	return !bCommitted;
+}
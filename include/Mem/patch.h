@@ -0,0 +1,76 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace mem
+{
+	// Page protection backend of PatchTransaction: VirtualProtect on Windows, mprotect on Linux
+	class PageProtector
+	{
+	public:
+		virtual ~PageProtector() = default;
+
+		// 'previous' of pages that were writable already: their protection is left alone and there is nothing to restore
+		static constexpr std::uint32_t alreadyWritable = UINT32_MAX;
+
+		// Makes the pages from 'address' writable (and executable if they were), up to 'size' bytes or the first page with another
+		// protection. Returns the bytes unprotected (0 on failure), 'previous' receiving what Restore needs for them.
+		virtual size_t Unprotect(std::uintptr_t address, size_t size, std::uint32_t& previous) = 0;
+		virtual bool Restore(std::uintptr_t address, size_t size, std::uint32_t previous) = 0;
+		[[nodiscard]] virtual size_t PageSize() const noexcept;
+
+		static PageProtector& Default();
+	};
+
+	// Writes to protected memory (code, vtables, import tables) applied as one batch: the pages touched are made writable once,
+	// consecutive pages with one protection in a single call, the writes are applied in recording order, then the protections are restored. Writable pages
+	// (heap vtables, RW import tables) are written as they are. A page that can't be unprotected aborts the commit before anything is written. A committed transaction can be rolled back, which restores the replaced bytes the same way.
+	class PatchTransaction
+	{
+	public:
+		struct Stats
+		{
+			size_t writes = 0;
+			size_t pages = 0;
+			size_t runs = 0;			// Consecutive pages unprotected together
+			size_t syscalls = 0;		// Protection changes made, commit and rollback
+			size_t naiveSyscalls = 0;	// Protection changes of a mem::Patch per write
+		};
+
+		explicit PatchTransaction(PageProtector& protector = PageProtector::Default()) : protector(protector) {}
+
+		// Same as mem::Write, recorded until Commit
+		void Write(void* pAddress, const void* pData, size_t nSize, size_t* nWritten = nullptr);
+		void Write(void* pAddress, const std::span<const std::uint8_t> bytes, size_t* nWritten = nullptr) { Write(pAddress, bytes.data(), bytes.size(), nWritten); }
+		template<typename T> requires std::is_trivially_copyable_v<T>
+		void Write(void* pAddress, const T& value) { Write(pAddress, &value, sizeof(T)); }
+
+		bool Commit();
+		bool Rollback();
+
+		[[nodiscard]] bool IsCommitted() const noexcept { return bCommitted; }
+		[[nodiscard]] const Stats& GetStats() const noexcept { return stats; }
+		[[nodiscard]] std::ptrdiff_t SyscallsSaved() const noexcept { return static_cast<std::ptrdiff_t>(stats.naiveSyscalls) - static_cast<std::ptrdiff_t>(stats.syscalls); }
+
+	private:
+		struct Entry
+		{
+			std::uintptr_t address;
+			size_t offset;	// Into bytes and original
+			size_t size;
+		};
+
+		PageProtector& protector;
+		std::vector<Entry> entries;
+		std::vector<std::uint8_t> bytes;
+		std::vector<std::uint8_t> original;	// Bytes replaced by the commit
+		bool bCommitted = false;
+		Stats stats;
+
+		template<typename Fn>
+		bool Apply(Fn&& fn);
+	};
+}
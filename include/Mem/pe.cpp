@@ -0,0 +1,259 @@
+﻿#include "pe.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace
+{
+	// SizeOfImage of a module loaded in this process (same architecture, so IMAGE_NT_HEADERS fits)
+	size_t MappedImageSize(const HMODULE hModule)
+	{
+		if (!hModule) return 0;
+
+		const auto dosHeader = reinterpret_cast<const IMAGE_DOS_HEADER*>(hModule);
+		if (dosHeader->e_magic != IMAGE_DOS_SIGNATURE) return 0;
+
+		const auto ntHeaders = reinterpret_cast<const IMAGE_NT_HEADERS*>(reinterpret_cast<const BYTE*>(hModule) + dosHeader->e_lfanew);
+		return ntHeaders->Signature == IMAGE_NT_SIGNATURE ? ntHeaders->OptionalHeader.SizeOfImage : 0;
+	}
+}
+
+mem::PEView::PEView(const void* pBase, const size_t nSize, const ImageLayout layout): pBase(static_cast<const BYTE*>(pBase)), nSize(nSize), layout(layout)
+{
+	if (!pBase || nSize < sizeof(IMAGE_DOS_HEADER)) return;
+
+	const auto dosHeader = static_cast<const IMAGE_DOS_HEADER*>(pBase);
+	if (dosHeader->e_magic != IMAGE_DOS_SIGNATURE || dosHeader->e_lfanew < 0) return;
+
+	const size_t ntOffset = static_cast<size_t>(dosHeader->e_lfanew);
+	if (ntOffset + sizeof(IMAGE_NT_HEADERS32) > nSize) return;
+
+	const auto ntHeaders = reinterpret_cast<const IMAGE_NT_HEADERS32*>(this->pBase + ntOffset);
+	if (ntHeaders->Signature != IMAGE_NT_SIGNATURE) return;
+
+	switch (ntHeaders->OptionalHeader.Magic)
+	{
+	case IMAGE_NT_OPTIONAL_HDR32_MAGIC:
+		bIs64 = false;
+		break;
+	case IMAGE_NT_OPTIONAL_HDR64_MAGIC:
+		if (ntOffset + sizeof(IMAGE_NT_HEADERS64) > nSize) return;
+		bIs64 = true;
+		break;
+	default:
+		return;
+	}
+
+	// Section table must be inside the view as well
+	const size_t sectionsOffset = ntOffset + offsetof(IMAGE_NT_HEADERS32, OptionalHeader) + ntHeaders->FileHeader.SizeOfOptionalHeader;
+	if (sectionsOffset + ntHeaders->FileHeader.NumberOfSections * sizeof(IMAGE_SECTION_HEADER) > nSize) return;
+
+	pNtHeaders = ntHeaders;
+}
+
+mem::PEView::PEView(const HMODULE hModule): PEView(hModule, MappedImageSize(hModule), ImageLayout::Mapped) {}
+
+const IMAGE_FILE_HEADER& mem::PEView::FileHeader() const noexcept
+{
+	return static_cast<const IMAGE_NT_HEADERS32*>(pNtHeaders)->FileHeader;
+}
+
+DWORD mem::PEView::SizeOfImage() const noexcept
+{
+	return VisitHeaders([](const auto& headers) { return headers.OptionalHeader.SizeOfImage; });
+}
+
+DWORD mem::PEView::CheckSum() const noexcept
+{
+	return VisitHeaders([](const auto& headers) { return headers.OptionalHeader.CheckSum; });
+}
+
+ULONGLONG mem::PEView::ImageBase() const noexcept
+{
+	return VisitHeaders([](const auto& headers) { return static_cast<ULONGLONG>(headers.OptionalHeader.ImageBase); });
+}
+
+IMAGE_DATA_DIRECTORY mem::PEView::DataDirectory(const DWORD index) const noexcept
+{
+	return VisitHeaders([index](const auto& headers) -> IMAGE_DATA_DIRECTORY
+	{
+		if (index >= headers.OptionalHeader.NumberOfRvaAndSizes || index >= std::size(headers.OptionalHeader.DataDirectory)) return {};
+		return headers.OptionalHeader.DataDirectory[index];
+	});
+}
+
+std::span<const IMAGE_SECTION_HEADER> mem::PEView::Sections() const noexcept
+{
+	if (!IsValid()) return {};
+
+	const auto ntHeaders = static_cast<const IMAGE_NT_HEADERS32*>(pNtHeaders);
+	const auto firstSection = reinterpret_cast<const IMAGE_SECTION_HEADER*>(reinterpret_cast<const BYTE*>(ntHeaders) + offsetof(IMAGE_NT_HEADERS32, OptionalHeader) + ntHeaders->FileHeader.SizeOfOptionalHeader);
+	return { firstSection, ntHeaders->FileHeader.NumberOfSections };
+}
+
+const IMAGE_SECTION_HEADER* mem::PEView::SectionFromRva(const DWORD rva) const noexcept
+{
+	for (const auto& section : Sections())
+	{
+		const DWORD size = section.Misc.VirtualSize ? section.Misc.VirtualSize : section.SizeOfRawData;
+		if (rva >= section.VirtualAddress && rva < section.VirtualAddress + size) return &section;
+	}
+	return nullptr;
+}
+
+std::span<const BYTE> mem::PEView::SectionData(const IMAGE_SECTION_HEADER& section) const noexcept
+{
+	size_t offset, size;
+	if (layout == ImageLayout::Mapped)
+	{
+		offset = section.VirtualAddress;
+		size = section.Misc.VirtualSize ? section.Misc.VirtualSize : section.SizeOfRawData;
+	}
+	else
+	{
+		// Only the initialized part exists on disk
+		offset = section.PointerToRawData;
+		size = section.Misc.VirtualSize ? std::min(section.Misc.VirtualSize, section.SizeOfRawData) : section.SizeOfRawData;
+	}
+
+	if (offset >= nSize) return {};
+	return { pBase + offset, std::min(size, nSize - offset) };
+}
+
+std::vector<std::span<const BYTE>> mem::PEView::SectionRanges(const SectionFilter& filter) const
+{
+	std::vector<std::span<const BYTE>> sections;
+	for (const auto& section : Sections())
+	{
+		if (!filter.Matches(section.Characteristics)) continue;
+		if (const auto data = SectionData(section); !data.empty()) sections.push_back(data);
+	}
+	std::ranges::sort(sections, {}, [](const std::span<const BYTE>& range) { return range.data(); });
+
+	std::vector<std::span<const BYTE>> ranges;
+	for (const auto& data : sections)
+	{
+		if (!ranges.empty() && ranges.back().data() + ranges.back().size() >= data.data())
+		{
+			const BYTE* pEnd = std::max(ranges.back().data() + ranges.back().size(), data.data() + data.size());
+			ranges.back() = { ranges.back().data(), static_cast<size_t>(pEnd - ranges.back().data()) };
+		}
+		else ranges.push_back(data);
+	}
+	return ranges;
+}
+
+const BYTE* mem::PEView::RvaToPointer(const DWORD rva) const noexcept
+{
+	if (layout == ImageLayout::Mapped) return rva < nSize ? pBase + rva : nullptr;
+
+	const auto section = SectionFromRva(rva);
+	if (!section) return rva < nSize ? pBase + rva : nullptr; // Headers
+
+	const size_t offset = section->PointerToRawData + (rva - section->VirtualAddress);
+	return rva - section->VirtualAddress < section->SizeOfRawData && offset < nSize ? pBase + offset : nullptr;
+}
+
+DWORD mem::PEView::PointerToRva(const BYTE* pAddress) const noexcept
+{
+	if (pAddress < pBase || pAddress >= pBase + nSize) return 0;
+
+	const size_t offset = pAddress - pBase;
+	if (layout == ImageLayout::Mapped) return static_cast<DWORD>(offset);
+
+	for (const auto& section : Sections())
+	{
+		if (offset >= section.PointerToRawData && offset < section.PointerToRawData + section.SizeOfRawData)
+		{
+			return static_cast<DWORD>(section.VirtualAddress + (offset - section.PointerToRawData));
+		}
+	}
+	return static_cast<DWORD>(offset); // Headers
+}
+
+mem::RelocationMap::RelocationMap(const PEView& image)
+{
+	if (!image.IsValid()) return;
+
+	const IMAGE_DATA_DIRECTORY directory = image.DataDirectory(IMAGE_DIRECTORY_ENTRY_BASERELOC);
+	const BYTE* pDirectory = directory.Size ? image.RvaToPointer(directory.VirtualAddress) : nullptr;
+	if (!pDirectory || directory.Size > static_cast<size_t>(image.Base() + image.Size() - pDirectory)) return;
+
+	pageIndex.assign((image.SizeOfImage() + pageSize - 1) / pageSize, noPage);
+
+	for (DWORD offset = 0; directory.Size - offset >= sizeof(IMAGE_BASE_RELOCATION);)
+	{
+		const auto pBlock = reinterpret_cast<const IMAGE_BASE_RELOCATION*>(pDirectory + offset);
+		if (pBlock->SizeOfBlock < sizeof(IMAGE_BASE_RELOCATION) || pBlock->SizeOfBlock > directory.Size - offset) break;
+
+		const auto pEntries = reinterpret_cast<const WORD*>(pBlock + 1);
+		const size_t nEntries = (pBlock->SizeOfBlock - sizeof(IMAGE_BASE_RELOCATION)) / sizeof(WORD);
+		for (size_t i = 0; i < nEntries; i++)
+		{
+			const DWORD rva = pBlock->VirtualAddress + (pEntries[i] & 0x0FFF);
+			switch (pEntries[i] >> 12)
+			{
+			case IMAGE_REL_BASED_HIGHLOW:
+				Mark(rva, 4);
+				break;
+			case IMAGE_REL_BASED_DIR64:
+				Mark(rva, 8);
+				break;
+			case IMAGE_REL_BASED_HIGH:
+			case IMAGE_REL_BASED_LOW:
+				Mark(rva, 2);
+				break;
+			case IMAGE_REL_BASED_HIGHADJ:
+				Mark(rva, 2);
+				i++; // Followed by the low half of the adjustment
+				break;
+			default:
+				break; // IMAGE_REL_BASED_ABSOLUTE padding, other architectures
+			}
+		}
+		offset += pBlock->SizeOfBlock;
+	}
+}
+
+const mem::RelocationMap& mem::RelocationMap::ForModule(const HMODULE hModule)
+{
+	static std::mutex mutex;
+	static std::unordered_map<HMODULE, std::unique_ptr<RelocationMap>> modules;
+
+	std::lock_guard lock(mutex);
+	auto& relocations = modules[hModule];
+	if (!relocations) relocations = std::make_unique<RelocationMap>(PEView(hModule));
+	return *relocations;
+}
+
+bool mem::RelocationMap::IsRelocated(const DWORD rva) const noexcept
+{
+	const std::uint64_t* pBitmap = PageBitmap(rva);
+	return pBitmap && pBitmap[rva % pageSize / 64] >> (rva % 64) & 1;
+}
+
+const std::uint64_t* mem::RelocationMap::PageBitmap(const DWORD rva) const noexcept
+{
+	const size_t page = rva / pageSize;
+	if (page >= pageIndex.size() || pageIndex[page] == noPage) return nullptr;
+	return bitmaps[pageIndex[page]].data();
+}
+
+void mem::RelocationMap::Mark(const DWORD rva, const DWORD nSize)
+{
+	// A fixup may straddle two pages
+	for (DWORD i = rva; i - rva < nSize; i++)
+	{
+		const size_t page = i / pageSize;
+		if (page >= pageIndex.size()) return;
+
+		if (pageIndex[page] == noPage)
+		{
+			pageIndex[page] = static_cast<std::uint32_t>(bitmaps.size());
+			bitmaps.emplace_back();
+		}
+		bitmaps[pageIndex[page]][i % pageSize / 64] |= 1ull << (i % 64);
+	}
+}
@@ -0,0 +1,110 @@
+﻿#pragma once
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <windows.h>
+
+namespace mem
+{
+	// Section selection by characteristics: a section is kept when it has every 'required' flag and none of the 'excluded' ones.
+	struct SectionFilter
+	{
+		DWORD required = 0;
+		DWORD excluded = 0;
+
+		[[nodiscard]] constexpr bool Matches(const DWORD characteristics) const noexcept
+		{
+			return (characteristics & required) == required && !(characteristics & excluded);
+		}
+
+		static const SectionFilter Any;
+		static const SectionFilter Code;			// Executable sections (.text, ...)
+		static const SectionFilter ReadOnlyData;	// Initialized, read-only, non executable sections (.rdata, ...)
+		static const SectionFilter Data;			// Writable, non executable sections (.data, ...)
+	};
+
+	inline constexpr SectionFilter SectionFilter::Any{};
+	inline constexpr SectionFilter SectionFilter::Code{ IMAGE_SCN_MEM_EXECUTE, 0 };
+	inline constexpr SectionFilter SectionFilter::ReadOnlyData{ IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ, IMAGE_SCN_MEM_WRITE | IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_MEM_DISCARDABLE };
+	inline constexpr SectionFilter SectionFilter::Data{ IMAGE_SCN_MEM_WRITE, IMAGE_SCN_MEM_EXECUTE };
+
+	enum class ImageLayout : std::uint8_t
+	{
+		Mapped,	///< Loaded by the OS loader (sections at their RVA).
+		File	///< Raw file contents (sections at PointerToRawData).
+	};
+
+	// Zero-copy view over the headers of a PE image, either mapped or read from disk.
+	class PEView
+	{
+	public:
+		PEView(const void* pBase, size_t nSize, ImageLayout layout = ImageLayout::Mapped);
+		explicit PEView(HMODULE hModule);
+
+		[[nodiscard]] bool IsValid() const noexcept { return pNtHeaders != nullptr; }
+		[[nodiscard]] bool Is64() const noexcept { return bIs64; }
+		[[nodiscard]] ImageLayout Layout() const noexcept { return layout; }
+		[[nodiscard]] const BYTE* Base() const noexcept { return pBase; }
+		[[nodiscard]] size_t Size() const noexcept { return nSize; }
+
+		[[nodiscard]] const IMAGE_FILE_HEADER& FileHeader() const noexcept;
+		[[nodiscard]] DWORD SizeOfImage() const noexcept;
+		[[nodiscard]] DWORD CheckSum() const noexcept;
+		[[nodiscard]] ULONGLONG ImageBase() const noexcept;
+		[[nodiscard]] IMAGE_DATA_DIRECTORY DataDirectory(DWORD index) const noexcept;
+
+		[[nodiscard]] std::span<const IMAGE_SECTION_HEADER> Sections() const noexcept;
+		[[nodiscard]] const IMAGE_SECTION_HEADER* SectionFromRva(DWORD rva) const noexcept;
+
+		// Bytes of a section as laid out in this view, clipped to the view size
+		[[nodiscard]] std::span<const BYTE> SectionData(const IMAGE_SECTION_HEADER& section) const noexcept;
+		// Sections matching the filter, in address order, with adjacent ones merged into a single range
+		[[nodiscard]] std::vector<std::span<const BYTE>> SectionRanges(const SectionFilter& filter) const;
+
+		[[nodiscard]] const BYTE* RvaToPointer(DWORD rva) const noexcept;
+		[[nodiscard]] DWORD PointerToRva(const BYTE* pAddress) const noexcept;
+
+	private:
+		const BYTE* pBase = nullptr;
+		size_t nSize = 0;
+		ImageLayout layout = ImageLayout::Mapped;
+
+		const void* pNtHeaders = nullptr;
+		bool bIs64 = false;
+
+		template<typename F>
+		decltype(auto) VisitHeaders(F&& visitor) const
+		{
+			if (bIs64) return visitor(*static_cast<const IMAGE_NT_HEADERS64*>(pNtHeaders));
+			return visitor(*static_cast<const IMAGE_NT_HEADERS32*>(pNtHeaders));
+		}
+	};
+
+	// Bytes the loader rewrites when the image is rebased (base relocation directory), as one bit per byte for each page that has any.
+	class RelocationMap
+	{
+	public:
+		static constexpr DWORD pageSize = 0x1000;
+
+		RelocationMap() = default;
+		explicit RelocationMap(const PEView& image);
+
+		// Built on first use for each module, then shared
+		[[nodiscard]] static const RelocationMap& ForModule(HMODULE hModule);
+
+		[[nodiscard]] bool Empty() const noexcept { return bitmaps.empty(); }
+		[[nodiscard]] bool IsRelocated(DWORD rva) const noexcept;
+		// Bitmap of the page holding rva (bit rva % pageSize), nullptr when nothing in that page is relocated
+		[[nodiscard]] const std::uint64_t* PageBitmap(DWORD rva) const noexcept;
+
+	private:
+		using Bitmap = std::array<std::uint64_t, pageSize / 64>;
+		static constexpr std::uint32_t noPage = UINT32_MAX;
+
+		std::vector<std::uint32_t> pageIndex;	// Page number -> index in bitmaps, or noPage
+		std::vector<Bitmap> bitmaps;
+
+		void Mark(DWORD rva, DWORD nSize);
+	};
+}
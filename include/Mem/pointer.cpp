@@ -0,0 +1,162 @@
+﻿#include "pointer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <windows.h>
+
+bool mem::detail::ReadMemory(const std::uintptr_t address, void* pBuffer, const size_t nSize) noexcept
+{
+	__try
+	{
+		memcpy(pBuffer, reinterpret_cast<const void*>(address), nSize);
+		return true;
+	}
+	__except (EXCEPTION_EXECUTE_HANDLER)
+	{
+		return false;
+	}
+}
+
+mem::PointerChain::PointerChain(const std::uintptr_t base, std::vector<unsigned int> offsets, const size_t checkedLevels) : base(base), offsets(std::move(offsets)), checkedLevels(checkedLevels)
+{
+	if (!this->offsets.empty()) nodes.resize(this->offsets.size() - 1);
+}
+
+std::uintptr_t mem::PointerChain::Address()
+{
+	if (offsets.empty()) return base;
+
+	// Checked levels are read again, the cached path is only kept up to the first one that changed
+	size_t from = nValid;
+	bool bChanged = false;
+	for (size_t level = 0; level < std::min(checkedLevels, nValid); level++)
+	{
+		std::uintptr_t node;
+		if (!ReadNode(level, node)) return Fail(level);
+		if (node != nodes[level])
+		{
+			nodes[level] = node;
+			from = level + 1;
+			bChanged = true;
+			break;
+		}
+	}
+
+	if (bChanged || from < nodes.size())
+	{
+		stats.misses++;
+		if (!Walk(from)) return Fail(nValid);
+	}
+	else stats.hits++;
+
+	const std::uintptr_t last = nodes.empty() ? base : nodes.back();
+	if (!last) return Fail(nodes.size());
+	return last + offsets.back();
+}
+
+bool mem::PointerChain::ReadNode(const size_t level, std::uintptr_t& node) const noexcept
+{
+	const std::uintptr_t previous = level ? nodes[level - 1] : base;
+	return previous && detail::ReadMemory(previous + offsets[level], &node, sizeof(node));
+}
+
+bool mem::PointerChain::Walk(const size_t from)
+{
+	for (nValid = from; nValid < nodes.size(); nValid++)
+	{
+		if (!ReadNode(nValid, nodes[nValid])) return false;
+	}
+	return true;
+}
+
+std::uintptr_t mem::PointerChain::Fail(const size_t level) noexcept
+{
+	stats.failures++;
+	nValid = std::min(nValid, level);
+	return 0;
+}
+
+void mem::PointerChain::InvalidateFrom(const size_t level) noexcept
+{
+	nValid = std::min(nValid, level);
+}
+
+void mem::PointerChain::SetBase(const std::uintptr_t newBase) noexcept
+{
+	base = newBase;
+	nValid = 0;
+}
+
+namespace
+{
+	// Reads every node in order (parents come first), false if one of the reads faulted
+	template<typename Node>
+	bool ReadNodes(const Node* pNodes, std::uintptr_t* pValues, const size_t count) noexcept
+	{
+		__try
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				const Node& node = pNodes[i];
+				if (node.parent == static_cast<size_t>(-1)) pValues[i] = node.offset;
+				else if (const std::uintptr_t parent = pValues[node.parent]) pValues[i] = *reinterpret_cast<const std::uintptr_t*>(parent + node.offset);
+				else pValues[i] = 0;
+			}
+			return true;
+		}
+		__except (EXCEPTION_EXECUTE_HANDLER)
+		{
+			return false;
+		}
+	}
+}
+
+size_t mem::PointerChainBatch::GetNode(const size_t parent, const std::uintptr_t offset)
+{
+	// Roots are keyed by their address, children by parent index and offset
+	const std::uint64_t key = parent == npos ? static_cast<std::uint64_t>(offset) : (static_cast<std::uint64_t>(parent) << 32 | static_cast<std::uint32_t>(offset));
+	auto& index = parent == npos ? roots : children;
+	const auto [it, bInserted] = index.try_emplace(key, nodes.size());
+	if (bInserted)
+	{
+		nodes.push_back({ parent, offset });
+		nRoots += parent == npos;
+	}
+	return it->second;
+}
+
+size_t mem::PointerChainBatch::Add(const std::uintptr_t base, const std::span<const unsigned int> offsets)
+{
+	size_t node = GetNode(npos, base);
+	if (offsets.empty())
+	{
+		leaves.push_back({ node, 0 });
+		return leaves.size() - 1;
+	}
+
+	for (const unsigned int offset : offsets.first(offsets.size() - 1)) node = GetNode(node, offset);
+	leaves.push_back({ node, offsets.back() });
+	nUnbatchedReads += offsets.size() - 1;
+	return leaves.size() - 1;
+}
+
+void mem::PointerChainBatch::Resolve(const std::span<std::uintptr_t> results)
+{
+	values.resize(nodes.size());
+	if (!ReadNodes(nodes.data(), values.data(), nodes.size()))
+	{
+		// Some path is broken, read node by node so only the paths below it fail
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			const auto& node = nodes[i];
+			if (node.parent == npos) values[i] = node.offset;
+			else if (const std::uintptr_t parent = values[node.parent]; !parent || !detail::ReadMemory(parent + node.offset, &values[i], sizeof(std::uintptr_t))) values[i] = 0;
+		}
+	}
+
+	for (size_t i = 0; i < leaves.size(); i++)
+	{
+		const std::uintptr_t pointer = values[leaves[i].node];
+		results[i] = pointer ? pointer + leaves[i].offset : 0;
+	}
+}
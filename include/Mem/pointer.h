@@ -0,0 +1,145 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <span>
+#include <unordered_map>
+#include <vector>
+#include <windows.h>
+
+namespace mem
+{
+	namespace detail
+	{
+		// Copies nSize bytes at address into pBuffer, false if the memory can't be read (pBuffer may then be partially written)
+		bool ReadMemory(std::uintptr_t address, void* pBuffer, size_t nSize) noexcept;
+
+		// pResults[i] = T at pAddresses[i], T{} where the address is null or can't be read.
+		// All of them are read in one guarded loop, entries are only read one by one again if it faulted.
+		template<typename T>
+		void ReadEach(const std::uintptr_t* pAddresses, T* pResults, const size_t nCount) noexcept
+		{
+			__try
+			{
+				for (size_t i = 0; i < nCount; i++) pResults[i] = pAddresses[i] ? *reinterpret_cast<const T*>(pAddresses[i]) : T{};
+				return;
+			}
+			__except (EXCEPTION_EXECUTE_HANDLER)
+			{
+			}
+
+			for (size_t i = 0; i < nCount; i++)
+			{
+				if (!pAddresses[i] || !ReadMemory(pAddresses[i], &pResults[i], sizeof(T))) pResults[i] = T{};
+			}
+		}
+	}
+
+	// Pointer path resolved like FindDMAAddy / FindDMAAddyPtr, with the intermediate nodes cached between calls.
+	// Each resolve re-reads the first 'checkedLevels' levels only: while they hold the same pointers the rest of the cached path is reused,
+	// otherwise the path is walked again from the first level that changed. The last level (the value itself) is always read.
+	//	mem::PointerChain health(moduleBase + 0x1234, { 0x10, 0x28, 0x1C0 });
+	//	int value = health.Value<int>();
+	class PointerChain
+	{
+	public:
+		struct Stats
+		{
+			size_t hits = 0;		// Resolves served from the cached path
+			size_t misses = 0;		// Resolves that walked part of the path again
+			size_t failures = 0;	// Resolves that hit a null or unreadable pointer
+		};
+
+		PointerChain(std::uintptr_t base, std::vector<unsigned int> offsets, size_t checkedLevels = 1);
+
+		// Address of the last field (FindDMAAddyPtr), 0 when the path is broken
+		[[nodiscard]] std::uintptr_t Address();
+		template<typename T>
+		[[nodiscard]] T* Pointer() { return reinterpret_cast<T*>(Address()); }
+
+		// Last field read as T (FindDMAAddy), T{} when the path is broken
+		template<typename T = std::uintptr_t>
+		[[nodiscard]] T Value()
+		{
+			T value{};
+			if (const std::uintptr_t address = Address(); !address || !detail::ReadMemory(address, &value, sizeof(T))) return T{};
+			return value;
+		}
+
+		// Levels from 'level' on are walked again on the next resolve, InvalidateFrom(0) drops the whole path
+		void InvalidateFrom(size_t level) noexcept;
+		void SetBase(std::uintptr_t newBase) noexcept;
+
+		[[nodiscard]] const Stats& GetStats() const noexcept { return stats; }
+		void ResetStats() noexcept { stats = {}; }
+
+	private:
+		std::uintptr_t base;
+		std::vector<unsigned int> offsets;
+		std::vector<std::uintptr_t> nodes;	// nodes[i] = pointer read at level i (levels 0 to offsets.size() - 2)
+		size_t nValid = 0;					// Levels of nodes that can be trusted
+		size_t checkedLevels;
+		Stats stats;
+
+		// Pointer at a level from the cached previous one, false if that one is null or the read fails
+		bool ReadNode(size_t level, std::uintptr_t& node) const noexcept;
+		// Reads levels [from, nodes.size()), false if one of them can't be read
+		bool Walk(size_t from);
+		std::uintptr_t Fail(size_t level) noexcept;
+	};
+
+	// Many pointer paths resolved together: their offsets are merged in a prefix trie, so a node shared by several paths
+	// (base -> world -> entityList -> ...) is read once per Resolve. Nodes are kept parents first in one array and read in a single linear pass.
+	//	mem::PointerChainBatch batch;
+	//	for (int i = 0; i < 64; i++) batch.Add(moduleBase + 0x1234, { 0x10, 0x28, 0x8 * i, 0x1C0 });
+	//	batch.Resolve(addresses);
+	class PointerChainBatch
+	{
+	public:
+		// Adds a path (same meaning as PointerChain), returns its index in the results
+		size_t Add(std::uintptr_t base, std::span<const unsigned int> offsets);
+		size_t Add(const std::uintptr_t base, const std::initializer_list<unsigned int> offsets) { return Add(base, std::span(offsets.begin(), offsets.size())); }
+
+		// results[i] = address of the last field of path i (FindDMAAddyPtr), 0 when the path is broken. results must hold Size() entries.
+		void Resolve(std::span<std::uintptr_t> results);
+		// Same, followed by a read of each last field (FindDMAAddy), T{} for broken paths
+		template<typename T>
+		void ResolveValues(std::span<T> results)
+		{
+			addresses.resize(leaves.size());
+			Resolve(addresses);
+			detail::ReadEach(addresses.data(), results.data(), leaves.size());
+		}
+
+		[[nodiscard]] size_t Size() const noexcept { return leaves.size(); }
+		// Pointers read per Resolve, against the ones separate FindDMAAddyPtr calls would read
+		[[nodiscard]] size_t ReadCount() const noexcept { return nodes.size() - nRoots; }
+		[[nodiscard]] size_t UnbatchedReadCount() const noexcept { return nUnbatchedReads; }
+
+	private:
+		static constexpr size_t npos = static_cast<size_t>(-1);
+
+		struct Node
+		{
+			size_t parent;			// npos for a base
+			std::uintptr_t offset;	// Base address for a root, offset from the parent pointer otherwise
+		};
+
+		struct Leaf
+		{
+			size_t node;
+			unsigned int offset;	// Last offset, added without reading
+		};
+
+		std::vector<Node> nodes;			// Parents always come before their children
+		std::vector<std::uintptr_t> values;	// Pointer read at each node in the last Resolve
+		std::vector<Leaf> leaves;
+		std::vector<std::uintptr_t> addresses;
+		std::unordered_map<std::uint64_t, size_t> roots;	// Base -> node
+		std::unordered_map<std::uint64_t, size_t> children;	// (parent, offset) -> node
+		size_t nRoots = 0;
+		size_t nUnbatchedReads = 0;
+
+		size_t GetNode(size_t parent, std::uintptr_t offset);
+	};
+}
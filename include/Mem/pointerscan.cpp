@@ -0,0 +1,480 @@
+﻿#include "pointerscan.h"
+
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <span>
+#include <utility>
+
+#include "saferead.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	constexpr std::uint32_t fileMagic = 0x4E435350; // "PSCN"
+	constexpr std::uint32_t fileVersion = 1;
+
+	constexpr size_t chunkSize = 1024 * 1024;		// Bytes of memory per collection task
+	constexpr size_t sliceSize = 1024 * 1024;		// Pointer map entries per search task
+	constexpr size_t blockSize = 64 * 1024;			// Bytes read at once
+
+	struct PointerEntry
+	{
+		std::uintptr_t value;
+		std::uintptr_t location;
+
+		bool operator<(const PointerEntry& other) const noexcept { return value < other.value; }
+	};
+
+	struct Node
+	{
+		std::uintptr_t address;
+		std::uint32_t parent;	// Index in the previous depth
+		std::uint32_t offset;	// parent address - value stored at address
+	};
+
+	// Sorted part of the pointer map, in memory or spilled to a file
+	struct SortedRun
+	{
+		std::span<const PointerEntry> entries;	// Empty for a spilled run
+		std::filesystem::path file;
+		size_t count = 0;
+	};
+
+	// Memory taken directly from the system, so the pointer map doesn't land in (and isn't found by scanning) the heap
+	class PageBuffer
+	{
+	public:
+		explicit PageBuffer(const size_t nSize) : nSize(nSize)
+		{
+#ifdef _WIN32
+			pData = VirtualAlloc(nullptr, nSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+			pData = mmap(nullptr, nSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (pData == MAP_FAILED) pData = nullptr;
+#endif
+		}
+
+		PageBuffer(PageBuffer&& other) noexcept : pData(std::exchange(other.pData, nullptr)), nSize(other.nSize) {}
+		PageBuffer& operator=(PageBuffer&&) = delete;
+
+		~PageBuffer()
+		{
+			if (!pData) return;
+#ifdef _WIN32
+			VirtualFree(pData, 0, MEM_RELEASE);
+#else
+			munmap(pData, nSize);
+#endif
+		}
+
+		[[nodiscard]] PointerEntry* Entries() const noexcept { return static_cast<PointerEntry*>(pData); }
+		[[nodiscard]] size_t Capacity() const noexcept { return nSize / sizeof(PointerEntry); }
+		[[nodiscard]] std::uintptr_t Begin() const noexcept { return reinterpret_cast<std::uintptr_t>(pData); }
+		[[nodiscard]] std::uintptr_t End() const noexcept { return Begin() + nSize; }
+
+	private:
+		void* pData;
+		size_t nSize;
+	};
+
+	// Runs fn(task) for tasks [0, nTasks) on nThreads threads (the caller included)
+	template<typename Fn>
+	void ParallelFor(const unsigned nThreads, const size_t nTasks, Fn&& fn)
+	{
+		std::atomic<size_t> nextTask{ 0 };
+		const auto worker = [&](const unsigned thread)
+		{
+			for (size_t task = nextTask++; task < nTasks; task = nextTask++) fn(thread, task);
+		};
+
+		std::vector<std::jthread> workers;
+		for (unsigned i = 1; i < nThreads; i++) workers.emplace_back(worker, i);
+		worker(0);
+	}
+
+	// Spill file prefix unique to a scan: scans of other processes and of other scanners of this one share the directory
+	std::string SpillPrefix()
+	{
+		static std::atomic<unsigned> nextScan = 0;
+#ifdef _WIN32
+		const unsigned long processId = GetCurrentProcessId();
+#else
+		const unsigned long processId = static_cast<unsigned long>(getpid());
+#endif
+		return "pointerscan_" + std::to_string(processId) + "_" + std::to_string(nextScan++) + "_";
+	}
+
+	void WriteVarint(std::ofstream& file, std::uint64_t value)
+	{
+		std::uint8_t bytes[10];
+		size_t n = 0;
+		for (; value >= 0x80; value >>= 7) bytes[n++] = static_cast<std::uint8_t>(value | 0x80);
+		bytes[n++] = static_cast<std::uint8_t>(value);
+		file.write(reinterpret_cast<const char*>(bytes), static_cast<std::streamsize>(n));
+	}
+
+	bool ReadVarint(std::ifstream& file, std::uint64_t& value)
+	{
+		value = 0;
+		for (unsigned shift = 0; shift < 64; shift += 7)
+		{
+			const int byte = file.get();
+			if (byte == EOF) return false;
+			value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+			if (!(byte & 0x80)) return true;
+		}
+		return false;
+	}
+
+	template<typename T>
+	void WriteValue(std::ofstream& file, const T& value)
+	{
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	bool ReadValue(std::ifstream& file, T& value)
+	{
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	// Index of the module containing the address, -1 if none
+	ptrdiff_t FindModule(const std::vector<mem::ModuleInfo>& modules, const std::uintptr_t address)
+	{
+		const auto it = std::ranges::upper_bound(modules, address, {}, &mem::ModuleInfo::base);
+		if (it == modules.begin() || address - std::prev(it)->base >= std::prev(it)->size) return -1;
+		return std::prev(it) - modules.begin();
+	}
+}
+
+mem::PointerScanner::~PointerScanner()
+{
+	// The worker uses the members declared after it, so it has to be gone before they are destroyed
+	Cancel();
+	if (worker.joinable()) worker.join();
+}
+
+bool mem::PointerScanner::Start(const PointerScanOptions& options, RegionProvider& regions)
+{
+	if (IsRunning()) return false;
+	if (worker.joinable()) worker.join();
+
+	bCancel = false;
+	phase = Phase::Collecting;
+	depth = 0;
+	done = total = pointers = results = 0;
+	worker = std::jthread(&PointerScanner::Run, this, options, std::ref(regions));
+	return true;
+}
+
+bool mem::PointerScanner::IsRunning() const noexcept
+{
+	const Phase current = phase.load();
+	return current == Phase::Collecting || current == Phase::Searching;
+}
+
+mem::PointerScanner::Progress mem::PointerScanner::GetProgress() const noexcept
+{
+	return { phase.load(), depth.load(), done.load(), total.load(), pointers.load(), results.load() };
+}
+
+void mem::PointerScanner::Run(PointerScanOptions options, RegionProvider& regions)
+{
+	const unsigned nThreads = options.threads ? options.threads : std::max(std::thread::hardware_concurrency(), 1u);
+
+	// Spill files are removed whatever the outcome
+	const std::string spillPrefix = SpillPrefix();
+	std::vector<std::filesystem::path> spillFiles;
+	struct SpillCleanup
+	{
+		std::vector<std::filesystem::path>& files;
+		~SpillCleanup()
+		{
+			std::error_code error;
+			for (const auto& file : files) std::filesystem::remove(file, error);
+		}
+	} cleanup{ spillFiles };
+
+	std::vector<PageBuffer> buffers;
+	for (unsigned i = 0; i < nThreads; i++)
+	{
+		buffers.emplace_back(std::max<size_t>(options.memoryLimit / nThreads / sizeof(PointerEntry), 1024) * sizeof(PointerEntry));
+		if (!buffers.back().Entries())
+		{
+			phase = Phase::Failed;
+			return;
+		}
+	}
+
+	// Memory to scan: readable regions minus the pointer map buffers, cut in tasks
+	regions.Invalidate();
+	const auto snapshot = regions.Snapshot();
+	RegionList readable;
+	std::ranges::copy_if(*snapshot, std::back_inserter(readable), [](const MemoryRegion& region) { return HasAccess(region.access, RegionAccess::Read); });
+	if (readable.empty())
+	{
+		phase = Phase::Failed;
+		return;
+	}
+
+	std::vector<std::span<const std::uint8_t>> chunks;
+	for (const auto& region : readable)
+	{
+		std::uintptr_t begin = region.base;
+		const std::uintptr_t end = region.End();
+		while (begin < end)
+		{
+			// Stop at the next buffer inside the region, then skip it
+			std::uintptr_t stop = end;
+			for (const auto& buffer : buffers)
+			{
+				if (buffer.Begin() <= begin && begin < buffer.End()) stop = begin;
+				else if (begin < buffer.Begin() && buffer.Begin() < stop) stop = buffer.Begin();
+			}
+			if (stop == begin)
+			{
+				for (const auto& buffer : buffers) if (buffer.Begin() <= begin && begin < buffer.End()) begin = buffer.End();
+				continue;
+			}
+
+			for (std::uintptr_t chunk = begin; chunk < stop; chunk += std::min<std::uintptr_t>(chunkSize, stop - chunk))
+			{
+				chunks.emplace_back(reinterpret_cast<const std::uint8_t*>(chunk), std::min<std::uintptr_t>(chunkSize, stop - chunk));
+			}
+			begin = stop;
+		}
+	}
+	for (const auto& chunk : chunks) total += chunk.size();
+
+	// 1. Pointer map
+	std::vector<size_t> counts(nThreads);
+	std::vector<SortedRun> runs;
+	std::mutex runsMutex;
+	std::atomic<bool> bSpillFailed = false;
+	const std::uintptr_t minValue = readable.front().base;
+	const std::uintptr_t maxValue = readable.back().End();
+
+	const auto spill = [&](const unsigned thread)
+	{
+		PointerEntry* pEntries = buffers[thread].Entries();
+		std::sort(pEntries, pEntries + counts[thread]);
+
+		std::scoped_lock lock(runsMutex);
+		auto file = options.spillDirectory / (spillPrefix + std::to_string(spillFiles.size()) + ".tmp");
+		std::ofstream stream(file, std::ios::binary | std::ios::trunc);
+		stream.write(reinterpret_cast<const char*>(pEntries), static_cast<std::streamsize>(counts[thread] * sizeof(PointerEntry)));
+		spillFiles.push_back(file);
+		if (!stream) bSpillFailed = true; // Disk full, can't go on
+		runs.push_back({ {}, std::move(file), counts[thread] });
+		counts[thread] = 0;
+	};
+
+	ParallelFor(nThreads, chunks.size(), [&](const unsigned thread, const size_t task)
+	{
+		if (bCancel || bSpillFailed) return;
+
+		std::vector<std::uintptr_t> block(blockSize / sizeof(std::uintptr_t));
+		const MemoryRegion* pLast = nullptr;
+		const auto chunk = chunks[task];
+		for (size_t offset = 0; offset < chunk.size(); offset += blockSize)
+		{
+			const size_t nBytes = std::min(blockSize, chunk.size() - offset) & ~(sizeof(std::uintptr_t) - 1);
+			const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(chunk.data()) + offset;
+			// Through the system: the game keeps freeing memory while the scan runs, one call per block is cheap
+			if (!detail::SystemRead(address, block.data(), nBytes)) continue;
+
+			for (size_t i = 0; i < nBytes / sizeof(std::uintptr_t); i++)
+			{
+				const std::uintptr_t value = block[i];
+				if (value < minValue || value >= maxValue) continue;
+				if (!(pLast && pLast->Contains(value)) && !detail::IsCovered(readable, value, 1, RegionAccess::Read, &pLast)) continue;
+
+				if (counts[thread] == buffers[thread].Capacity()) spill(thread);
+				buffers[thread].Entries()[counts[thread]++] = { value, address + i * sizeof(std::uintptr_t) };
+			}
+		}
+		done += chunk.size();
+	});
+
+	for (unsigned thread = 0; thread < nThreads; thread++)
+	{
+		PointerEntry* pEntries = buffers[thread].Entries();
+		std::sort(pEntries, pEntries + counts[thread]);
+		runs.push_back({ { pEntries, counts[thread] }, {}, counts[thread] });
+	}
+	for (const auto& run : runs) pointers += run.count;
+
+	if (bSpillFailed)
+	{
+		phase = Phase::Failed;
+		return;
+	}
+	if (bCancel)
+	{
+		phase = Phase::Cancelled;
+		return;
+	}
+
+	// 2. Breadth-first search from the target
+	std::ofstream output(options.output, std::ios::binary | std::ios::trunc);
+	const auto modules = ListModules();
+	WriteValue(output, fileMagic);
+	WriteValue(output, fileVersion);
+	WriteValue(output, static_cast<std::uint64_t>(options.target));
+	WriteValue(output, options.maxDepth);
+	WriteValue(output, options.maxOffset);
+	WriteValue(output, static_cast<std::uint32_t>(modules.size()));
+	for (const auto& module : modules)
+	{
+		WriteValue(output, static_cast<std::uint16_t>(module.name.size()));
+		output.write(module.name.data(), static_cast<std::streamsize>(module.name.size()));
+	}
+	if (!output)
+	{
+		phase = Phase::Failed;
+		return;
+	}
+
+	struct Slice
+	{
+		const SortedRun* pRun;
+		size_t begin;
+		size_t end;
+	};
+	std::vector<Slice> slices;
+	for (const auto& run : runs)
+	{
+		for (size_t begin = 0; begin < run.count; begin += sliceSize) slices.push_back({ &run, begin, std::min(begin + sliceSize, run.count) });
+	}
+
+	phase = Phase::Searching;
+	std::vector<std::vector<Node>> levels{ { { options.target, 0, 0 } } };
+	for (unsigned level = 1; level <= options.maxDepth && !bCancel; level++)
+	{
+		// Nodes to expand, sorted by address: every node of the previous depth except the static ones (they end a path)
+		const auto& previous = levels.back();
+		std::vector<std::uintptr_t> addresses;
+		std::vector<std::uint32_t> indices;
+		for (size_t i = 0; i < previous.size(); i++)
+		{
+			if (level > 1 && FindModule(modules, previous[i].address) >= 0) continue;
+			addresses.push_back(previous[i].address);
+			indices.push_back(static_cast<std::uint32_t>(i));
+		}
+		if (addresses.empty()) break;
+
+		depth = level;
+		done = 0;
+		total = pointers.load();
+
+		std::vector<std::vector<Node>> found(nThreads);
+		std::atomic<size_t> nFound{ 0 };
+		ParallelFor(nThreads, slices.size(), [&](const unsigned thread, const size_t task)
+		{
+			const auto& slice = slices[task];
+			std::vector<PointerEntry> block;
+			std::ifstream file;
+			if (slice.pRun->entries.empty())
+			{
+				file.open(slice.pRun->file, std::ios::binary);
+				file.seekg(static_cast<std::streamoff>(slice.begin * sizeof(PointerEntry)));
+				block.resize(blockSize / sizeof(PointerEntry));
+			}
+
+			// Entries are sorted by value, so the first node at or above the value only moves forward
+			size_t node = 0;
+			for (size_t begin = slice.begin; begin < slice.end && !bCancel; begin += blockSize / sizeof(PointerEntry))
+			{
+				const size_t count = std::min(blockSize / sizeof(PointerEntry), slice.end - begin);
+				std::span<const PointerEntry> entries;
+				if (file.is_open())
+				{
+					if (!file.read(reinterpret_cast<char*>(block.data()), static_cast<std::streamsize>(count * sizeof(PointerEntry)))) break;
+					entries = { block.data(), count };
+				}
+				else entries = slice.pRun->entries.subspan(begin, count);
+
+				for (const auto& entry : entries)
+				{
+					while (node < addresses.size() && addresses[node] < entry.value) node++;
+					for (size_t i = node; i < addresses.size() && addresses[i] - entry.value <= options.maxOffset; i++)
+					{
+						if (nFound++ >= options.maxNodesPerLevel) break;
+						found[thread].push_back({ entry.location, indices[i], static_cast<std::uint32_t>(addresses[i] - entry.value) });
+					}
+				}
+				done += count;
+			}
+		});
+
+		std::vector<Node> current;
+		for (auto& nodes : found) current.insert(current.end(), nodes.begin(), nodes.end());
+		std::ranges::sort(current, {}, &Node::address);
+
+		// Paths ending in a module: RVA of the static pointer, then the offsets from it down to the target
+		for (const auto& start : current)
+		{
+			const ptrdiff_t module = FindModule(modules, start.address);
+			if (module < 0) continue;
+			if (results >= options.maxResults)
+			{
+				bCancel = true;
+				break;
+			}
+
+			WriteVarint(output, static_cast<std::uint64_t>(module));
+			WriteVarint(output, level + 1);
+			WriteVarint(output, start.address - modules[module].base);
+			const Node* pNode = &start;
+			for (unsigned l = level; l > 0; pNode = &levels[--l][pNode->parent]) WriteVarint(output, pNode->offset);
+			results++;
+		}
+		levels.push_back(std::move(current));
+	}
+
+	output.flush();
+	phase = !output ? Phase::Failed : bCancel && results < options.maxResults ? Phase::Cancelled : Phase::Done;
+}
+
+std::vector<mem::PointerPath> mem::ReadPointerPaths(const std::filesystem::path& path, const size_t maxPaths)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::uint32_t magic, version, maxDepth, maxOffset, moduleCount;
+	std::uint64_t target;
+	if (!ReadValue(file, magic) || magic != fileMagic || !ReadValue(file, version) || version != fileVersion) return {};
+	if (!ReadValue(file, target) || !ReadValue(file, maxDepth) || !ReadValue(file, maxOffset) || !ReadValue(file, moduleCount)) return {};
+
+	std::vector<std::string> modules(moduleCount);
+	for (auto& module : modules)
+	{
+		std::uint16_t length;
+		if (!ReadValue(file, length)) return {};
+		module.resize(length);
+		if (!file.read(module.data(), length)) return {};
+	}
+
+	std::vector<PointerPath> paths;
+	std::uint64_t module, count;
+	while (paths.size() < maxPaths && ReadVarint(file, module) && ReadVarint(file, count))
+	{
+		if (module >= modules.size() || count > maxDepth + 1) break;
+
+		PointerPath& entry = paths.emplace_back();
+		entry.module = modules[module];
+		entry.offsets.resize(count);
+		for (auto& offset : entry.offsets)
+		{
+			std::uint64_t value;
+			if (!ReadVarint(file, value)) return paths;
+			offset = static_cast<std::uint32_t>(value);
+		}
+	}
+	return paths;
+}
@@ -0,0 +1,89 @@
+﻿#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "region.h"
+
+namespace mem
+{
+	struct PointerScanOptions
+	{
+		std::uintptr_t target = 0;
+		unsigned maxDepth = 5;					// Pointers dereferenced at most
+		unsigned maxOffset = 0x1000;			// Largest offset added to a pointer
+		unsigned threads = 0;					// 0 = hardware threads
+		size_t memoryLimit = 512 * 1024 * 1024;	// Pointer map kept in memory, sorted runs beyond it are spilled to spillDirectory
+		size_t maxNodesPerLevel = 1 << 22;		// Locations kept per depth, the rest is dropped
+		size_t maxResults = 1'000'000;
+		std::filesystem::path output = "pointerscan.bin";
+		std::filesystem::path spillDirectory = std::filesystem::temp_directory_path();
+	};
+
+	// Path found by a pointer scan, usable as PointerChain(module base, offsets): offsets[0] is the RVA of the static pointer in the module
+	struct PointerPath
+	{
+		std::string module;
+		std::vector<std::uint32_t> offsets;
+	};
+
+	// In-process pointer scanner (reverse pointer-chain discovery), running on a background thread.
+	// 1. Every aligned pointer-sized value of the readable regions that points into a readable region is recorded as (value, location),
+	//    in sorted runs of at most memoryLimit bytes in total, older runs being spilled to disk.
+	// 2. Breadth-first search back from the target: the locations holding a value in [address - maxOffset, address] of a node become the nodes
+	//    of the next depth. The runs are swept against the sorted nodes in parallel, spilled runs sequentially from disk.
+	// Locations inside a module end a path, which is appended to the output file (see ReadPointerPaths).
+	class PointerScanner
+	{
+	public:
+		enum class Phase : std::uint8_t
+		{
+			Idle,
+			Collecting,	///< Building the pointer map, progress in bytes.
+			Searching,	///< Breadth-first search, progress in pointers swept at the current depth.
+			Done,
+			Failed,
+			Cancelled
+		};
+
+		struct Progress
+		{
+			Phase phase = Phase::Idle;
+			unsigned depth = 0;
+			size_t done = 0;
+			size_t total = 0;
+			size_t pointers = 0;	// Entries of the pointer map
+			size_t results = 0;
+		};
+
+		PointerScanner() = default;
+		PointerScanner(const PointerScanner&) = delete;
+		PointerScanner& operator=(const PointerScanner&) = delete;
+		~PointerScanner();
+
+		// False if a scan is already running
+		bool Start(const PointerScanOptions& options, RegionProvider& regions = RegionProvider::Default());
+		void Cancel() noexcept { bCancel = true; }
+
+		[[nodiscard]] bool IsRunning() const noexcept;
+		[[nodiscard]] Progress GetProgress() const noexcept;
+
+	private:
+		std::jthread worker;
+		std::atomic<bool> bCancel = false;
+		std::atomic<Phase> phase = Phase::Idle;
+		std::atomic<unsigned> depth = 0;
+		std::atomic<size_t> done = 0;
+		std::atomic<size_t> total = 0;
+		std::atomic<size_t> pointers = 0;
+		std::atomic<size_t> results = 0;
+
+		void Run(PointerScanOptions options, RegionProvider& regions);
+	};
+
+	// Paths of a file written by PointerScanner, at most maxPaths of them
+	std::vector<PointerPath> ReadPointerPaths(const std::filesystem::path& path, size_t maxPaths = SIZE_MAX);
+}
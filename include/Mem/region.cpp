@@ -0,0 +1,222 @@
+﻿#include "region.h"
+
+#include <algorithm>
+#include <charconv>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <tlhelp32.h>
+#elif defined(__linux__)
+#include <fstream>
+#include <sstream>
+#endif
+
+std::shared_ptr<const mem::RegionList> mem::RegionProvider::Snapshot()
+{
+	std::scoped_lock lock(mutex);
+	if (bStale.exchange(false, std::memory_order_acq_rel) || !regions)
+	{
+		auto list = Query();
+		detail::MergeRegions(list);
+		regions = std::make_shared<const RegionList>(std::move(list));
+		lastQuery.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+		nQueries.fetch_add(1, std::memory_order_release);
+	}
+	return regions;
+}
+
+bool mem::RegionProvider::Refresh(const std::chrono::steady_clock::duration minAge)
+{
+	{
+		std::scoped_lock lock(mutex);
+		const std::chrono::steady_clock::time_point queried{ std::chrono::steady_clock::duration(lastQuery.load(std::memory_order_relaxed)) };
+		if (regions && std::chrono::steady_clock::now() - queried < minAge) return false;
+		Invalidate();
+	}
+	(void)Snapshot();
+	return true;
+}
+
+std::optional<mem::MemoryRegion> mem::RegionProvider::Find(const std::uintptr_t address)
+{
+	const auto list = Snapshot();
+	const auto it = std::ranges::upper_bound(*list, address, {}, &MemoryRegion::base);
+	if (it == list->begin() || !std::prev(it)->Contains(address)) return std::nullopt;
+	return *std::prev(it);
+}
+
+bool mem::RegionProvider::IsAccessible(const std::uintptr_t address, const size_t size, const RegionAccess required)
+{
+	return detail::IsCovered(*Snapshot(), address, size, required);
+}
+
+bool mem::detail::IsCovered(const RegionList& regions, std::uintptr_t address, const size_t size, const RegionAccess required, const MemoryRegion** pLast)
+{
+	const std::uintptr_t end = address + size;
+	if (end < address) return false;
+
+	// Merged regions can still be adjacent when their access differs, so the range may span several of them
+	auto it = std::ranges::upper_bound(regions, address, {}, &MemoryRegion::base);
+	if (it == regions.begin()) return false;
+	for (--it; it != regions.end() && it->Contains(address); ++it)
+	{
+		if (!HasAccess(it->access, required)) return false;
+		if (end <= it->End())
+		{
+			if (pLast) *pLast = &*it;
+			return true;
+		}
+		address = it->End();
+	}
+	return false;
+}
+
+void mem::detail::MergeRegions(RegionList& regions)
+{
+	size_t nMerged = 0;
+	for (const auto& region : regions)
+	{
+		if (nMerged && regions[nMerged - 1].End() == region.base && regions[nMerged - 1].access == region.access) regions[nMerged - 1].size += region.size;
+		else regions[nMerged++] = region;
+	}
+	regions.resize(nMerged);
+}
+
+mem::RegionList mem::detail::ParseProcMaps(const std::string_view maps)
+{
+	// "7f12a000-7f12b000 r-xp 00000000 08:01 1234   /usr/lib/libc.so.6"
+	RegionList regions;
+	for (size_t lineStart = 0; lineStart < maps.size();)
+	{
+		size_t lineEnd = maps.find('\n', lineStart);
+		if (lineEnd == std::string_view::npos) lineEnd = maps.size();
+		const std::string_view line = maps.substr(lineStart, lineEnd - lineStart);
+		lineStart = lineEnd + 1;
+
+		std::uintptr_t begin = 0, end = 0;
+		const char* pEnd = line.data() + line.size();
+		auto result = std::from_chars(line.data(), pEnd, begin, 16);
+		if (result.ec != std::errc{} || result.ptr == pEnd || *result.ptr != '-') continue;
+		result = std::from_chars(result.ptr + 1, pEnd, end, 16);
+		if (result.ec != std::errc{} || pEnd - result.ptr < 4 || *result.ptr != ' ' || end <= begin) continue;
+
+		const char* perms = result.ptr + 1;
+		RegionAccess access = RegionAccess::None;
+		if (perms[0] == 'r') access = access | RegionAccess::Read;
+		if (perms[1] == 'w') access = access | RegionAccess::Write;
+		if (perms[2] == 'x') access = access | RegionAccess::Execute;
+		// [vvar] is listed as readable but parts of it fault when touched
+		if (line.find("[vvar") != std::string_view::npos) continue;
+		if (access != RegionAccess::None) regions.push_back({ begin, end - begin, access });
+	}
+	return regions;
+}
+
+std::vector<mem::ModuleInfo> mem::detail::ParseProcMapsModules(const std::string_view maps)
+{
+	std::vector<ModuleInfo> modules;
+	std::string_view previousPath;
+	for (size_t lineStart = 0; lineStart < maps.size();)
+	{
+		size_t lineEnd = maps.find('\n', lineStart);
+		if (lineEnd == std::string_view::npos) lineEnd = maps.size();
+		const std::string_view line = maps.substr(lineStart, lineEnd - lineStart);
+		lineStart = lineEnd + 1;
+
+		// The path is the only field starting with '/'
+		const size_t pathStart = line.find(" /");
+		std::uintptr_t begin = 0, end = 0;
+		const auto result = std::from_chars(line.data(), line.data() + line.size(), begin, 16);
+		if (pathStart == std::string_view::npos || result.ec != std::errc{} || std::from_chars(result.ptr + 1, line.data() + line.size(), end, 16).ec != std::errc{}) continue;
+
+		const std::string_view path = line.substr(pathStart + 1);
+		if (path == previousPath && !modules.empty() && modules.back().base + modules.back().size <= end)
+		{
+			modules.back().size = end - modules.back().base;
+			continue;
+		}
+		previousPath = path;
+		modules.push_back({ std::string(path.substr(path.rfind('/') + 1)), begin, end - begin });
+	}
+	std::ranges::sort(modules, {}, &ModuleInfo::base);
+	return modules;
+}
+
+#ifdef _WIN32
+mem::RegionList mem::VirtualQueryRegionProvider::Query() const
+{
+	SYSTEM_INFO sysInfo;
+	GetSystemInfo(&sysInfo);
+
+	RegionList regions;
+	const auto* pAddress = static_cast<const BYTE*>(sysInfo.lpMinimumApplicationAddress);
+	MEMORY_BASIC_INFORMATION mbi;
+	while (pAddress < sysInfo.lpMaximumApplicationAddress && VirtualQuery(pAddress, &mbi, sizeof(mbi)))
+	{
+		if (mbi.State == MEM_COMMIT && !(mbi.Protect & (PAGE_NOACCESS | PAGE_GUARD)))
+		{
+			RegionAccess access = RegionAccess::Read;
+			if (mbi.Protect & (PAGE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY)) access = access | RegionAccess::Write;
+			if (mbi.Protect & (PAGE_EXECUTE | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY)) access = access | RegionAccess::Execute;
+			// Execute-only pages can't be read
+			if (mbi.Protect & PAGE_EXECUTE) access = RegionAccess::Execute;
+			regions.push_back({ reinterpret_cast<std::uintptr_t>(mbi.BaseAddress), mbi.RegionSize, access });
+		}
+		pAddress = static_cast<const BYTE*>(mbi.BaseAddress) + mbi.RegionSize;
+	}
+	return regions;
+}
+
+mem::RegionProvider& mem::RegionProvider::Default()
+{
+	static VirtualQueryRegionProvider provider;
+	return provider;
+}
+
+std::vector<mem::ModuleInfo> mem::ListModules()
+{
+	std::vector<ModuleInfo> modules;
+	const HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPMODULE | TH32CS_SNAPMODULE32, 0);
+	if (hSnapshot == INVALID_HANDLE_VALUE) return modules;
+
+	MODULEENTRY32W entry{ sizeof(entry) };
+	for (BOOL bNext = Module32FirstW(hSnapshot, &entry); bNext; bNext = Module32NextW(hSnapshot, &entry))
+	{
+		char name[MAX_PATH]{};
+		WideCharToMultiByte(CP_UTF8, 0, entry.szModule, -1, name, sizeof(name), nullptr, nullptr);
+		modules.push_back({ name, reinterpret_cast<std::uintptr_t>(entry.modBaseAddr), entry.modBaseSize });
+	}
+	CloseHandle(hSnapshot);
+
+	std::ranges::sort(modules, {}, &ModuleInfo::base);
+	return modules;
+}
+#elif defined(__linux__)
+namespace
+{
+	// The file is generated while it is read, so read it whole before parsing
+	std::string ReadProcMaps()
+	{
+		std::ifstream file("/proc/self/maps");
+		std::ostringstream contents;
+		contents << file.rdbuf();
+		return std::move(contents).str();
+	}
+}
+
+mem::RegionList mem::ProcMapsRegionProvider::Query() const
+{
+	return detail::ParseProcMaps(ReadProcMaps());
+}
+
+mem::RegionProvider& mem::RegionProvider::Default()
+{
+	static ProcMapsRegionProvider provider;
+	return provider;
+}
+
+std::vector<mem::ModuleInfo> mem::ListModules()
+{
+	return detail::ParseProcMapsModules(ReadProcMaps());
+}
+#endif
@@ -0,0 +1,119 @@
+﻿#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mem
+{
+	enum class RegionAccess : std::uint8_t
+	{
+		None = 0,
+		Read = 1 << 0,
+		Write = 1 << 1,
+		Execute = 1 << 2
+	};
+
+	constexpr RegionAccess operator|(const RegionAccess a, const RegionAccess b) noexcept { return static_cast<RegionAccess>(static_cast<std::uint8_t>(a) | static_cast<std::uint8_t>(b)); }
+	constexpr RegionAccess operator&(const RegionAccess a, const RegionAccess b) noexcept { return static_cast<RegionAccess>(static_cast<std::uint8_t>(a) & static_cast<std::uint8_t>(b)); }
+
+	// True when every flag of 'required' is granted by 'access'
+	constexpr bool HasAccess(const RegionAccess access, const RegionAccess required) noexcept { return (access & required) == required; }
+
+	struct MemoryRegion
+	{
+		std::uintptr_t base = 0;
+		size_t size = 0;
+		RegionAccess access = RegionAccess::None;
+
+		[[nodiscard]] std::uintptr_t End() const noexcept { return base + size; }
+		[[nodiscard]] bool Contains(const std::uintptr_t address) const noexcept { return address - base < size; }
+		[[nodiscard]] std::span<const std::uint8_t> Bytes() const noexcept { return { reinterpret_cast<const std::uint8_t*>(base), size }; }
+	};
+
+	using RegionList = std::vector<MemoryRegion>;
+
+	// Accessible memory regions of the current process (committed, not guard/no-access), sorted by address with adjacent regions of the same access merged.
+	// The list is queried once and shared as an immutable snapshot until Invalidate(), which only marks it stale: the next caller re-queries it.
+	class RegionProvider
+	{
+	public:
+		virtual ~RegionProvider() = default;
+
+		// Current list, re-queried first if it was invalidated. Snapshots stay valid after later invalidations.
+		[[nodiscard]] std::shared_ptr<const RegionList> Snapshot();
+
+		// Region containing the address, if it is accessible
+		[[nodiscard]] std::optional<MemoryRegion> Find(std::uintptr_t address);
+		// True when [address, address + size) is covered by consecutive regions granting 'required'
+		[[nodiscard]] bool IsAccessible(std::uintptr_t address, size_t size, RegionAccess required = RegionAccess::Read);
+
+		void Invalidate() noexcept { bStale.store(true, std::memory_order_release); }
+		[[nodiscard]] bool IsStale() const noexcept { return bStale.load(std::memory_order_acquire); }
+		// Re-queries the list now unless the current one is younger than minAge, returns true if it did
+		bool Refresh(std::chrono::steady_clock::duration minAge);
+		// Number of times the regions were queried from the system, a snapshot is current while it is unchanged
+		[[nodiscard]] size_t QueryCount() const noexcept { return nQueries.load(std::memory_order_acquire); }
+
+		// Implementation for the platform it was built for (VirtualQuery or /proc/self/maps)
+		static RegionProvider& Default();
+
+	protected:
+		// Regions in address order, not merged yet
+		[[nodiscard]] virtual RegionList Query() const = 0;
+
+	private:
+		std::mutex mutex;
+		std::shared_ptr<const RegionList> regions;
+		std::atomic<bool> bStale = true;
+		std::atomic<size_t> nQueries = 0;
+		std::atomic<std::chrono::steady_clock::rep> lastQuery = 0;
+	};
+
+#ifdef _WIN32
+	// Walks the address space with VirtualQuery
+	class VirtualQueryRegionProvider final : public RegionProvider
+	{
+	protected:
+		[[nodiscard]] RegionList Query() const override;
+	};
+#endif
+
+#ifdef __linux__
+	// Parses /proc/self/maps
+	class ProcMapsRegionProvider final : public RegionProvider
+	{
+	protected:
+		[[nodiscard]] RegionList Query() const override;
+	};
+#endif
+
+	struct ModuleInfo
+	{
+		std::string name;	// File name ("game.exe", "libc.so.6")
+		std::uintptr_t base = 0;
+		size_t size = 0;
+	};
+
+	// Modules mapped in the process (loaded images on Windows, file mappings on Linux), sorted by base
+	std::vector<ModuleInfo> ListModules();
+
+	namespace detail
+	{
+		// Adjacent regions with the same access become one, the list must be sorted
+		void MergeRegions(RegionList& regions);
+		// True when [address, address + size) is covered by consecutive regions of the sorted list granting 'required'.
+		// pLast receives the region holding the end of the range, so the next lookup can try it first.
+		bool IsCovered(const RegionList& regions, std::uintptr_t address, size_t size, RegionAccess required, const MemoryRegion** pLast = nullptr);
+		// Parses the text of a /proc/<pid>/maps file, regions without any access are skipped
+		RegionList ParseProcMaps(std::string_view maps);
+		// File mappings of a /proc/<pid>/maps file, consecutive mappings of the same file form one module
+		std::vector<ModuleInfo> ParseProcMapsModules(std::string_view maps);
+	}
+}
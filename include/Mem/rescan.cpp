@@ -0,0 +1,175 @@
+﻿#include "rescan.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace
+{
+	constexpr std::uint64_t prime1 = 0x9E3779B185EBCA87;
+	constexpr std::uint64_t prime2 = 0xC2B2AE3D27D4EB4F;
+	constexpr std::uint64_t prime3 = 0x165667B19E3779F9;
+	constexpr std::uint64_t prime4 = 0x85EBCA77C2B2AE63;
+	constexpr std::uint64_t prime5 = 0x27D4EB2F165667C5;
+
+	std::uint64_t Round(std::uint64_t accumulator, const std::uint64_t input) noexcept
+	{
+		accumulator += input * prime2;
+		return std::rotl(accumulator, 31) * prime1;
+	}
+
+	std::uint64_t Load64(const BYTE* pData) noexcept
+	{
+		std::uint64_t value;
+		memcpy(&value, pData, sizeof(value));
+		return value;
+	}
+}
+
+std::uint64_t mem::detail::HashPage(const BYTE* pData, const size_t nSize) noexcept
+{
+	// Four independent lanes so the multiplies of consecutive words overlap
+	std::uint64_t lanes[4] = { prime1 + prime2, prime2, 0, 0 - prime1 };
+	size_t i = 0;
+	for (; i + 32 <= nSize; i += 32)
+	{
+		for (size_t lane = 0; lane < 4; lane++) lanes[lane] = Round(lanes[lane], Load64(pData + i + lane * 8));
+	}
+
+	std::uint64_t hash = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18) + nSize;
+	for (; i + 8 <= nSize; i += 8)
+	{
+		hash ^= Round(0, Load64(pData + i));
+		hash = std::rotl(hash, 27) * prime1 + prime4;
+	}
+	for (; i < nSize; i++)
+	{
+		hash ^= pData[i] * prime5;
+		hash = std::rotl(hash, 11) * prime1;
+	}
+
+	hash ^= hash >> 33;
+	hash *= prime2;
+	hash ^= hash >> 29;
+	hash *= prime3;
+	return hash ^ hash >> 32;
+}
+
+mem::IncrementalScan::IncrementalScan(void* hModule, const std::span<const SignatureView> signatures, const bool bFastScan, const SectionFilter& sections) : signatures(signatures.begin(), signatures.end()), bFastScan(bFastScan)
+{
+	for (const auto& range : detail::ModuleRanges(hModule, sections)) ranges.push_back({ range, 0 });
+	Initialize();
+}
+
+mem::IncrementalScan::IncrementalScan(const PBYTE pBase, const DWORD dwSize, const std::span<const SignatureView> signatures, const bool bFastScan) : signatures(signatures.begin(), signatures.end()), bFastScan(bFastScan)
+{
+	if (pBase && dwSize) ranges.push_back({ { pBase, dwSize }, 0 });
+	Initialize();
+}
+
+void mem::IncrementalScan::Initialize()
+{
+	std::vector<const BYTE*> matches(signatures.size());
+	for (size_t r = 0; r < ranges.size(); r++)
+	{
+		auto& range = ranges[r];
+		range.firstPage = pageHashes.size();
+		for (size_t page = 0; page * pageSize < range.data.size(); page++)
+		{
+			const auto data = Page(r, page);
+			pageHashes.push_back(detail::HashPage(data.data(), data.size()));
+		}
+		detail::FindPatterns(range.data.data(), range.data.size(), signatures, matches, bFastScan);
+	}
+
+	results.resize(signatures.size());
+	std::ranges::transform(matches, results.begin(), [](const BYTE* pMatch) { return const_cast<std::uint8_t*>(pMatch); });
+}
+
+std::span<const BYTE> mem::IncrementalScan::Page(const size_t range, const size_t page) const noexcept
+{
+	const auto& data = ranges[range].data;
+	const size_t offset = page * pageSize;
+	return data.subspan(offset, std::min(pageSize, data.size() - offset));
+}
+
+size_t mem::IncrementalScan::Rescan(const size_t maxPages)
+{
+	std::vector<size_t> changedPages;
+	const size_t nPages = std::min(maxPages, pageHashes.size());
+	for (size_t n = 0; n < nPages; n++)
+	{
+		const size_t index = nextPage;
+		nextPage = (nextPage + 1) % pageHashes.size();
+
+		const size_t range = std::ranges::upper_bound(ranges, index, {}, &Range::firstPage) - ranges.begin() - 1;
+		const auto data = Page(range, index - ranges[range].firstPage);
+		if (const std::uint64_t hash = detail::HashPage(data.data(), data.size()); hash != pageHashes[index])
+		{
+			pageHashes[index] = hash;
+			changedPages.push_back(index);
+		}
+	}
+	if (changedPages.empty()) return 0;
+
+	// Consecutive changed pages of a range become one run, runs end up in address order
+	std::ranges::sort(changedPages);
+	std::vector<ChangedRun> runs;
+	for (const size_t index : changedPages)
+	{
+		const size_t range = std::ranges::upper_bound(ranges, index, {}, &Range::firstPage) - ranges.begin() - 1;
+		const size_t begin = (index - ranges[range].firstPage) * pageSize;
+		const size_t end = std::min(begin + pageSize, ranges[range].data.size());
+		if (!runs.empty() && runs.back().range == range && runs.back().end == begin) runs.back().end = end;
+		else runs.push_back({ range, begin, end });
+	}
+
+	for (size_t i = 0; i < signatures.size(); i++)
+	{
+		const auto& signature = signatures[i];
+		if (signature.empty()) continue;
+
+		// A new match can only come from the changed pages, and is only better when it comes before the current one
+		const BYTE* pResult = results[i];
+		const BYTE* pMatch = FindInRuns(signature, runs, pResult);
+		if (!pMatch && pResult)
+		{
+			pMatch = detail::FindPattern(pResult, signature.size, signature, bFastScan) == pResult ? pResult : FindFrom(signature, pResult + 1);
+		}
+		results[i] = const_cast<std::uint8_t*>(pMatch);
+	}
+	return changedPages.size();
+}
+
+const BYTE* mem::IncrementalScan::FindInRuns(const SignatureView& signature, const std::span<const ChangedRun> runs, const BYTE* pLimit) const
+{
+	for (const auto& run : runs)
+	{
+		// Matches overlapping the run may start up to size - 1 bytes before it
+		const auto& data = ranges[run.range].data;
+		const size_t first = run.begin >= signature.size - 1 ? run.begin - (signature.size - 1) : 0;
+		size_t last = run.end;
+		if (pLimit && pLimit < data.data() + last)
+		{
+			if (pLimit <= data.data() + first) break;
+			last = static_cast<size_t>(pLimit - data.data());
+		}
+
+		const size_t end = std::min(last + signature.size - 1, data.size());
+		if (end - first < signature.size) continue;
+		if (const BYTE* pMatch = detail::FindPattern(data.data() + first, end - first, signature, bFastScan)) return pMatch;
+	}
+	return nullptr;
+}
+
+const BYTE* mem::IncrementalScan::FindFrom(const SignatureView& signature, const BYTE* pFrom) const
+{
+	for (const auto& range : ranges)
+	{
+		const BYTE* pEnd = range.data.data() + range.data.size();
+		if (pFrom >= pEnd) continue;
+
+		const BYTE* pStart = std::max(pFrom, range.data.data());
+		if (const BYTE* pMatch = detail::FindPattern(pStart, static_cast<size_t>(pEnd - pStart), signature, bFastScan)) return pMatch;
+	}
+	return nullptr;
+}
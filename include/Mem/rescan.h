@@ -0,0 +1,63 @@
+﻿#pragma once
+#include <span>
+#include <vector>
+#include <windows.h>
+
+#include "mem.h"
+
+namespace mem
+{
+	// Batched scan that remembers a content hash of every 4 KiB page it covered, so re-validating its results after
+	// code was unpacked or patched (mem::Patch included) only revisits the pages whose hash changed.
+	// Results are the same as PatternScanBatch over the same ranges. The signature bytes must outlive the scan.
+	class IncrementalScan
+	{
+	public:
+		static constexpr size_t pageSize = 0x1000;
+
+		IncrementalScan(void* hModule, std::span<const SignatureView> signatures, bool bFastScan = false, const SectionFilter& sections = SectionFilter::Code);
+		IncrementalScan(PBYTE pBase, DWORD dwSize, std::span<const SignatureView> signatures, bool bFastScan = false);
+
+		// Rehashes up to maxPages pages (round robin, pages not reached count as unchanged) and updates the results touched by the changes.
+		// A result is scanned again from its position only when its own bytes changed and it no longer matches, otherwise only the changed pages are searched.
+		// Returns the number of pages that changed.
+		size_t Rescan(size_t maxPages = SIZE_MAX);
+
+		// First match of every signature, nullptr where there is none
+		[[nodiscard]] std::span<std::uint8_t* const> Results() const noexcept { return results; }
+		[[nodiscard]] size_t PageCount() const noexcept { return pageHashes.size(); }
+
+	private:
+		struct Range
+		{
+			std::span<const BYTE> data;
+			size_t firstPage;	// Index of its first page in pageHashes
+		};
+
+		// Bytes [begin, end) of a range that changed since the last rescan
+		struct ChangedRun
+		{
+			size_t range;
+			size_t begin;
+			size_t end;
+		};
+
+		std::vector<Range> ranges;
+		std::vector<SignatureView> signatures;
+		std::vector<std::uint8_t*> results;
+		std::vector<std::uint64_t> pageHashes;
+		size_t nextPage = 0;
+		bool bFastScan;
+
+		void Initialize();
+		[[nodiscard]] std::span<const BYTE> Page(size_t range, size_t page) const noexcept;
+		[[nodiscard]] const BYTE* FindInRuns(const SignatureView& signature, std::span<const ChangedRun> runs, const BYTE* pLimit) const;
+		[[nodiscard]] const BYTE* FindFrom(const SignatureView& signature, const BYTE* pFrom) const;
+	};
+
+	namespace detail
+	{
+		// 64-bit hash of a page (xxHash64 rounds over 32-byte stripes), only meant to detect changes
+		std::uint64_t HashPage(const BYTE* pData, size_t nSize) noexcept;
+	}
+}
@@ -0,0 +1,70 @@
+﻿#include "saferead.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+void mem::SafeReader::Update()
+{
+	// A new snapshot only when the provider re-queried or was invalidated since the last one
+	if (snapshot && !regions.IsStale() && generation == regions.QueryCount()) return;
+
+	snapshot = regions.Snapshot();
+	generation = regions.QueryCount();
+	pLast = nullptr;
+}
+
+bool mem::SafeReader::IsKnownReadable(const std::uintptr_t address, const size_t nSize)
+{
+	if (pLast && pLast->Contains(address) && nSize <= pLast->End() - address) return HasAccess(pLast->access, RegionAccess::Read);
+	return detail::IsCovered(*snapshot, address, nSize, RegionAccess::Read, &pLast);
+}
+
+bool mem::SafeReader::ReadBuffer(const std::uintptr_t address, void* pBuffer, const size_t nSize)
+{
+	if (!address || !nSize) return false;
+
+	Update();
+	if (!IsKnownReadable(address, nSize) && regions.Refresh(refreshInterval))
+	{
+		stats.refreshes++;
+		Update();
+	}
+
+	if (IsKnownReadable(address, nSize))
+	{
+		memcpy(pBuffer, reinterpret_cast<const void*>(address), nSize);
+		stats.direct++;
+		return true;
+	}
+
+	stats.system++;
+	if (detail::SystemRead(address, pBuffer, nSize)) return true;
+	stats.failures++;
+	return false;
+}
+
+bool mem::SafeReadBuffer(const std::uintptr_t address, void* pBuffer, const size_t nSize)
+{
+	thread_local SafeReader reader;
+	return reader.ReadBuffer(address, pBuffer, nSize);
+}
+
+bool mem::detail::SystemRead(const std::uintptr_t address, void* pBuffer, const size_t nSize) noexcept
+{
+#ifdef _WIN32
+	SIZE_T nRead = 0;
+	return ReadProcessMemory(GetCurrentProcess(), reinterpret_cast<LPCVOID>(address), pBuffer, nSize, &nRead) && nRead == nSize;
+#elif defined(__linux__)
+	const iovec local{ pBuffer, nSize };
+	const iovec remote{ reinterpret_cast<void*>(address), nSize };
+	return process_vm_readv(getpid(), &local, 1, &remote, 1, 0) == static_cast<ssize_t>(nSize);
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,70 @@
+﻿#pragma once
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "region.h"
+
+namespace mem
+{
+	// Reads that never fault and need no SEH: memory is only touched directly when the cached region list says it is readable.
+	// A miss refreshes the list (at most once per refreshInterval), and a range still not known readable is read through the system
+	// (ReadProcessMemory / process_vm_readv), which fails cleanly instead of faulting.
+	// The cached list is trusted until it is invalidated, so code that frees or unmaps memory others may read should call RegionProvider::Invalidate.
+	// A reader isn't thread safe, SafeRead / SafeReadBuffer use one per thread.
+	class SafeReader
+	{
+	public:
+		struct Stats
+		{
+			size_t direct = 0;		// Reads served from memory known to be readable
+			size_t refreshes = 0;	// Misses that re-queried the regions
+			size_t system = 0;		// Reads that went through the system
+			size_t failures = 0;
+		};
+
+		static constexpr std::chrono::milliseconds refreshInterval{ 50 };
+
+		explicit SafeReader(RegionProvider& regions = RegionProvider::Default()) : regions(regions) {}
+
+		bool ReadBuffer(std::uintptr_t address, void* pBuffer, size_t nSize);
+
+		template<typename T>
+		[[nodiscard]] std::optional<T> Read(const std::uintptr_t address)
+		{
+			T value;
+			if (!ReadBuffer(address, &value, sizeof(T))) return std::nullopt;
+			return value;
+		}
+
+		[[nodiscard]] const Stats& GetStats() const noexcept { return stats; }
+
+	private:
+		RegionProvider& regions;
+		std::shared_ptr<const RegionList> snapshot;
+		size_t generation = 0;
+		const MemoryRegion* pLast = nullptr;	// Region of the last direct read, in snapshot
+		Stats stats;
+
+		[[nodiscard]] bool IsKnownReadable(std::uintptr_t address, size_t nSize);
+		void Update();
+	};
+
+	// Same as SafeReader::ReadBuffer / Read with a reader per thread over RegionProvider::Default()
+	bool SafeReadBuffer(std::uintptr_t address, void* pBuffer, size_t nSize);
+
+	template<typename T>
+	[[nodiscard]] std::optional<T> SafeRead(const std::uintptr_t address)
+	{
+		T value;
+		if (!SafeReadBuffer(address, &value, sizeof(T))) return std::nullopt;
+		return value;
+	}
+
+	namespace detail
+	{
+		// Read through the system, false (no fault) when any part of the range isn't readable
+		bool SystemRead(std::uintptr_t address, void* pBuffer, size_t nSize) noexcept;
+	}
+}
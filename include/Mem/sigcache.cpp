@@ -0,0 +1,259 @@
+﻿#include "sigcache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <type_traits>
+
+namespace
+{
+	constexpr DWORD cacheMagic = 0x4749534D; // "MSIG"
+	constexpr DWORD cacheVersion = 3;	// 2: x86 keys hash the signature size on 64 bits, 3: keys hash the section filter
+
+	constexpr std::uint64_t fnvOffset = 0xCBF29CE484222325;
+	constexpr std::uint64_t fnvPrime = 0x100000001B3;
+
+	std::uint64_t Fnv1a(const BYTE* pData, const size_t nSize, std::uint64_t hash = fnvOffset) noexcept
+	{
+		for (size_t i = 0; i < nSize; i++)
+		{
+			hash ^= pData[i];
+			hash *= fnvPrime;
+		}
+		return hash;
+	}
+
+	// Fixed-width values only, so 32 and 64-bit builds (and sigresolve) hash the same bytes
+	template<typename T> requires std::is_same_v<T, std::uint32_t> || std::is_same_v<T, std::uint64_t>
+	std::uint64_t Fnv1a(const T& value, const std::uint64_t hash) noexcept
+	{
+		return Fnv1a(reinterpret_cast<const BYTE*>(&value), sizeof(T), hash);
+	}
+
+	template<typename T>
+	void WriteValue(std::ofstream& file, const T& value)
+	{
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	bool ReadValue(std::ifstream& file, T& value)
+	{
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+}
+
+mem::ModuleFingerprint mem::ModuleFingerprint::FromImage(const PEView& image)
+{
+	if (!image.IsValid()) return {};
+
+	ModuleFingerprint fingerprint{
+		.timeDateStamp = image.FileHeader().TimeDateStamp,
+		.checkSum = image.CheckSum(),
+		.sizeOfImage = image.SizeOfImage()
+	};
+
+	// Hashing whole code sections would cost as much as scanning them, so only 64 bytes out of every 4 KiB are sampled.
+	// Only the initialized part of each section is used, and bytes listed in the relocation directory are hashed as zero:
+	// the hash is then identical for files on disk and mapped images, rebased or not.
+	constexpr size_t sampleSize = 64;
+	constexpr size_t sampleStride = 4096;
+
+	const RelocationMap relocations(image);
+	std::uint64_t hash = fnvOffset;
+	for (const auto& section : image.Sections())
+	{
+		if (!SectionFilter::Code.Matches(section.Characteristics)) continue;
+
+		auto data = image.SectionData(section);
+		data = data.first(std::min<size_t>(data.size(), section.SizeOfRawData));
+
+		hash = Fnv1a(static_cast<std::uint32_t>(section.VirtualAddress), hash);
+		hash = Fnv1a(static_cast<std::uint64_t>(data.size()), hash);
+		for (size_t offset = 0; offset < data.size(); offset += sampleStride)
+		{
+			const size_t nSample = std::min(sampleSize, data.size() - offset);
+			const DWORD rva = section.VirtualAddress + static_cast<DWORD>(offset);
+			if (!relocations.PageBitmap(rva) && !relocations.PageBitmap(rva + static_cast<DWORD>(nSample) - 1))
+			{
+				hash = Fnv1a(data.data() + offset, nSample, hash);
+				continue;
+			}
+
+			BYTE sample[sampleSize];
+			for (size_t i = 0; i < nSample; i++) sample[i] = relocations.IsRelocated(rva + static_cast<DWORD>(i)) ? 0 : data[offset + i];
+			hash = Fnv1a(sample, nSample, hash);
+		}
+	}
+	fingerprint.codeHash = hash;
+	return fingerprint;
+}
+
+std::uint64_t mem::HashSignature(const SignatureView& signature, const SectionFilter& sections) noexcept
+{
+	std::uint64_t hash = Fnv1a(static_cast<std::uint64_t>(signature.size), fnvOffset);
+	hash = Fnv1a(signature.bytes, signature.size, hash);
+	hash = Fnv1a(signature.mask, signature.size, hash);
+	hash = Fnv1a(static_cast<std::uint32_t>(sections.required), hash);
+	return Fnv1a(static_cast<std::uint32_t>(sections.excluded), hash);
+}
+
+bool mem::SignatureCache::Load(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) return false;
+
+	DWORD magic, version, moduleCount;
+	if (!ReadValue(file, magic) || !ReadValue(file, version) || !ReadValue(file, moduleCount)) return false;
+	if (magic != cacheMagic || version != cacheVersion) return false;
+
+	std::unordered_map<std::string, ModuleEntry> loaded;
+	for (DWORD i = 0; i < moduleCount; i++)
+	{
+		WORD nameLength;
+		if (!ReadValue(file, nameLength)) return false;
+
+		std::string name(nameLength, '\0');
+		if (!file.read(name.data(), nameLength)) return false;
+
+		ModuleEntry entry;
+		DWORD entryCount;
+		if (!ReadValue(file, entry.fingerprint.timeDateStamp) || !ReadValue(file, entry.fingerprint.checkSum) || !ReadValue(file, entry.fingerprint.sizeOfImage) || !ReadValue(file, entry.fingerprint.codeHash) || !ReadValue(file, entryCount)) return false;
+
+		for (DWORD j = 0; j < entryCount; j++)
+		{
+			std::uint64_t key;
+			DWORD rva;
+			if (!ReadValue(file, key) || !ReadValue(file, rva)) return false;
+			entry.rvas.emplace(key, rva);
+		}
+		loaded.insert_or_assign(std::move(name), std::move(entry));
+	}
+
+	std::scoped_lock lock(mutex);
+	modules = std::move(loaded);
+	bDirty = false;
+	return true;
+}
+
+bool mem::SignatureCache::Save(const std::filesystem::path& path) const
+{
+	std::scoped_lock lock(mutex);
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file) return false;
+
+	WriteValue(file, cacheMagic);
+	WriteValue(file, cacheVersion);
+	WriteValue(file, static_cast<DWORD>(modules.size()));
+
+	for (const auto& [name, entry] : modules)
+	{
+		WriteValue(file, static_cast<WORD>(name.size()));
+		file.write(name.data(), static_cast<std::streamsize>(name.size()));
+
+		WriteValue(file, entry.fingerprint.timeDateStamp);
+		WriteValue(file, entry.fingerprint.checkSum);
+		WriteValue(file, entry.fingerprint.sizeOfImage);
+		WriteValue(file, entry.fingerprint.codeHash);
+		WriteValue(file, static_cast<DWORD>(entry.rvas.size()));
+
+		for (const auto& [key, rva] : entry.rvas)
+		{
+			WriteValue(file, key);
+			WriteValue(file, rva);
+		}
+	}
+
+	if (!file) return false;
+	bDirty = false;
+	return true;
+}
+
+const BYTE* mem::SignatureCache::Find(const PEView& image, const std::string_view moduleName, const SignatureView& signature, const SectionFilter& sections)
+{
+	if (!image.IsValid() || signature.empty()) return nullptr;
+
+	std::optional<DWORD> rva;
+	{
+		std::scoped_lock lock(mutex);
+		rva = FindRva(image, moduleName, HashSignature(signature, sections));
+	}
+	if (!rva) return nullptr;
+
+	// Only the pattern bytes at the cached RVA are compared
+	const BYTE* pMatch = image.RvaToPointer(*rva);
+	if (!pMatch || pMatch + signature.size > image.Base() + image.Size()) return nullptr;
+
+	for (size_t i = 0; i < signature.size; i++)
+	{
+		if ((pMatch[i] & signature.mask[i]) != signature.bytes[i]) return nullptr;
+	}
+	return pMatch;
+}
+
+void mem::SignatureCache::Store(const PEView& image, const std::string_view moduleName, const SignatureView& signature, const BYTE* pMatch, const SectionFilter& sections)
+{
+	if (!image.IsValid() || signature.empty() || !pMatch) return;
+
+	const DWORD rva = image.PointerToRva(pMatch);
+	if (!rva) return;
+
+	std::scoped_lock lock(mutex);
+
+	auto& module = modules[std::string(moduleName)];
+	if (const auto& fingerprint = GetFingerprint(image); module.fingerprint != fingerprint)
+	{
+		// Module was updated, everything recorded for the previous build is stale
+		module.fingerprint = fingerprint;
+		module.rvas.clear();
+	}
+
+	if (auto [it, inserted] = module.rvas.try_emplace(HashSignature(signature, sections), rva); inserted || it->second != rva)
+	{
+		it->second = rva;
+		bDirty = true;
+	}
+}
+
+void mem::SignatureCache::Clear()
+{
+	std::scoped_lock lock(mutex);
+	modules.clear();
+	fingerprints.clear();
+	bDirty = true;
+}
+
+std::optional<DWORD> mem::SignatureCache::FindRva(const PEView& image, const std::string_view moduleName, const std::uint64_t key)
+{
+	const auto& fingerprint = GetFingerprint(image);
+
+	if (const auto module = modules.find(std::string(moduleName)); module != modules.end() && module->second.fingerprint == fingerprint)
+	{
+		if (const auto cached = module->second.rvas.find(key); cached != module->second.rvas.end()) return cached->second;
+	}
+
+	for (const auto& module : precomputed)
+	{
+		if (module.fingerprint != fingerprint || _stricmp(module.name, std::string(moduleName).c_str()) != 0) continue;
+
+		const auto resolved = std::ranges::lower_bound(module.signatures, key, {}, &ResolvedSignature::key);
+		if (resolved != module.signatures.end() && resolved->key == key) return resolved->rva;
+	}
+	return std::nullopt;
+}
+
+const mem::ModuleFingerprint& mem::SignatureCache::GetFingerprint(const PEView& image)
+{
+	if (const auto it = fingerprints.find(image.Base()); it != fingerprints.end()) return it->second;
+	return fingerprints.emplace(image.Base(), ModuleFingerprint::FromImage(image)).first->second;
+}
+
+std::string mem::detail::GetModuleName(const HMODULE hModule)
+{
+	char buffer[MAX_PATH]{};
+	if (const DWORD length = GetModuleFileNameA(hModule, buffer, MAX_PATH); length && length < MAX_PATH)
+	{
+		return std::filesystem::path(buffer).filename().string();
+	}
+	return {};
+}
@@ -0,0 +1,103 @@
+﻿#pragma once
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <windows.h>
+
+#include "mem.h"
+
+namespace mem
+{
+	// Identifies a module build: header fields plus a sampled hash of its code sections, relocated bytes left out.
+	struct ModuleFingerprint
+	{
+		DWORD timeDateStamp = 0;
+		DWORD checkSum = 0;
+		DWORD sizeOfImage = 0;
+		std::uint64_t codeHash = 0;
+
+		[[nodiscard]] static ModuleFingerprint FromImage(const PEView& image);
+
+		bool operator==(const ModuleFingerprint&) const = default;
+	};
+
+	// Hash of the pattern bytes, mask and scanned sections, used as the cache key of a signature
+	[[nodiscard]] std::uint64_t HashSignature(const SignatureView& signature, const SectionFilter& sections = SectionFilter::Code) noexcept;
+
+	// Signature RVA computed offline for a known module build (see tools/sigresolve.cpp)
+	struct ResolvedSignature
+	{
+		std::uint64_t key;	// HashSignature
+		DWORD rva;
+	};
+
+	struct ResolvedModule
+	{
+		const char* name;
+		ModuleFingerprint fingerprint;
+		std::span<const ResolvedSignature> signatures;	// Sorted by key
+	};
+
+	// On-disk cache of signature matches (as RVAs) per module build.
+	// A cached RVA is only trusted while the module fingerprint is unchanged and the signature still matches at that RVA.
+	class SignatureCache
+	{
+	public:
+		bool Load(const std::filesystem::path& path);
+		bool Save(const std::filesystem::path& path) const;
+
+		// Matches are cached per section filter: the first match in .text says nothing about the first one in .data
+		[[nodiscard]] const BYTE* Find(const PEView& image, std::string_view moduleName, const SignatureView& signature, const SectionFilter& sections = SectionFilter::Code);
+		void Store(const PEView& image, std::string_view moduleName, const SignatureView& signature, const BYTE* pMatch, const SectionFilter& sections = SectionFilter::Code);
+
+		// Build-time results, looked up when the cache has nothing for a signature (same fingerprint and pattern checks)
+		void SetPrecomputed(std::span<const ResolvedModule> resolved) noexcept { precomputed = resolved; }
+
+		[[nodiscard]] bool IsDirty() const noexcept { return bDirty; }
+		void Clear();
+
+	private:
+		struct ModuleEntry
+		{
+			ModuleFingerprint fingerprint;
+			std::unordered_map<std::uint64_t, DWORD> rvas;
+		};
+
+		mutable std::mutex mutex;
+		std::unordered_map<std::string, ModuleEntry> modules;
+		std::unordered_map<const BYTE*, ModuleFingerprint> fingerprints; // Computed once per loaded image
+		std::span<const ResolvedModule> precomputed;
+		mutable bool bDirty = false;
+
+		const ModuleFingerprint& GetFingerprint(const PEView& image);
+		std::optional<DWORD> FindRva(const PEView& image, std::string_view moduleName, std::uint64_t key);
+	};
+
+	inline SignatureCache signatureCache;
+
+	namespace detail
+	{
+		// File name of a loaded module ("game.exe"), used as the cache key of its entries
+		std::string GetModuleName(HMODULE hModule);
+	}
+
+	// Module PatternScan that goes through signatureCache first and records new matches
+	template<typename T = std::uint8_t*>
+	T PatternScanCached(const HMODULE hModule, const SignatureView& signature, const bool bFastScan = false, const SectionFilter& sections = SectionFilter::Code)
+	{
+		const PEView image(hModule);
+		const std::string moduleName = detail::GetModuleName(hModule);
+		if (const BYTE* pCached = signatureCache.Find(image, moduleName, signature, sections))
+		{
+			return reinterpret_cast<T>(const_cast<BYTE*>(pCached));
+		}
+
+		const auto address = PatternScan<std::uint8_t*>(hModule, signature, bFastScan, sections);
+		signatureCache.Store(image, moduleName, signature, address, sections);
+		return reinterpret_cast<T>(address);
+	}
+}
@@ -0,0 +1,151 @@
+﻿#include "siggen.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "mem.h"
+#include "x86.h"
+
+namespace
+{
+	// Candidates are only collected once the pattern is selective enough to have at most this many matches
+	constexpr size_t maxCandidates = 1 << 14;
+
+	struct Candidate
+	{
+		const BYTE* pMatch;
+		const BYTE* pRangeEnd;
+	};
+
+	bool InImage(const ULONGLONG value, const ULONGLONG imageStart, const ULONGLONG imageEnd)
+	{
+		return value >= imageStart && value < imageEnd;
+	}
+
+	ULONGLONG ReadOperand(const BYTE* pOperand, const size_t nSize)
+	{
+		ULONGLONG value = 0;
+		std::memcpy(&value, pOperand, nSize);
+		return value;
+	}
+
+	std::string FormatPattern(const BYTE* bytes, const BYTE* mask, size_t size)
+	{
+		while (size && !mask[size - 1]) size--;
+
+		constexpr char hexDigits[] = "0123456789ABCDEF";
+
+		std::string pattern;
+		pattern.reserve(size * 3);
+		for (size_t i = 0; i < size; i++)
+		{
+			if (i) pattern += ' ';
+			pattern += mask[i] ? hexDigits[bytes[i] >> 4] : '?';
+			pattern += mask[i] ? hexDigits[bytes[i] & 0xF] : '?';
+		}
+		return pattern;
+	}
+
+	std::string Generate(std::span<const std::span<const BYTE>> ranges, const mem::PEView& image, const BYTE* pAddress, const size_t maxLength)
+	{
+		const auto range = std::ranges::find_if(ranges, [&](const auto& r) { return pAddress >= r.data() && pAddress < r.data() + r.size(); });
+		if (range == ranges.end()) return {};
+		const BYTE* pRangeEnd = range->data() + range->size();
+
+		// Absolute addresses in a file on disk are based on the preferred ImageBase, loaded images are relocated
+		const ULONGLONG imageStart = image.Layout() == mem::ImageLayout::File ? image.ImageBase() : reinterpret_cast<ULONGLONG>(image.Base());
+		const ULONGLONG imageEnd = imageStart + image.SizeOfImage();
+
+		std::vector<BYTE> bytes(maxLength), mask(maxLength);
+		std::vector<Candidate> candidates;
+		bool bCollected = false;
+
+		size_t size = 0;
+		while (size < maxLength)
+		{
+			const BYTE* pInstruction = pAddress + size;
+			mem::x86::Instruction instruction;
+			if (!mem::x86::Decode(pInstruction, static_cast<size_t>(pRangeEnd - pInstruction), image.Is64(), instruction)) return {};
+			if (size + instruction.length > maxLength) return {};
+
+			std::memcpy(&bytes[size], pInstruction, instruction.length);
+			std::memset(&mask[size], 0xFF, instruction.length);
+
+			// Bytes that change with the build or the load address
+			const auto wildcard = [&](const BYTE offset, const BYTE count)
+			{
+				std::memset(&bytes[size + offset], 0x00, count);
+				std::memset(&mask[size + offset], 0x00, count);
+			};
+			if (instruction.dispSize == 4 || instruction.dispSize == 8)
+			{
+				if (instruction.bRipRelative || instruction.bAbsoluteMemory || InImage(ReadOperand(pInstruction + instruction.dispOffset, instruction.dispSize), imageStart, imageEnd))
+				{
+					wildcard(instruction.dispOffset, instruction.dispSize);
+				}
+			}
+			if (instruction.immSize >= 4)
+			{
+				if (instruction.bRelative || InImage(ReadOperand(pInstruction + instruction.immOffset, std::min<size_t>(instruction.immSize, 8)), imageStart, imageEnd))
+				{
+					wildcard(instruction.immOffset, instruction.immSize);
+				}
+			}
+			size += instruction.length;
+
+			mem::SignatureView signature{ bytes.data(), mask.data(), size };
+			mem::detail::SelectAnchors(signature);
+			if (signature.wildcardsOnly()) continue;
+
+			if (!bCollected)
+			{
+				// Full scan once, then the candidates only shrink as the pattern grows
+				bool bOverflow = false;
+				candidates.clear();
+				for (const auto& r : ranges)
+				{
+					for (const BYTE* pMatch : mem::PatternScanAll(const_cast<PBYTE>(r.data()), static_cast<DWORD>(r.size()), signature))
+					{
+						if ((bOverflow = candidates.size() == maxCandidates)) break;
+						candidates.push_back({ pMatch, r.data() + r.size() });
+					}
+					if (bOverflow) break;
+				}
+				if (bOverflow) continue;
+				bCollected = true;
+			}
+			else
+			{
+				std::erase_if(candidates, [&](const Candidate& candidate)
+				{
+					if (candidate.pMatch + size > candidate.pRangeEnd) return true;
+					for (size_t i = 0; i < size; i++)
+					{
+						if ((candidate.pMatch[i] & mask[i]) != bytes[i]) return true;
+					}
+					return false;
+				});
+			}
+
+			if (candidates.size() == 1) return FormatPattern(bytes.data(), mask.data(), size);
+			if (candidates.empty()) return {};
+		}
+		return {};
+	}
+}
+
+std::string mem::GenerateSignature(const PEView& image, const BYTE* pAddress, const size_t maxLength)
+{
+	if (!image.IsValid()) return {};
+	const auto ranges = image.SectionRanges(SectionFilter::Code);
+	return Generate(ranges, image, pAddress, maxLength);
+}
+
+std::string mem::GenerateSignature(const HMODULE hModule, const void* pAddress, const size_t maxLength)
+{
+	const PEView image(hModule);
+	if (!image.IsValid()) return {};
+	const auto ranges = detail::ModuleRanges(hModule, SectionFilter::Code);
+	return Generate(ranges, image, static_cast<const BYTE*>(pAddress), maxLength);
+}
@@ -0,0 +1,15 @@
+﻿#pragma once
+#include <string>
+#include <windows.h>
+
+#include "pe.h"
+
+namespace mem
+{
+	// Shortest pattern made of whole instructions starting at pAddress that matches only once in the image code sections ("48 8B 05 ?? ?? ?? ?? 44 8B C5").
+	// RIP-relative displacements, rel32 branch targets and absolute addresses inside the image are wildcarded.
+	// Returns an empty string if the address isn't in the image code or no unique pattern fits in maxLength bytes.
+	std::string GenerateSignature(const PEView& image, const BYTE* pAddress, size_t maxLength = 64);
+	// Same for a module loaded in this process, only its committed, readable code is searched
+	std::string GenerateSignature(HMODULE hModule, const void* pAddress, size_t maxLength = 64);
+}
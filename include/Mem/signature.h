@@ -0,0 +1,371 @@
+﻿#pragma once
+#include <array>
+#include <utility>
+#include <string_view>
+#include <windows.h>
+
+namespace mem
+{
+	enum class CaptureType : std::uint8_t
+	{
+		Rel8,	///< 8-bit displacement, target = end of instruction + disp8
+		Rel32,	///< 32-bit displacement (RIP-relative operands, jmp/call), target = end of instruction + disp32
+		Abs32,	///< 32-bit absolute address
+		Abs64	///< 64-bit absolute address
+	};
+
+	// Operand marked in a pattern ("48 8B 05 [rel32] 44 8B C5", "E8 [call]"), resolved to the address it references.
+	struct Capture
+	{
+		BYTE offset = 0;				// Position of the operand in the pattern
+		CaptureType type = CaptureType::Rel32;
+		BYTE trailing = 0;				// Instruction bytes after a relative operand ("[rel32+1]" for "80 3D [rel32+1] 00")
+		BYTE derefs = 0;				// Pointers followed after resolving ("[rel32]**")
+
+		[[nodiscard]] constexpr size_t size() const noexcept
+		{
+			switch (type)
+			{
+			case CaptureType::Rel8: return 1;
+			case CaptureType::Abs64: return 8;
+			default: return 4;
+			}
+		}
+	};
+
+	// Non-owning view of a parsed pattern: a byte matches when (byte & mask[i]) == bytes[i].
+	struct SignatureView
+	{
+		static constexpr size_t npos = static_cast<size_t>(-1);
+
+		const BYTE* bytes = nullptr;
+		const BYTE* mask = nullptr;
+		size_t size = 0;
+
+		size_t anchor = npos;		// Rarest fully masked byte, npos if none is (only wildcards, nibble wildcards and alternatives)
+		size_t secondAnchor = npos;	// Second rarest fully masked byte (== anchor if there is only one)
+
+		const Capture* captures = nullptr;
+		size_t captureCount = 0;
+
+		[[nodiscard]] constexpr bool empty() const noexcept { return size == 0; }
+
+		// True when every byte is a full wildcard, so anything matches
+		[[nodiscard]] constexpr bool wildcardsOnly() const noexcept
+		{
+			for (size_t i = 0; i < size; i++)
+			{
+				if (mask[i]) return false;
+			}
+			return true;
+		}
+	};
+
+	namespace detail
+	{
+		// Rough byte frequencies of compiled x86/x64 code (higher = more common), used to pick the scan anchors.
+		constexpr std::array<BYTE, 256> byteFrequency = []
+		{
+			std::array<BYTE, 256> table{};
+			constexpr BYTE commonBytes[] = {
+				0x00, 0xFF, 0xCC, 0x48, 0x8B, 0x89, 0x0F, 0x24, 0x4C, 0x44, 0xE8, 0x83, 0x01, 0x8D, 0x45, 0x85,
+				0xC0, 0x74, 0x75, 0x10, 0x08, 0x20, 0x40, 0x41, 0x49, 0x4D, 0x04, 0x33, 0xC3, 0x90, 0xEB, 0x50,
+				0x5C, 0xD0, 0x02, 0x03, 0x18, 0x28, 0x30, 0x38, 0xC7, 0x84, 0x8E, 0xC1, 0xF8, 0x0D, 0x05, 0x15
+			};
+			BYTE score = 255;
+			for (const BYTE value : commonBytes) table[value] = score--;
+			return table;
+		}();
+
+		constexpr int HexValue(const char c) noexcept
+		{
+			if (c >= '0' && c <= '9') return c - '0';
+			if (c >= 'a' && c <= 'f') return c - 'a' + 0xA;
+			if (c >= 'A' && c <= 'F') return c - 'A' + 0xA;
+			return -1;
+		}
+
+		constexpr size_t maxCaptures = 4;
+
+		// Bytes needed to parse a pattern of this length, "[abs64]" is the only token producing more bytes than characters
+		constexpr size_t PatternCapacity(const size_t length) noexcept
+		{
+			return length + length / 7 + 1;
+		}
+
+		// Parses a capture marker starting at pattern[i] ('['), i is moved past it
+		constexpr bool ParseCapture(const std::string_view pattern, size_t& i, Capture& capture) noexcept
+		{
+			constexpr std::pair<std::string_view, CaptureType> captureNames[] = {
+				{ "rel8", CaptureType::Rel8 }, { "rel32", CaptureType::Rel32 }, { "call", CaptureType::Rel32 },
+				{ "abs32", CaptureType::Abs32 }, { "abs64", CaptureType::Abs64 }
+			};
+
+			const size_t close = pattern.find(']', i);
+			if (close == std::string_view::npos) return false;
+
+			std::string_view marker = pattern.substr(i + 1, close - i - 1);
+			i = close + 1;
+
+			int trailing = 0;
+			if (const size_t plus = marker.find('+'); plus != std::string_view::npos)
+			{
+				if (plus + 1 == marker.size()) return false;
+				for (const char c : marker.substr(plus + 1))
+				{
+					if (c < '0' || c > '9' || (trailing = trailing * 10 + (c - '0')) > 0xFF) return false;
+				}
+				marker = marker.substr(0, plus);
+			}
+
+			bool bFound = false;
+			for (const auto& [name, type] : captureNames)
+			{
+				if (marker == name)
+				{
+					capture.type = type;
+					bFound = true;
+				}
+			}
+			if (!bFound || (trailing && (capture.type == CaptureType::Abs32 || capture.type == CaptureType::Abs64))) return false;
+			capture.trailing = static_cast<BYTE>(trailing);
+
+			capture.derefs = 0;
+			while (i < pattern.size() && pattern[i] == '*')
+			{
+				capture.derefs++;
+				i++;
+			}
+			return true;
+		}
+
+		// Parses one byte at pattern[i]: "8B", "??" or "?" (any byte), "4?" / "?B" (one nibble), i is moved past it
+		constexpr bool ParseByte(const std::string_view pattern, size_t& i, BYTE& value, BYTE& mask) noexcept
+		{
+			if (pattern[i] == '?' && (i + 1 >= pattern.size() || (pattern[i + 1] != '?' && HexValue(pattern[i + 1]) < 0)))
+			{
+				i++;
+				value = mask = 0x00;
+				return true;
+			}
+			if (i + 1 >= pattern.size()) return false;
+
+			value = mask = 0x00;
+			for (int shift = 4; shift >= 0; shift -= 4, i++)
+			{
+				if (pattern[i] == '?') continue;
+
+				const int nibble = HexValue(pattern[i]);
+				if (nibble < 0) return false;
+				value |= static_cast<BYTE>(nibble << shift);
+				mask |= static_cast<BYTE>(0xF << shift);
+			}
+			return true;
+		}
+
+		// Parses "(8B|89)" at pattern[i] into a single value/mask pair, i is moved past it.
+		// The matched set must be exactly representable: the alternatives have to cover every combination of the bits they differ in
+		// ("(8B|89)", "(50|51|52|53)"), otherwise a mask would also accept bytes that aren't listed.
+		constexpr bool ParseAlternatives(const std::string_view pattern, size_t& i, BYTE& value, BYTE& mask) noexcept
+		{
+			bool members[256]{};
+			i++;
+			while (true)
+			{
+				while (i < pattern.size() && pattern[i] == ' ') i++;
+				if (i >= pattern.size()) return false;
+
+				BYTE alternativeValue, alternativeMask;
+				if (!ParseByte(pattern, i, alternativeValue, alternativeMask)) return false;
+				for (size_t c = 0; c < 256; c++)
+				{
+					if ((c & alternativeMask) == alternativeValue) members[c] = true;
+				}
+
+				while (i < pattern.size() && pattern[i] == ' ') i++;
+				if (i >= pattern.size()) return false;
+				if (pattern[i++] == ')') break;
+				if (pattern[i - 1] != '|') return false;
+			}
+
+			// Bits shared by every member
+			BYTE ones = 0xFF, zeros = 0xFF;
+			size_t count = 0;
+			for (size_t c = 0; c < 256; c++)
+			{
+				if (!members[c]) continue;
+				ones &= static_cast<BYTE>(c);
+				zeros &= static_cast<BYTE>(~c);
+				count++;
+			}
+			mask = ones | zeros;
+			value = ones;
+
+			size_t freeBits = 0;
+			for (BYTE bits = static_cast<BYTE>(~mask); bits; bits &= bits - 1) freeBits++;
+			return count == static_cast<size_t>(1) << freeBits;
+		}
+
+		// Parses a code-style pattern: raw bytes plus a mask string where 'x' keeps a byte and '?' (or '.') skips it ("\x48\x8B\x05", "xx?").
+		// The pattern holds at least mask.size() bytes. Returns false on malformed input.
+		constexpr bool ParseCodePattern(const char* pattern, const std::string_view codeMask, BYTE* bytes, BYTE* mask, size_t& size) noexcept
+		{
+			size = 0;
+			for (const char c : codeMask)
+			{
+				if (c == 'x') mask[size] = 0xFF;
+				else if (c == '?' || c == '.') mask[size] = 0x00;
+				else return false;
+
+				bytes[size] = static_cast<BYTE>(pattern[size]) & mask[size];
+				size++;
+			}
+			return size != 0;
+		}
+
+		// Parses an IDA-style pattern ("48 8B 05 ?? ?? ?? ??", "?" also accepted) into bytes/mask.
+		// Nibble wildcards ("4?", "?B") and alternatives ("(8B|89)") compile to a single value/mask pair.
+		// Capture markers ("[rel8]", "[rel32]", "[call]", "[abs32]", "[abs64]", optionally "+N" and trailing '*') become wildcards and are stored in captures (up to maxCaptures).
+		// Both buffers must hold at least PatternCapacity(pattern.size()) bytes. Returns false on malformed input.
+		constexpr bool ParsePattern(const std::string_view pattern, BYTE* bytes, BYTE* mask, size_t& size, Capture* captures, size_t& captureCount) noexcept
+		{
+			size = 0;
+			captureCount = 0;
+
+			size_t i = 0;
+			while (i < pattern.size())
+			{
+				if (pattern[i] == ' ')
+				{
+					i++;
+					continue;
+				}
+
+				if (pattern[i] == '[')
+				{
+					Capture capture;
+					if (!ParseCapture(pattern, i, capture) || size > 0xFF) return false;
+					capture.offset = static_cast<BYTE>(size);
+
+					if (captureCount == maxCaptures) return false;
+					captures[captureCount++] = capture;
+
+					for (size_t j = 0; j < capture.size(); j++, size++)
+					{
+						bytes[size] = 0x00;
+						mask[size] = 0x00;
+					}
+					continue;
+				}
+
+				const bool bParsed = pattern[i] == '(' ? ParseAlternatives(pattern, i, bytes[size], mask[size]) : ParseByte(pattern, i, bytes[size], mask[size]);
+				if (!bParsed) return false;
+				size++;
+			}
+			return size != 0;
+		}
+
+		constexpr bool ParsePattern(const std::string_view pattern, BYTE* bytes, BYTE* mask, size_t& size) noexcept
+		{
+			Capture captures[maxCaptures];
+			size_t captureCount;
+			return ParsePattern(pattern, bytes, mask, size, captures, captureCount);
+		}
+
+		constexpr void SelectAnchors(SignatureView& signature) noexcept
+		{
+			constexpr size_t npos = SignatureView::npos;
+			signature.anchor = signature.secondAnchor = npos;
+
+			for (size_t i = 0; i < signature.size; i++)
+			{
+				if (signature.mask[i] != 0xFF) continue;
+
+				const BYTE frequency = byteFrequency[signature.bytes[i]];
+				if (signature.anchor == npos || frequency < byteFrequency[signature.bytes[signature.anchor]])
+				{
+					signature.secondAnchor = signature.anchor;
+					signature.anchor = i;
+				}
+				else if (signature.secondAnchor == npos || frequency < byteFrequency[signature.bytes[signature.secondAnchor]])
+				{
+					signature.secondAnchor = i;
+				}
+			}
+
+			if (signature.secondAnchor == npos) signature.secondAnchor = signature.anchor;
+		}
+	}
+
+	// Pattern parsed at compile time, malformed patterns don't compile:
+	//	constexpr mem::Signature signature = "48 8B 05 ?? ?? ?? ??";
+	//	mem::PatternScan(hModule, "48 8B 05 ?? ?? ?? ??"_sig);
+	// Marked operands are resolved by mem::ResolveCapture / mem::PatternScanCapture:
+	//	constexpr mem::Signature signature = "48 8B 05 [rel32] 44 8B C5";
+	// Code-style byte string and mask:
+	//	constexpr mem::Signature signature("\x48\x8B\x05\x00\x00\x00\x00", "xxx????");
+	template<size_t N>
+	struct Signature
+	{
+		static constexpr size_t capacity = detail::PatternCapacity(N);
+
+		BYTE bytes[capacity]{};
+		BYTE mask[capacity]{};
+		size_t size = 0;
+		size_t anchor = SignatureView::npos;
+		size_t secondAnchor = SignatureView::npos;
+		Capture captures[detail::maxCaptures]{};
+		size_t captureCount = 0;
+
+		consteval Signature(const char (&pattern)[N])
+		{
+			if (!detail::ParsePattern({ pattern, N - 1 }, bytes, mask, size, captures, captureCount))
+			{
+				throw "mem::Signature: malformed pattern";
+			}
+
+			SelectAnchors();
+		}
+
+		consteval Signature(const char (&pattern)[N], const char (&codeMask)[N])
+		{
+			if (!detail::ParseCodePattern(pattern, { codeMask, N - 1 }, bytes, mask, size))
+			{
+				throw "mem::Signature: malformed code-style pattern";
+			}
+
+			SelectAnchors();
+		}
+
+		[[nodiscard]] constexpr SignatureView view() const noexcept
+		{
+			return { bytes, mask, size, anchor, secondAnchor, captures, captureCount };
+		}
+
+		constexpr operator SignatureView() const noexcept { return view(); }
+
+	private:
+		constexpr void SelectAnchors() noexcept
+		{
+			SignatureView signature{ bytes, mask, size };
+			detail::SelectAnchors(signature);
+			anchor = signature.anchor;
+			secondAnchor = signature.secondAnchor;
+		}
+	};
+
+	namespace detail
+	{
+		template<Signature S>
+		inline constexpr auto signatureStorage = S;
+	}
+
+	namespace literals
+	{
+		template<Signature S>
+		consteval SignatureView operator""_sig()
+		{
+			return detail::signatureStorage<S>.view();
+		}
+	}
+}
@@ -0,0 +1,152 @@
+﻿#include "strref.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	bool IsPrintable(const unsigned value)
+	{
+		return (value >= 0x20 && value < 0x7F) || value == '\t' || value == '\n' || value == '\r';
+	}
+
+	DWORD ReadDword(const BYTE* pAddress)
+	{
+		DWORD value;
+		std::memcpy(&value, pAddress, sizeof(value));
+		return value;
+	}
+
+	// Strings of the read-only data sections by RVA
+	class StringTable
+	{
+	public:
+		StringTable(const mem::PEView& image, const size_t minLength)
+		{
+			for (const auto& section : image.Sections())
+			{
+				if (!mem::SectionFilter::ReadOnlyData.Matches(section.Characteristics)) continue;
+
+				const auto data = image.SectionData(section);
+				CollectAscii(data, section.VirtualAddress, minLength);
+				CollectUtf16(data, section.VirtualAddress, minLength);
+			}
+		}
+
+		[[nodiscard]] bool Empty() const noexcept { return strings.empty(); }
+
+		[[nodiscard]] const std::string* Find(const DWORD rva) const
+		{
+			if (rva < lowest || rva > highest) return nullptr;
+			const auto it = strings.find(rva);
+			return it != strings.end() ? &it->second : nullptr;
+		}
+
+	private:
+		std::unordered_map<DWORD, std::string> strings;
+		DWORD lowest = MAXDWORD;
+		DWORD highest = 0;
+
+		void Add(const DWORD rva, std::string text)
+		{
+			lowest = std::min(lowest, rva);
+			highest = std::max(highest, rva);
+			strings.emplace(rva, std::move(text));
+		}
+
+		void CollectAscii(const std::span<const BYTE> data, const DWORD rva, const size_t minLength)
+		{
+			for (size_t i = 0; i < data.size();)
+			{
+				size_t end = i;
+				while (end < data.size() && IsPrintable(data[end])) end++;
+
+				if (end < data.size() && data[end] == 0 && end - i >= minLength)
+				{
+					Add(rva + static_cast<DWORD>(i), std::string(reinterpret_cast<const char*>(data.data() + i), end - i));
+				}
+				i = end + 1;
+			}
+		}
+
+		void CollectUtf16(const std::span<const BYTE> data, const DWORD rva, const size_t minLength)
+		{
+			// Wide literals are 2-byte aligned
+			for (size_t i = rva & 1; i + 1 < data.size();)
+			{
+				size_t end = i;
+				while (end + 1 < data.size() && data[end + 1] == 0 && IsPrintable(data[end])) end += 2;
+
+				const size_t length = (end - i) / 2;
+				if (end + 1 < data.size() && data[end] == 0 && data[end + 1] == 0 && length >= minLength)
+				{
+					std::string text(length, '\0');
+					for (size_t c = 0; c < length; c++) text[c] = static_cast<char>(data[i + c * 2]);
+					Add(rva + static_cast<DWORD>(i), std::move(text));
+				}
+				i = end + 2;
+			}
+		}
+	};
+}
+
+mem::StringReferences::StringReferences(const PEView& image, const size_t minLength)
+{
+	if (!image.IsValid()) return;
+
+	const StringTable strings(image, minLength);
+	if (strings.Empty()) return;
+
+	const ULONGLONG imageBase = image.ImageBase();
+	for (const auto& section : image.Sections())
+	{
+		if (!SectionFilter::Code.Matches(section.Characteristics)) continue;
+
+		// p points at the 32-bit operand, the opcode bytes before it are checked first so the string lookup only runs on candidates
+		const auto code = image.SectionData(section);
+		for (size_t i = 3; i + sizeof(DWORD) <= code.size(); i++)
+		{
+			const BYTE* p = code.data() + i;
+			const DWORD operandRva = section.VirtualAddress + static_cast<DWORD>(i);
+
+			const BYTE* pInstruction = nullptr;
+			DWORD target = 0;
+			if (image.Is64())
+			{
+				// [REX] 8D/8B modrm(mod 00, rm 101) disp32: lea/mov reg, [rip + disp32]
+				if ((p[-1] & 0xC7) != 0x05 || (p[-2] != 0x8D && p[-2] != 0x8B)) continue;
+
+				pInstruction = (p[-3] & 0xF0) == 0x40 ? p - 3 : p - 2;
+				target = operandRva + sizeof(DWORD) + ReadDword(p);
+			}
+			else
+			{
+				// 68 imm32: push imm32, B8+r imm32: mov reg, imm32
+				if (p[-1] != 0x68 && (p[-1] & 0xF8) != 0xB8) continue;
+
+				pInstruction = p - 1;
+				target = static_cast<DWORD>(ReadDword(p) - imageBase);
+			}
+
+			if (const std::string* pString = strings.Find(target))
+			{
+				references[*pString].push_back(pInstruction);
+			}
+		}
+	}
+}
+
+mem::StringReferences::StringReferences(const HMODULE hModule, const size_t minLength): StringReferences(PEView(hModule), minLength) {}
+
+std::span<const BYTE* const> mem::StringReferences::Find(const std::string_view text) const
+{
+	const auto it = references.find(text);
+	if (it == references.end()) return {};
+	return it->second;
+}
+
+const BYTE* mem::StringReferences::FindFirst(const std::string_view text) const
+{
+	const auto matches = Find(text);
+	return matches.empty() ? nullptr : matches.front();
+}
@@ -0,0 +1,39 @@
+﻿#pragma once
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <windows.h>
+
+#include "pe.h"
+
+namespace mem
+{
+	// Index from the strings of an image read-only data to the instructions referencing them.
+	// Printable ASCII and UTF-16 strings (NUL terminated, at least minLength characters) are collected from the read-only data sections,
+	// then the code sections are scanned once for RIP-relative lea/mov (x64) and push/mov imm32 (x86) pointing at their first character.
+	// Works on mapped modules and on raw files (ImageLayout::File), the returned addresses are inside the view.
+	class StringReferences
+	{
+	public:
+		explicit StringReferences(const PEView& image, size_t minLength = 4);
+		explicit StringReferences(HMODULE hModule, size_t minLength = 4);
+
+		// Instructions referencing the string (UTF-16 strings are looked up by their ASCII text), in address order
+		[[nodiscard]] std::span<const BYTE* const> Find(std::string_view text) const;
+		// First of them, nullptr when the string isn't referenced
+		[[nodiscard]] const BYTE* FindFirst(std::string_view text) const;
+
+		[[nodiscard]] size_t Size() const noexcept { return references.size(); }
+
+	private:
+		struct StringHash
+		{
+			using is_transparent = void;
+			size_t operator()(const std::string_view text) const noexcept { return std::hash<std::string_view>{}(text); }
+		};
+
+		std::unordered_map<std::string, std::vector<const BYTE*>, StringHash, std::equal_to<>> references;
+	};
+}
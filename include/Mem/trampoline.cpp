@@ -0,0 +1,219 @@
+﻿#include "trampoline.h"
+
+#include <algorithm>
+#include <windows.h>
+
+namespace
+{
+	using FreeMap = std::map<std::uintptr_t, std::uintptr_t>;
+
+	struct AddressSpace
+	{
+		std::uintptr_t minimum;
+		std::uintptr_t maximum;
+		std::uintptr_t granularity;
+	};
+
+	const AddressSpace& GetAddressSpace()
+	{
+		static const AddressSpace space = []
+		{
+			SYSTEM_INFO sysInfo;
+			GetSystemInfo(&sysInfo);
+			return AddressSpace{ reinterpret_cast<std::uintptr_t>(sysInfo.lpMinimumApplicationAddress), reinterpret_cast<std::uintptr_t>(sysInfo.lpMaximumApplicationAddress), sysInfo.dwAllocationGranularity };
+		}();
+		return space;
+	}
+
+	// Adds [begin, end), merged with the ranges it touches
+	void AddFree(FreeMap& freeSpace, const std::uintptr_t begin, std::uintptr_t end)
+	{
+		if (const auto next = freeSpace.find(end); next != freeSpace.end())
+		{
+			end = next->second;
+			freeSpace.erase(next);
+		}
+		if (const auto it = freeSpace.lower_bound(begin); it != freeSpace.begin() && std::prev(it)->second == begin)
+		{
+			std::prev(it)->second = end;
+			return;
+		}
+		freeSpace.emplace(begin, end);
+	}
+
+	// Removes [begin, end), which lies inside one range
+	void RemoveFree(FreeMap& freeSpace, const std::uintptr_t begin, const std::uintptr_t end)
+	{
+		auto it = freeSpace.upper_bound(begin);
+		if (it == freeSpace.begin()) return;
+		const auto [first, last] = *--it;
+		freeSpace.erase(it);
+		if (first < begin) freeSpace.emplace(first, begin);
+		if (end < last) freeSpace.emplace(end, last);
+	}
+}
+
+mem::TrampolineArena& mem::TrampolineArena::Default()
+{
+	static TrampolineArena arena;
+	return arena;
+}
+
+void* mem::TrampolineArena::Allocate(const void* pNear, const size_t nSize)
+{
+	const size_t size = (std::max<size_t>(nSize, 1) + alignment - 1) & ~(alignment - 1);
+	if (size > blockSize) return nullptr;
+
+	const auto& space = GetAddressSpace();
+	const auto target = reinterpret_cast<std::uintptr_t>(pNear);
+	// Clamped to the address space, without wrapping around it (x86 code above 2 GB in large address aware processes)
+	const std::uintptr_t low = target > space.minimum + reach ? target - reach : space.minimum;
+	const std::uintptr_t high = target < space.maximum - reach ? target + reach : space.maximum;
+
+	std::scoped_lock lock(mutex);
+	for (auto it = blocks.lower_bound(low); it != blocks.end() && it->first + blockSize <= high; ++it)
+	{
+		if (void* p = AllocateFrom(it->first, it->second, size)) return p;
+	}
+
+	const std::uintptr_t base = ReserveNear(target, low, high);
+	if (!base) return nullptr;
+
+	Block& block = blocks[base];
+	block.freeList.emplace(0, blockSize);
+	return AllocateFrom(base, block, size);
+}
+
+bool mem::TrampolineArena::Free(void* pAddress)
+{
+	const auto address = reinterpret_cast<std::uintptr_t>(pAddress);
+
+	std::scoped_lock lock(mutex);
+	const auto allocation = allocations.find(address);
+	if (allocation == allocations.end()) return false;
+
+	const auto block = std::prev(blocks.upper_bound(address));
+	auto& freeList = block->second.freeList;
+	const size_t offset = address - block->first;
+	size_t size = allocation->second;
+	allocations.erase(allocation);
+
+	// Merged with the free neighbours
+	if (const auto next = freeList.find(offset + size); next != freeList.end())
+	{
+		size += next->second;
+		freeList.erase(next);
+	}
+	if (const auto it = freeList.lower_bound(offset); it != freeList.begin() && std::prev(it)->first + std::prev(it)->second == offset)
+	{
+		std::prev(it)->second += size;
+		return true;
+	}
+	freeList.emplace(offset, size);
+	return true;
+}
+
+mem::TrampolineArena::Stats mem::TrampolineArena::GetStats() const
+{
+	std::scoped_lock lock(mutex);
+	return { blocks.size(), allocations.size(), queries };
+}
+
+void* mem::TrampolineArena::AllocateFrom(const std::uintptr_t base, Block& block, const size_t nSize)
+{
+	const auto it = std::ranges::find_if(block.freeList, [nSize](const auto& range) { return range.second >= nSize; });
+	if (it == block.freeList.end()) return nullptr;
+
+	const auto [offset, size] = *it;
+	block.freeList.erase(it);
+	if (size > nSize) block.freeList.emplace(offset + nSize, size - nSize);
+	allocations.emplace(base + offset, nSize);
+	return reinterpret_cast<void*>(base + offset);
+}
+
+std::uintptr_t mem::TrampolineArena::ReserveNear(const std::uintptr_t target, const std::uintptr_t low, const std::uintptr_t high)
+{
+	const std::uintptr_t granularity = GetAddressSpace().granularity;
+	const std::uintptr_t alignedLow = (low + granularity - 1) & ~(granularity - 1);
+	const std::uintptr_t alignedHigh = high & ~(granularity - 1);
+
+	for (int attempt = 0; attempt < 2; attempt++)
+	{
+		MapFreeSpace(low & ~(granularity - 1), alignedHigh);
+
+		// Free block closest to the code
+		std::uintptr_t best = 0;
+		std::uintptr_t bestDistance = UINTPTR_MAX;
+		auto it = freeSpace.upper_bound(alignedLow);
+		if (it != freeSpace.begin()) --it;
+		for (; it != freeSpace.end() && it->first < alignedHigh; ++it)
+		{
+			const std::uintptr_t first = std::max(it->first, alignedLow);
+			const std::uintptr_t last = std::min(it->second, alignedHigh);
+			if (last < first || last - first < blockSize) continue;
+
+			const std::uintptr_t candidate = std::clamp(target & ~(granularity - 1), first, last - blockSize);
+			const std::uintptr_t distance = candidate > target ? candidate - target : target - candidate;
+			if (distance < bestDistance)
+			{
+				best = candidate;
+				bestDistance = distance;
+			}
+		}
+		if (!best) return 0;
+
+		if (VirtualAlloc(reinterpret_cast<LPVOID>(best), blockSize, MEM_RESERVE | MEM_COMMIT, PAGE_EXECUTE_READ))
+		{
+			RemoveFree(freeSpace, best, best + blockSize);
+			return best;
+		}
+
+		// Taken by someone else since the map was built, start over from a fresh one
+		freeSpace.clear();
+		mappedLow = mappedHigh = 0;
+	}
+	return 0;
+}
+
+void mem::TrampolineArena::MapFreeSpace(const std::uintptr_t low, const std::uintptr_t high)
+{
+	const auto walk = [this](std::uintptr_t address, const std::uintptr_t end)
+	{
+		const std::uintptr_t granularity = GetAddressSpace().granularity;
+		MEMORY_BASIC_INFORMATION mbi;
+		while (address < end && VirtualQuery(reinterpret_cast<LPCVOID>(address), &mbi, sizeof(mbi)))
+		{
+			queries++;
+			const auto regionBase = reinterpret_cast<std::uintptr_t>(mbi.BaseAddress);
+			const std::uintptr_t regionEnd = regionBase + mbi.RegionSize;
+			if (mbi.State == MEM_FREE)
+			{
+				// Allocations start on a granule boundary
+				const std::uintptr_t first = (std::max(regionBase, address) + granularity - 1) & ~(granularity - 1);
+				const std::uintptr_t last = std::min(regionEnd, end) & ~(granularity - 1);
+				if (first < last) AddFree(freeSpace, first, last);
+			}
+			if (regionEnd <= address) break;
+			address = regionEnd;
+		}
+	};
+
+	// Only the part not described yet, the map always covering one contiguous range
+	if (mappedLow == mappedHigh)
+	{
+		walk(low, high);
+		mappedLow = low;
+		mappedHigh = high;
+		return;
+	}
+	if (low < mappedLow)
+	{
+		walk(low, mappedLow);
+		mappedLow = low;
+	}
+	if (high > mappedHigh)
+	{
+		walk(mappedHigh, high);
+		mappedHigh = high;
+	}
+}
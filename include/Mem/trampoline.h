@@ -0,0 +1,53 @@
+﻿#pragma once
+#include <cstdint>
+#include <map>
+#include <mutex>
+
+namespace mem
+{
+	// Executable memory for hook detours, sub-allocated from 64 KiB blocks reserved within ±2 GB of the hooked code so a rel32 jmp
+	// reaches them from it and back. Free address space is found through a cached map (one VirtualQuery per region, refreshed only
+	// when a reservation fails) instead of probing page by page, and blocks are kept once reserved: a hundred hooks on a module cost
+	// one VirtualAlloc. Blocks are committed PAGE_EXECUTE_READ, writers make their own range writable while they fill it.
+	class TrampolineArena
+	{
+	public:
+		static constexpr size_t blockSize = 64 * 1024;		// Allocation granularity
+		static constexpr size_t alignment = 16;
+		static constexpr std::uintptr_t reach = 0x7FFF0000;	// Farthest block byte from the code, under the rel32 range
+
+		struct Stats
+		{
+			size_t blocks = 0;
+			size_t allocations = 0;	// Live trampolines
+			size_t queries = 0;		// VirtualQuery calls spent mapping free space
+		};
+
+		static TrampolineArena& Default();
+
+		// nSize bytes reachable with a rel32 from pNear, null when no address space is free within reach
+		void* Allocate(const void* pNear, size_t nSize);
+		// Gives the trampoline back to its block (the block stays reserved), false if it doesn't come from this arena
+		bool Free(void* pAddress);
+
+		[[nodiscard]] Stats GetStats() const;
+
+	private:
+		struct Block
+		{
+			std::map<size_t, size_t> freeList;	// Offset -> size, coalesced
+		};
+
+		mutable std::mutex mutex;
+		std::map<std::uintptr_t, Block> blocks;				// By base
+		std::map<std::uintptr_t, size_t> allocations;		// Trampoline -> size
+		std::map<std::uintptr_t, std::uintptr_t> freeSpace;	// Free address space, begin -> end, granule aligned
+		std::uintptr_t mappedLow = 0;						// Range described by freeSpace
+		std::uintptr_t mappedHigh = 0;
+		size_t queries = 0;
+
+		void* AllocateFrom(std::uintptr_t base, Block& block, size_t nSize);
+		std::uintptr_t ReserveNear(std::uintptr_t target, std::uintptr_t low, std::uintptr_t high);
+		void MapFreeSpace(std::uintptr_t low, std::uintptr_t high);
+	};
+}
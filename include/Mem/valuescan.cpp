@@ -0,0 +1,477 @@
+﻿#include "valuescan.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <thread>
+#include <emmintrin.h>
+
+#include "saferead.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+	using mem::ScanCompare;
+
+	constexpr size_t pageSize = 0x1000;
+	constexpr size_t chunkSize = 1024 * 1024;	// Bytes of memory per first scan task
+	constexpr size_t blockSize = 64 * 1024;		// Bytes read at once by the first scan
+	constexpr size_t pagesPerTask = 256;		// Candidate pages per next scan task
+
+	// SSE2 compares, every function returning a mask vector (all ones in matching lanes)
+	template<typename T>
+	struct Lanes;
+
+	template<>
+	struct Lanes<std::int8_t>
+	{
+		static constexpr unsigned count = 16;
+		static __m128i Set(const std::int8_t value) { return _mm_set1_epi8(value); }
+		static __m128i Load(const std::int8_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+		static __m128i Eq(const __m128i a, const __m128i b) { return _mm_cmpeq_epi8(a, b); }
+		static __m128i Same(const __m128i a, const __m128i b) { return Eq(a, b); }
+		static __m128i Gt(const __m128i a, const __m128i b) { return _mm_cmpgt_epi8(a, b); }
+		static __m128i InRange(const __m128i x, const __m128i lower, const __m128i upper) { return _mm_andnot_si128(_mm_or_si128(Gt(lower, x), Gt(x, upper)), _mm_set1_epi8(-1)); }
+		static unsigned Bits(const __m128i mask) { return static_cast<unsigned>(_mm_movemask_epi8(mask)); }
+	};
+
+	template<>
+	struct Lanes<std::int16_t>
+	{
+		static constexpr unsigned count = 8;
+		static __m128i Set(const std::int16_t value) { return _mm_set1_epi16(value); }
+		static __m128i Load(const std::int16_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+		static __m128i Eq(const __m128i a, const __m128i b) { return _mm_cmpeq_epi16(a, b); }
+		static __m128i Same(const __m128i a, const __m128i b) { return Eq(a, b); }
+		static __m128i Gt(const __m128i a, const __m128i b) { return _mm_cmpgt_epi16(a, b); }
+		static __m128i InRange(const __m128i x, const __m128i lower, const __m128i upper) { return _mm_andnot_si128(_mm_or_si128(Gt(lower, x), Gt(x, upper)), _mm_set1_epi8(-1)); }
+		static unsigned Bits(const __m128i mask) { return static_cast<unsigned>(_mm_movemask_epi8(_mm_packs_epi16(mask, _mm_setzero_si128()))); }
+	};
+
+	template<>
+	struct Lanes<std::int32_t>
+	{
+		static constexpr unsigned count = 4;
+		static __m128i Set(const std::int32_t value) { return _mm_set1_epi32(value); }
+		static __m128i Load(const std::int32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+		static __m128i Eq(const __m128i a, const __m128i b) { return _mm_cmpeq_epi32(a, b); }
+		static __m128i Same(const __m128i a, const __m128i b) { return Eq(a, b); }
+		static __m128i Gt(const __m128i a, const __m128i b) { return _mm_cmpgt_epi32(a, b); }
+		static __m128i InRange(const __m128i x, const __m128i lower, const __m128i upper) { return _mm_andnot_si128(_mm_or_si128(Gt(lower, x), Gt(x, upper)), _mm_set1_epi8(-1)); }
+		static unsigned Bits(const __m128i mask) { return static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(mask))); }
+	};
+
+	template<>
+	struct Lanes<std::int64_t>
+	{
+		static constexpr unsigned count = 2;
+		static __m128i Set(const std::int64_t value) { return _mm_set1_epi64x(value); }
+		static __m128i Load(const std::int64_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+		static __m128i Eq(const __m128i a, const __m128i b)
+		{
+			const __m128i halves = _mm_cmpeq_epi32(a, b);
+			return _mm_and_si128(halves, _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1)));
+		}
+		static __m128i Same(const __m128i a, const __m128i b) { return Eq(a, b); }
+		// No pcmpgtq before SSE4.2: signed compare of the high halves, and when they are equal the borrow of b - a
+		static __m128i Gt(const __m128i a, const __m128i b)
+		{
+			const __m128i result = _mm_or_si128(_mm_and_si128(_mm_cmpeq_epi32(a, b), _mm_sub_epi64(b, a)), _mm_cmpgt_epi32(a, b));
+			return _mm_shuffle_epi32(result, _MM_SHUFFLE(3, 3, 1, 1));
+		}
+		static __m128i InRange(const __m128i x, const __m128i lower, const __m128i upper) { return _mm_andnot_si128(_mm_or_si128(Gt(lower, x), Gt(x, upper)), _mm_set1_epi8(-1)); }
+		static unsigned Bits(const __m128i mask) { return static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(mask))); }
+	};
+
+	template<>
+	struct Lanes<float>
+	{
+		static constexpr unsigned count = 4;
+		static __m128 Set(const float value) { return _mm_set1_ps(value); }
+		static __m128 Load(const float* p) { return _mm_loadu_ps(p); }
+		static __m128 Eq(const __m128 a, const __m128 b) { return _mm_cmpeq_ps(a, b); }
+		// Bitwise, so a NaN that stays NaN is unchanged
+		static __m128 Same(const __m128 a, const __m128 b) { return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_castps_si128(a), _mm_castps_si128(b))); }
+		static __m128 Gt(const __m128 a, const __m128 b) { return _mm_cmpgt_ps(a, b); }
+		static __m128 InRange(const __m128 x, const __m128 lower, const __m128 upper) { return _mm_and_ps(_mm_cmpge_ps(x, lower), _mm_cmple_ps(x, upper)); }
+		static unsigned Bits(const __m128 mask) { return static_cast<unsigned>(_mm_movemask_ps(mask)); }
+	};
+
+	template<>
+	struct Lanes<double>
+	{
+		static constexpr unsigned count = 2;
+		static __m128d Set(const double value) { return _mm_set1_pd(value); }
+		static __m128d Load(const double* p) { return _mm_loadu_pd(p); }
+		static __m128d Eq(const __m128d a, const __m128d b) { return _mm_cmpeq_pd(a, b); }
+		static __m128d Same(const __m128d a, const __m128d b) { return _mm_castsi128_pd(Lanes<std::int64_t>::Eq(_mm_castpd_si128(a), _mm_castpd_si128(b))); }
+		static __m128d Gt(const __m128d a, const __m128d b) { return _mm_cmpgt_pd(a, b); }
+		static __m128d InRange(const __m128d x, const __m128d lower, const __m128d upper) { return _mm_and_pd(_mm_cmpge_pd(x, lower), _mm_cmple_pd(x, upper)); }
+		static unsigned Bits(const __m128d mask) { return static_cast<unsigned>(_mm_movemask_pd(mask)); }
+	};
+
+	template<typename T>
+	bool Same(const T a, const T b)
+	{
+		return std::memcmp(&a, &b, sizeof(T)) == 0;
+	}
+
+	// Sets bit i of pBits when element i matches (pBits holds n bits, cleared by the caller); pPrevious is null for a first scan
+	template<typename T, typename VectorMatch, typename ScalarMatch>
+	void MatchLoop(const T* pCurrent, const T* pPrevious, const size_t n, std::uint64_t* pBits, VectorMatch&& vector, ScalarMatch&& scalar)
+	{
+		using L = Lanes<T>;
+		size_t i = 0;
+		for (; i + L::count <= n; i += L::count)
+		{
+			// A block never straddles two words, 64 being a multiple of the lane count
+			const unsigned bits = pPrevious ? vector(L::Load(pCurrent + i), L::Load(pPrevious + i)) : vector(L::Load(pCurrent + i), L::Load(pCurrent + i));
+			pBits[i / 64] |= static_cast<std::uint64_t>(bits) << (i % 64);
+		}
+		for (; i < n; i++)
+		{
+			if (scalar(pCurrent[i], pPrevious ? pPrevious[i] : pCurrent[i])) pBits[i / 64] |= 1ull << (i % 64);
+		}
+	}
+
+	template<typename T>
+	void Match(const T* pCurrent, const T* pPrevious, const size_t n, const ScanCompare compare, const T value, const T upper, std::uint64_t* pBits)
+	{
+		using L = Lanes<T>;
+		const auto lanesValue = L::Set(value);
+		const auto lanesUpper = L::Set(upper);
+		constexpr unsigned allLanes = (1u << L::count) - 1;
+
+		switch (compare)
+		{
+		case ScanCompare::Exact:
+			MatchLoop(pCurrent, pPrevious, n, pBits, [&](auto current, auto) { return L::Bits(L::Eq(current, lanesValue)); }, [&](T current, T) { return current == value; });
+			break;
+		case ScanCompare::Range:
+			MatchLoop(pCurrent, pPrevious, n, pBits, [&](auto current, auto) { return L::Bits(L::InRange(current, lanesValue, lanesUpper)); }, [&](T current, T) { return value <= current && current <= upper; });
+			break;
+		case ScanCompare::Unknown:
+			MatchLoop(pCurrent, pPrevious, n, pBits, [&](auto, auto) { return allLanes; }, [](T, T) { return true; });
+			break;
+		case ScanCompare::Changed:
+			MatchLoop(pCurrent, pPrevious, n, pBits, [&](auto current, auto previous) { return L::Bits(L::Same(current, previous)) ^ allLanes; }, [](T current, T previous) { return !Same(current, previous); });
+			break;
+		case ScanCompare::Unchanged:
+			MatchLoop(pCurrent, pPrevious, n, pBits, [&](auto current, auto previous) { return L::Bits(L::Same(current, previous)); }, [](T current, T previous) { return Same(current, previous); });
+			break;
+		case ScanCompare::Increased:
+			MatchLoop(pCurrent, pPrevious, n, pBits, [&](auto current, auto previous) { return L::Bits(L::Gt(current, previous)); }, [](T current, T previous) { return current > previous; });
+			break;
+		case ScanCompare::Decreased:
+			MatchLoop(pCurrent, pPrevious, n, pBits, [&](auto current, auto previous) { return L::Bits(L::Gt(previous, current)); }, [](T current, T previous) { return current < previous; });
+			break;
+		}
+	}
+
+	// Calls fn.template operator()<T>() with the type behind the value type
+	template<typename Fn>
+	decltype(auto) Dispatch(const mem::ValueType type, Fn&& fn)
+	{
+		switch (type)
+		{
+		case mem::ValueType::Int8: return fn.template operator()<std::int8_t>();
+		case mem::ValueType::Int16: return fn.template operator()<std::int16_t>();
+		case mem::ValueType::Int32: return fn.template operator()<std::int32_t>();
+		case mem::ValueType::Int64: return fn.template operator()<std::int64_t>();
+		case mem::ValueType::Float: return fn.template operator()<float>();
+		default: return fn.template operator()<double>();
+		}
+	}
+
+	template<typename T>
+	T Convert(const mem::ScanValue& value)
+	{
+		if constexpr (std::is_floating_point_v<T>) return static_cast<T>(value.real);
+		else return static_cast<T>(value.integer);
+	}
+
+	// Exact matches all hold the searched value, except for floating-point zero (-0.0 matches 0.0 with other bits)
+	template<typename T>
+	bool IsUniform(const mem::ScanQuery& query)
+	{
+		return query.compare == ScanCompare::Exact && (!std::is_floating_point_v<T> || Convert<T>(query.value) != T{ 0 });
+	}
+
+	template<typename T>
+	constexpr size_t BitmapSize()
+	{
+		return pageSize / sizeof(T) / 8;
+	}
+
+	constexpr size_t AlignUp(const size_t value)
+	{
+		return (value + 7) & ~size_t{ 7 };
+	}
+
+	// Runs fn(task) for tasks [0, nTasks) on up to 8 threads (the caller included)
+	template<typename Fn>
+	void ParallelFor(const size_t nTasks, Fn&& fn)
+	{
+		const unsigned nThreads = static_cast<unsigned>(std::min<size_t>(std::clamp(std::thread::hardware_concurrency(), 1u, 8u), nTasks));
+		std::atomic<size_t> nextTask{ 0 };
+		const auto worker = [&]
+		{
+			for (size_t task = nextTask++; task < nTasks; task = nextTask++) fn(task);
+		};
+
+		std::vector<std::jthread> workers;
+		for (unsigned i = 1; i < nThreads; i++) workers.emplace_back(worker);
+		worker();
+	}
+}
+
+void* mem::detail::SystemAllocate(const size_t nSize) noexcept
+{
+#ifdef _WIN32
+	return VirtualAlloc(nullptr, nSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+	void* p = mmap(nullptr, nSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return p == MAP_FAILED ? nullptr : p;
+#endif
+}
+
+void mem::detail::SystemFree(void* pAddress, const size_t nSize) noexcept
+{
+#ifdef _WIN32
+	(void)nSize;
+	VirtualFree(pAddress, 0, MEM_RELEASE);
+#else
+	munmap(pAddress, nSize);
+#endif
+}
+
+namespace
+{
+	using mem::detail::CandidatePage;
+	using mem::detail::SystemVector;
+
+	// Candidates of a range of pages, merged in address order once every task is done
+	struct Output
+	{
+		SystemVector<CandidatePage> pages;
+		SystemVector<std::uint8_t> data;
+		size_t count = 0;
+	};
+
+	// Appends a page with the selected candidates: bit i of pBits selects position pPositions[i] (i without positions) holding pValues[i],
+	// values not stored when pValues is null
+	template<typename T>
+	void Emit(Output& output, const std::uintptr_t page, const std::uint64_t* pBits, const size_t n, const std::uint16_t* pPositions, const T* pValues)
+	{
+		const size_t nWords = (n + 63) / 64;
+		size_t count = 0;
+		for (size_t w = 0; w < nWords; w++) count += static_cast<size_t>(std::popcount(pBits[w]));
+		if (!count) return;
+
+		const bool bBitmap = count * sizeof(std::uint16_t) >= BitmapSize<T>();
+		const size_t offset = output.data.size();
+		const size_t valuesOffset = AlignUp(offset + (bBitmap ? BitmapSize<T>() : count * sizeof(std::uint16_t)));
+		output.data.resize(pValues ? valuesOffset + AlignUp(count * sizeof(T)) : valuesOffset);
+		output.pages.push_back({ page, offset, static_cast<std::uint16_t>(count), bBitmap });
+		output.count += count;
+
+		std::uint8_t* pPositionData = output.data.data() + offset;
+		T* pOut = reinterpret_cast<T*>(output.data.data() + valuesOffset);
+		size_t j = 0;
+		for (size_t w = 0; w < nWords; w++)
+		{
+			for (std::uint64_t bits = pBits[w]; bits; bits &= bits - 1)
+			{
+				const size_t i = w * 64 + static_cast<size_t>(std::countr_zero(bits));
+				const std::uint16_t position = pPositions ? pPositions[i] : static_cast<std::uint16_t>(i);
+				if (bBitmap) pPositionData[position / 8] |= static_cast<std::uint8_t>(1 << (position % 8));
+				else std::memcpy(pPositionData + j * sizeof(std::uint16_t), &position, sizeof(std::uint16_t));
+				if (pValues) pOut[j] = pValues[i];
+				j++;
+			}
+		}
+	}
+
+	// Fills the positions of the candidates of a page and returns their values (null when they weren't stored)
+	template<typename T>
+	const T* Decode(const CandidatePage& page, const std::uint8_t* pData, std::uint16_t* pPositions, const bool bValues)
+	{
+		const std::uint8_t* pPositionData = pData + page.offset;
+		if (!page.bBitmap)
+		{
+			std::memcpy(pPositions, pPositionData, page.count * sizeof(std::uint16_t));
+			return bValues ? reinterpret_cast<const T*>(pData + AlignUp(page.offset + page.count * sizeof(std::uint16_t))) : nullptr;
+		}
+
+		size_t j = 0;
+		for (size_t w = 0; w < BitmapSize<T>() / 8; w++)
+		{
+			std::uint64_t bits;
+			std::memcpy(&bits, pPositionData + w * 8, 8);
+			for (; bits; bits &= bits - 1) pPositions[j++] = static_cast<std::uint16_t>(w * 64 + static_cast<size_t>(std::countr_zero(bits)));
+		}
+		return bValues ? reinterpret_cast<const T*>(pData + AlignUp(page.offset + BitmapSize<T>())) : nullptr;
+	}
+
+	// Concatenates the task outputs, releasing each once copied; returns the number of candidates
+	size_t Merge(std::vector<Output>& outputs, SystemVector<CandidatePage>& pages, SystemVector<std::uint8_t>& data)
+	{
+		size_t nPages = 0, nData = 0, count = 0;
+		for (const auto& output : outputs)
+		{
+			nPages += output.pages.size();
+			nData += output.data.size();
+		}
+		pages.reserve(nPages);
+		data.reserve(nData);
+
+		for (auto& output : outputs)
+		{
+			const size_t base = data.size();
+			for (CandidatePage page : output.pages)
+			{
+				page.offset += base;
+				pages.push_back(page);
+			}
+			data.insert(data.end(), output.data.begin(), output.data.end());
+			count += output.count;
+			output = {};
+		}
+		return count;
+	}
+}
+
+size_t mem::ValueScanner::FirstScan(const ScanQuery& query)
+{
+	Reset();
+	if (query.compare != ScanCompare::Exact && query.compare != ScanCompare::Range && query.compare != ScanCompare::Unknown) return 0;
+	type = query.type;
+	bScanned = true;
+
+	regions.Invalidate();
+	const auto snapshot = regions.Snapshot();
+	std::vector<std::pair<std::uintptr_t, size_t>> chunks;
+	for (const auto& region : *snapshot)
+	{
+		if (!HasAccess(region.access, RegionAccess::Read | RegionAccess::Write)) continue;
+		for (std::uintptr_t chunk = region.base; chunk < region.End(); chunk += chunkSize) chunks.emplace_back(chunk, std::min<size_t>(chunkSize, region.End() - chunk));
+	}
+
+	std::vector<Output> outputs(chunks.size());
+	Dispatch(type, [&]<typename T>()
+	{
+		const T value = Convert<T>(query.value);
+		const T upper = Convert<T>(query.upper);
+		bValues = !IsUniform<T>(query);
+		exactValue = ScanValue(value);
+		ParallelFor(chunks.size(), [&](const size_t task)
+		{
+			const auto [address, nChunk] = chunks[task];
+			SystemVector<std::uint8_t> block(blockSize);
+			for (size_t offset = 0; offset < nChunk; offset += blockSize)
+			{
+				// Through the system: memory freed meanwhile fails the read instead of faulting, page by page when the block fails
+				const size_t nBytes = std::min(blockSize, nChunk - offset);
+				const bool bBlock = detail::SystemRead(address + offset, block.data(), nBytes);
+				for (size_t page = 0; page + pageSize <= nBytes; page += pageSize)
+				{
+					if (!bBlock && !detail::SystemRead(address + offset + page, block.data() + page, pageSize)) continue;
+
+					std::uint64_t bits[pageSize / 64]{};
+					const T* pValues = reinterpret_cast<const T*>(block.data() + page);
+					Match(pValues, static_cast<const T*>(nullptr), pageSize / sizeof(T), query.compare, value, upper, bits);
+					Emit(outputs[task], address + offset + page, bits, pageSize / sizeof(T), nullptr, bValues ? pValues : nullptr);
+				}
+			}
+		});
+	});
+
+	count = Merge(outputs, pages, data);
+	return count;
+}
+
+size_t mem::ValueScanner::NextScan(const ScanQuery& query)
+{
+	if (!bScanned) return 0;
+
+	const size_t nTasks = (pages.size() + pagesPerTask - 1) / pagesPerTask;
+	std::vector<Output> outputs(nTasks);
+	Dispatch(type, [&]<typename T>()
+	{
+		const T value = Convert<T>(query.value);
+		const T upper = Convert<T>(query.upper);
+		const T previousExact = Convert<T>(exactValue);
+		const bool bStore = !IsUniform<T>(query);
+		ParallelFor(nTasks, [&](const size_t task)
+		{
+			SystemVector<std::uint8_t> page(pageSize);
+			std::uint16_t positions[pageSize / sizeof(T)];
+			T current[pageSize / sizeof(T)];
+			T previous[pageSize / sizeof(T)];
+			std::uint64_t bits[pageSize / sizeof(T) / 64 + 1];
+
+			for (size_t i = task * pagesPerTask; i < std::min(pages.size(), (task + 1) * pagesPerTask); i++)
+			{
+				const CandidatePage& entry = pages[i];
+				if (!detail::SystemRead(entry.page, page.data(), pageSize)) continue;
+
+				const T* pPrevious = Decode<T>(entry, data.data(), positions, bValues);
+				if (!pPrevious) pPrevious = std::fill_n(previous, entry.count, previousExact) - entry.count;
+				const T* pPage = reinterpret_cast<const T*>(page.data());
+				for (size_t j = 0; j < entry.count; j++) current[j] = pPage[positions[j]];
+
+				std::fill_n(bits, (entry.count + 63) / 64, 0);
+				Match(current, pPrevious, entry.count, query.compare, value, upper, bits);
+				Emit(outputs[task], entry.page, bits, entry.count, positions, bStore ? current : nullptr);
+			}
+		});
+		bValues = bStore;
+		exactValue = ScanValue(value);
+	});
+
+	pages = {};
+	data = {};
+	count = Merge(outputs, pages, data);
+	return count;
+}
+
+void mem::ValueScanner::Reset()
+{
+	pages = {};
+	data = {};
+	count = 0;
+	bScanned = false;
+	bValues = true;
+}
+
+size_t mem::ValueScanner::MemoryUsage() const noexcept
+{
+	return pages.capacity() * sizeof(detail::CandidatePage) + data.capacity();
+}
+
+std::vector<mem::ScanResult> mem::ValueScanner::Results(const size_t maxResults) const
+{
+	std::vector<ScanResult> results;
+	if (!bScanned) return results;
+
+	Dispatch(type, [&]<typename T>()
+	{
+		std::uint16_t positions[pageSize / sizeof(T)];
+		for (const auto& entry : pages)
+		{
+			const T* pValues = Decode<T>(entry, data.data(), positions, bValues);
+			for (size_t j = 0; j < entry.count; j++)
+			{
+				if (results.size() >= maxResults) return;
+				results.push_back({ entry.page + positions[j] * sizeof(T), pValues ? ScanValue(pValues[j]) : exactValue });
+			}
+		}
+	});
+	return results;
+}
@@ -0,0 +1,147 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "region.h"
+
+namespace mem
+{
+	enum class ValueType : std::uint8_t
+	{
+		Int8,
+		Int16,
+		Int32,
+		Int64,
+		Float,
+		Double
+	};
+
+	enum class ScanCompare : std::uint8_t
+	{
+		Exact,
+		Range,		///< value <= x <= upper.
+		Unknown,	///< Every value, first scan only.
+		Changed,	///< Compared with the value of the previous scan, next scans only.
+		Unchanged,
+		Increased,
+		Decreased
+	};
+
+	// Value to compare with, held as both an integer and a floating-point number so 64-bit integers stay exact
+	struct ScanValue
+	{
+		std::int64_t integer = 0;
+		double real = 0.0;
+
+		ScanValue() = default;
+
+		template<typename T> requires std::is_arithmetic_v<T>
+		ScanValue(const T value) : integer(static_cast<std::int64_t>(value)), real(static_cast<double>(value)) {}
+	};
+
+	struct ScanQuery
+	{
+		ValueType type = ValueType::Int32;	// Ignored by next scans, fixed by the first scan
+		ScanCompare compare = ScanCompare::Exact;
+		ScanValue value;
+		ScanValue upper;					// Range only
+	};
+
+	struct ScanResult
+	{
+		std::uintptr_t address;
+		ScanValue value;	// Value at the last scan
+	};
+
+	namespace detail
+	{
+		void* SystemAllocate(size_t nSize) noexcept;
+		void SystemFree(void* pAddress, size_t nSize) noexcept;
+
+		// Memory straight from the system: every buffer gets its own mapping, created after the region snapshot of a scan
+		// and released when freed, so the scanner never finds its own copies of the values it looks for
+		template<typename T>
+		struct SystemAllocator
+		{
+			using value_type = T;
+
+			SystemAllocator() = default;
+			template<typename U>
+			SystemAllocator(const SystemAllocator<U>&) noexcept {}
+
+			T* allocate(const size_t n)
+			{
+				void* p = SystemAllocate(n * sizeof(T));
+				if (!p) throw std::bad_alloc();
+				return static_cast<T*>(p);
+			}
+
+			void deallocate(T* p, const size_t n) noexcept { SystemFree(p, n * sizeof(T)); }
+
+			template<typename U>
+			bool operator==(const SystemAllocator<U>&) const noexcept { return true; }
+		};
+
+		template<typename T>
+		using SystemVector = std::vector<T, SystemAllocator<T>>;
+
+		struct CandidatePage
+		{
+			std::uintptr_t page;
+			size_t offset;			// Into the candidate data: positions (bitmap or list), then the values, 8-byte aligned
+			std::uint16_t count;
+			bool bBitmap;
+		};
+	}
+
+	// Cheat Engine style value search inside the process.
+	// The first scan compares every aligned value of the writable regions with SIMD, next scans re-read only the pages still holding candidates.
+	// Candidates are kept per 4 KiB page, as a bitmap or as a list of in-page positions, whichever is smaller, followed by their values
+	// at the last scan (used by the relative compares): about sizeof(type) + 1/8 bytes per candidate for dense pages. After an Exact scan
+	// every candidate holds the searched value, which is stored once instead, leaving about 1/8 byte per dense candidate. Other compares
+	// keep the values: 100M candidates of an Unknown or Range scan on 8-byte values take about 800 MB.
+	// Memory is read through ReadProcessMemory / process_vm_readv, pages freed meanwhile are dropped instead of faulting.
+	class ValueScanner
+	{
+	public:
+		explicit ValueScanner(RegionProvider& regions = RegionProvider::Default()) : regions(regions) {}
+
+		// New search over the readable and writable regions, returns the number of candidates
+		size_t FirstScan(const ScanQuery& query);
+		// Filters the candidates of the previous scan, returns the number left
+		size_t NextScan(const ScanQuery& query);
+		void Reset();
+
+		[[nodiscard]] bool HasScanned() const noexcept { return bScanned; }
+		[[nodiscard]] ValueType Type() const noexcept { return type; }
+		[[nodiscard]] size_t Count() const noexcept { return count; }
+		// Bytes held by the candidate set
+		[[nodiscard]] size_t MemoryUsage() const noexcept;
+		// The first maxResults candidates, by address
+		[[nodiscard]] std::vector<ScanResult> Results(size_t maxResults = 1000) const;
+
+	private:
+		RegionProvider& regions;
+		ValueType type = ValueType::Int32;
+		bool bScanned = false;
+		bool bValues = true;	// False after an Exact scan, the candidates then all hold exactValue
+		ScanValue exactValue;
+		size_t count = 0;
+		detail::SystemVector<detail::CandidatePage> pages;
+		detail::SystemVector<std::uint8_t> data;
+	};
+
+	[[nodiscard]] constexpr size_t ValueSize(const ValueType type) noexcept
+	{
+		switch (type)
+		{
+		case ValueType::Int8: return 1;
+		case ValueType::Int16: return 2;
+		case ValueType::Int32: case ValueType::Float: return 4;
+		default: return 8;
+		}
+	}
+}
@@ -0,0 +1,243 @@
+﻿#include "x86.h"
+
+#include <array>
+
+namespace
+{
+	enum OperandFlags : BYTE
+	{
+		None = 0,
+		ModRM = 1 << 0,
+		Imm8 = 1 << 1,
+		Imm16 = 1 << 2,
+		ImmZ = 1 << 3,		// 16 or 32 bits depending on the operand size
+		Rel8 = 1 << 4,
+		RelZ = 1 << 5,
+		Invalid64 = 1 << 6,	// Not encodable in 64-bit mode
+		Invalid = 1 << 7
+	};
+
+	constexpr auto oneByteMap = []
+	{
+		std::array<BYTE, 256> map{};
+
+		// ALU blocks: op r/m,r | op r,r/m | op al,imm8 | op eax,immz
+		for (int base = 0x00; base < 0x40; base += 0x08)
+		{
+			for (int i = 0; i < 4; i++) map[base + i] = ModRM;
+			map[base + 4] = Imm8;
+			map[base + 5] = ImmZ;
+		}
+		for (const int opcode : { 0x06, 0x07, 0x0E, 0x16, 0x17, 0x1E, 0x1F, 0x27, 0x2F, 0x37, 0x3F }) map[opcode] = Invalid64;
+		for (int i = 0x60; i <= 0x62; i++) map[i] = Invalid64;
+		map[0x62] |= ModRM;
+		map[0x63] = ModRM;
+		map[0x68] = ImmZ;
+		map[0x69] = ModRM | ImmZ;
+		map[0x6A] = Imm8;
+		map[0x6B] = ModRM | Imm8;
+		for (int i = 0x70; i <= 0x7F; i++) map[i] = Rel8;
+		map[0x80] = ModRM | Imm8;
+		map[0x81] = ModRM | ImmZ;
+		map[0x82] = ModRM | Imm8 | Invalid64;
+		map[0x83] = ModRM | Imm8;
+		for (int i = 0x84; i <= 0x8F; i++) map[i] = ModRM;
+		map[0x9A] = ImmZ | Imm16 | Invalid64;	// call far ptr16:32
+		map[0xA8] = Imm8;
+		map[0xA9] = ImmZ;
+		for (int i = 0xB0; i <= 0xB7; i++) map[i] = Imm8;
+		for (int i = 0xB8; i <= 0xBF; i++) map[i] = ImmZ;	// imm64 with REX.W
+		map[0xC0] = map[0xC1] = ModRM | Imm8;
+		map[0xC2] = Imm16;
+		map[0xC4] = map[0xC5] = ModRM | Invalid64;	// les/lds, VEX prefixes are handled before the table
+		map[0xC6] = ModRM | Imm8;
+		map[0xC7] = ModRM | ImmZ;
+		map[0xC8] = Imm16 | Imm8;
+		map[0xCA] = Imm16;
+		map[0xCD] = Imm8;
+		map[0xCE] = Invalid64;
+		map[0xD4] = map[0xD5] = Imm8 | Invalid64;
+		map[0xD6] = Invalid;
+		for (int i = 0xD0; i <= 0xD3; i++) map[i] = ModRM;
+		for (int i = 0xD8; i <= 0xDF; i++) map[i] = ModRM;
+		for (int i = 0xE0; i <= 0xE3; i++) map[i] = Rel8;
+		for (int i = 0xE4; i <= 0xE7; i++) map[i] = Imm8;
+		map[0xE8] = map[0xE9] = RelZ;
+		map[0xEA] = ImmZ | Imm16 | Invalid64;
+		map[0xEB] = Rel8;
+		map[0xF6] = map[0xF7] = ModRM;	// test r/m,imm depends on ModRM.reg
+		map[0xFE] = map[0xFF] = ModRM;
+		return map;
+	}();
+
+	constexpr auto twoByteMap = []
+	{
+		std::array<BYTE, 256> map{};
+		map.fill(ModRM);
+
+		for (const int opcode : { 0x04, 0x0A, 0x0C, 0x0F, 0x24, 0x25, 0x26, 0x27, 0x36, 0x39, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F, 0xA6, 0xA7 }) map[opcode] = Invalid;
+		for (const int opcode : { 0x05, 0x06, 0x07, 0x08, 0x09, 0x0B, 0x0E, 0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x37, 0x77, 0xA0, 0xA1, 0xA2, 0xA8, 0xA9, 0xAA }) map[opcode] = None;
+		for (int i = 0xC8; i <= 0xCF; i++) map[i] = None;	// bswap
+		for (int i = 0x80; i <= 0x8F; i++) map[i] = RelZ;	// jcc rel32
+		for (const int opcode : { 0x70, 0x71, 0x72, 0x73, 0xA4, 0xAC, 0xBA, 0xC2, 0xC4, 0xC5, 0xC6 }) map[opcode] = ModRM | Imm8;
+		map[0x0F] = ModRM | Imm8;	// 3DNow!, the suffix opcode is encoded as an imm8
+		return map;
+	}();
+
+	bool IsLegacyPrefix(const BYTE value)
+	{
+		switch (value)
+		{
+		case 0x26: case 0x2E: case 0x36: case 0x3E: case 0x64: case 0x65:
+		case 0x66: case 0x67: case 0xF0: case 0xF2: case 0xF3:
+			return true;
+		default:
+			return false;
+		}
+	}
+}
+
+bool mem::x86::Decode(const BYTE* pCode, const size_t nSize, const bool bIs64, Instruction& instruction)
+{
+	instruction = {};
+	const size_t nLimit = nSize < maxInstructionLength ? nSize : maxInstructionLength;
+
+	size_t i = 0;
+	bool bOperandSize16 = false, bAddressSize = false, bRexW = false;
+	while (i < nLimit && IsLegacyPrefix(pCode[i]))
+	{
+		if (pCode[i] == 0x66) bOperandSize16 = true;
+		if (pCode[i] == 0x67) bAddressSize = true;
+		i++;
+	}
+	if (bIs64 && i < nLimit && (pCode[i] & 0xF0) == 0x40)
+	{
+		bRexW = pCode[i] & 0x08;
+		i++;
+	}
+	if (i >= nLimit) return false;
+
+	// Opcode map (0 = one byte, 1 = 0F, 2 = 0F 38, 3 = 0F 3A) and operands of the opcode
+	int map = 0;
+	BYTE flags;
+	const BYTE lead = pCode[i];
+	const bool bVexLike = (lead == 0xC4 || lead == 0xC5 || lead == 0x62) && i + 1 < nLimit && (bIs64 || (pCode[i + 1] & 0xC0) == 0xC0);
+	if (bVexLike)
+	{
+		// VEX (C5 xx / C4 xx xx) and EVEX (62 xx xx xx): the operand size prefix is implied and immediates are at most imm8
+		const size_t prefixSize = lead == 0xC5 ? 2 : lead == 0xC4 ? 3 : 4;
+		if (i + prefixSize >= nLimit) return false;
+
+		map = lead == 0xC5 ? 1 : pCode[i + 1] & (lead == 0xC4 ? 0x1F : 0x03);
+		if (map < 1 || map > 3) return false;
+
+		i += prefixSize;
+		const BYTE opcode = pCode[i];
+		flags = ModRM;
+		if (map == 3 || (map == 1 && (twoByteMap[opcode] & Imm8))) flags |= Imm8;
+		if (map == 1 && opcode == 0x77) flags = None;	// vzeroupper/vzeroall
+	}
+	else if (lead == 0x0F)
+	{
+		if (++i >= nLimit) return false;
+		if (pCode[i] == 0x38 || pCode[i] == 0x3A)
+		{
+			map = pCode[i] == 0x38 ? 2 : 3;
+			if (++i >= nLimit) return false;
+			flags = map == 3 ? ModRM | Imm8 : ModRM;
+		}
+		else
+		{
+			map = 1;
+			flags = twoByteMap[pCode[i]];
+		}
+	}
+	else
+	{
+		flags = oneByteMap[lead];
+	}
+
+	if (flags & Invalid || (bIs64 && flags & Invalid64)) return false;
+	instruction.opcodeOffset = static_cast<BYTE>(i);
+	const BYTE opcode = pCode[i++];
+
+	if (flags & ModRM)
+	{
+		if (i >= nLimit) return false;
+		const BYTE modrm = pCode[i++];
+		const BYTE mod = modrm >> 6;
+		const BYTE rm = modrm & 7;
+
+		if (map == 0 && (opcode == 0xF6 || opcode == 0xF7) && (modrm >> 3 & 7) < 2)
+		{
+			flags |= opcode == 0xF6 ? Imm8 : ImmZ;
+		}
+
+		if (mod != 3)
+		{
+			BYTE dispSize = mod == 1 ? 1 : 0;
+			if (!bIs64 && bAddressSize)
+			{
+				// 16-bit addressing, no SIB
+				if (mod == 2 || (mod == 0 && rm == 6)) dispSize = 2;
+			}
+			else
+			{
+				bool bNoBase = mod == 0 && rm == 5;
+				if (rm == 4)
+				{
+					if (i >= nLimit) return false;
+					const BYTE sib = pCode[i++];
+					bNoBase = mod == 0 && (sib & 7) == 5;
+				}
+				if (mod == 2 || bNoBase) dispSize = 4;
+
+				if (mod == 0 && rm == 5)
+				{
+					instruction.bRipRelative = bIs64;
+					instruction.bAbsoluteMemory = !bIs64;
+				}
+				else if (bNoBase && !bIs64)
+				{
+					instruction.bAbsoluteMemory = true;	// [index*scale + disp32]
+				}
+			}
+
+			if (dispSize)
+			{
+				instruction.dispOffset = static_cast<BYTE>(i);
+				instruction.dispSize = dispSize;
+				i += dispSize;
+			}
+		}
+	}
+	else if (map == 0 && opcode >= 0xA0 && opcode <= 0xA3)
+	{
+		// mov al/eax, moffs
+		instruction.dispOffset = static_cast<BYTE>(i);
+		instruction.dispSize = bIs64 ? (bAddressSize ? 4 : 8) : (bAddressSize ? 2 : 4);
+		instruction.bAbsoluteMemory = true;
+		i += instruction.dispSize;
+	}
+
+	BYTE immSize = 0;
+	if (flags & (Imm8 | Rel8)) immSize += 1;
+	if (flags & Imm16) immSize += 2;
+	if (flags & (ImmZ | RelZ))
+	{
+		if (map == 0 && opcode >= 0xB8 && opcode <= 0xBF && bRexW) immSize += 8;
+		else if (flags & RelZ && bIs64) immSize += 4;	// Operand size prefix is ignored for near branches in 64-bit mode
+		else immSize += bOperandSize16 ? 2 : 4;
+	}
+	if (immSize)
+	{
+		instruction.immOffset = static_cast<BYTE>(i);
+		instruction.immSize = immSize;
+		instruction.bRelative = flags & (Rel8 | RelZ);
+		i += immSize;
+	}
+
+	if (i > nLimit) return false;
+	instruction.length = static_cast<BYTE>(i);
+	return true;
+}
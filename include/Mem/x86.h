@@ -0,0 +1,25 @@
+﻿#pragma once
+#include <windows.h>
+
+namespace mem::x86
+{
+	constexpr size_t maxInstructionLength = 15;
+
+	// Layout of a decoded instruction, offsets are relative to its first byte (0 = absent when the size is 0)
+	struct Instruction
+	{
+		BYTE length = 0;
+		BYTE opcodeOffset = 0;	// First opcode byte, after prefixes/REX/VEX/EVEX
+		BYTE dispOffset = 0;
+		BYTE dispSize = 0;
+		BYTE immOffset = 0;
+		BYTE immSize = 0;
+		bool bRipRelative = false;	// disp32 is relative to the next instruction (x64 [rip + disp32])
+		bool bRelative = false;		// Immediate is a branch displacement (jmp/call/jcc/loop)
+		bool bAbsoluteMemory = false;	// disp32 is an absolute address (x86 [disp32] or moffs)
+	};
+
+	// Length decoder for x86/x64 code (legacy, VEX and EVEX encodings), only the instruction layout is decoded.
+	// Returns false if the instruction is invalid for the mode or doesn't fit in nSize bytes.
+	bool Decode(const BYTE* pCode, size_t nSize, bool bIs64, Instruction& instruction);
+}
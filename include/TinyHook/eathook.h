@@ -4,6 +4,7 @@
 #include <windows.h>
 #include <cstdint>
 #include <utility>
+#include <vector>
 #include <ranges>
 
 namespace TinyHook
@@ -59,8 +60,11 @@ namespace TinyHook
             return true;
         }
 
-        void UnhookAll()
+        // Replacements stay registered (and exported) if the table can't be written back
+        std::expected<bool, Error> UnhookAll()
         {
+            mem::PatchTransaction transaction;
+            std::vector<void*> replacements;
             for (const auto& hookInfo : mOriginalOffsets | std::views::values)
             {
                 const auto [pRelativeOffset, originalValue] = hookInfo;
@@ -68,12 +72,18 @@ namespace TinyHook
 
                 if (currentOffset != originalValue)
                 {
-                    const auto currentFunction = reinterpret_cast<void*>(moduleBase + currentOffset);
-                    Manager::UnregisterHook(currentFunction);
-                    const auto result = Utils::Patch(pRelativeOffset, reinterpret_cast<void*>(originalValue));
+                    if (const auto result = Utils::Patch(transaction, pRelativeOffset, reinterpret_cast<void*>(originalValue)); !result)
+                    {
+                        return std::unexpected(result.error());
+                    }
+                    replacements.push_back(reinterpret_cast<void*>(moduleBase + currentOffset));
                 }
             }
+            if (!transaction.Commit()) return std::unexpected(Error::ProtectionError);
+
+            for (const auto replacement : replacements) Manager::UnregisterHook(replacement);
             mOriginalOffsets.clear();
+            return true;
         }
 
         [[nodiscard]] size_t GetHookCount() const noexcept
@@ -1,6 +1,7 @@
 ﻿#pragma once
 #include "shared.h"
 #include <ranges>
+#include <vector>
 
 namespace TinyHook
 {
@@ -40,6 +41,36 @@ namespace TinyHook
             return true;
         }
 
+        // Several imports in one patch transaction: nothing is hooked unless every function is found and the table could be written
+        std::expected<bool, Error> Hook(const std::initializer_list<std::pair<const char*, void*>> functions)
+        {
+            mem::PatchTransaction transaction;
+            std::vector<std::pair<uintptr_t*, void*>> slots;
+            for (const auto& [functionName, newFunction] : functions)
+            {
+                if (!functionName) return std::unexpected(Error::FunctionNotFound);
+                if (!newFunction) return std::unexpected(Error::InvalidDetour);
+
+                const auto found = FindIATFunction(functionName);
+                if (!found) return std::unexpected(found.error());
+
+                if (const auto result = Utils::Patch(transaction, found.value(), newFunction); !result)
+                {
+                    return std::unexpected(result.error());
+                }
+                slots.emplace_back(found.value(), newFunction);
+            }
+
+            // Read before the commit: the originals are what the table holds now
+            std::vector<uintptr_t> originals;
+            for (const auto& [pFunction, newFunction] : slots) originals.push_back(*pFunction);
+
+            if (!transaction.Commit()) return std::unexpected(Error::ProtectionError);
+
+            for (size_t i = 0; i < slots.size(); i++) Manager::RegisterHook(slots[i].second, originals[i]);
+            return true;
+        }
+
         std::expected<bool, Error> Unhook(const std::string_view functionName)
         {
             // Convert to string only for map lookup
@@ -58,19 +89,29 @@ namespace TinyHook
             mOriginalFunctions.erase(it);
             return true;
         }
-        void UnhookAll()
+        // Detours stay registered (and hooked) if the table can't be written back
+        std::expected<bool, Error> UnhookAll()
         {
+            mem::PatchTransaction transaction;
+            std::vector<uintptr_t> detours;
             for (const auto& hookInfo : mOriginalFunctions | std::views::values)
             {
                 const auto [pFunctionAddress, originalFunction] = hookInfo;
                 const auto currentFunction = *pFunctionAddress;
                 if (currentFunction != originalFunction)
                 {
-                    const auto result = Utils::Patch(pFunctionAddress, originalFunction);
-                    Manager::UnregisterHook(currentFunction);
+                    if (const auto result = Utils::Patch(transaction, pFunctionAddress, originalFunction); !result)
+                    {
+                        return std::unexpected(result.error());
+                    }
+                    detours.push_back(currentFunction);
                 }
             }
+            if (!transaction.Commit()) return std::unexpected(Error::ProtectionError);
+
+            for (const auto detour : detours) Manager::UnregisterHook(detour);
             mOriginalFunctions.clear();
+            return true;
         }
 
         [[nodiscard]] size_t GetHookCount() const noexcept
@@ -6,6 +6,7 @@
 #include <type_traits>
 #include <unordered_map>
 #include <windows.h>
+#include <Mem/patch.h>
 
 namespace TinyHook
 {
@@ -47,48 +48,27 @@ namespace TinyHook
 
 	namespace Utils
 	{
+		// Records the write in a transaction, to patch several slots with one protection change per run of pages
 		template<address T>
-		constexpr std::expected<void, Error> Patch(void* pAddress, T value)
+		std::expected<void, Error> Patch(mem::PatchTransaction& transaction, void* pAddress, T value)
 		{
 			if (!pAddress) return std::unexpected(Error::InvalidAddress);
 
-			MEMORY_BASIC_INFORMATION mbi;
-			if (!VirtualQuery(pAddress, &mbi, sizeof(mbi)))
-			{
-				return std::unexpected(Error::InvalidAddress);
-			}
-
-			DWORD oldProtection{ 0 };
-			bool bProtectionChanged{ false };
-
-			// Check if it's writable
-			if ((mbi.Protect & (PAGE_READWRITE | PAGE_EXECUTE_READWRITE | PAGE_WRITECOPY)) == 0)
-			{
-				// Change protection
-				if (!VirtualProtect(pAddress, sizeof(T), PAGE_EXECUTE_READWRITE, &oldProtection))
-				{
-					return std::unexpected(Error::ProtectionError);
-				}
-				bProtectionChanged = true;
-			}
-
-			// Change value
-			*static_cast<T*>(pAddress) = value;
-
-			// Restore original protection
-			if (bProtectionChanged)
-			{
-				if (!VirtualProtect(pAddress, sizeof(T), oldProtection, &oldProtection))
-				{
-					return std::unexpected(Error::ProtectionError);
-				}
-			}
+			transaction.Write(pAddress, value);
+			return {};
+		}
 
+		template<address T>
+		std::expected<void, Error> Patch(void* pAddress, T value)
+		{
+			mem::PatchTransaction transaction;
+			if (const auto result = Patch(transaction, pAddress, value); !result) return result;
+			if (!transaction.Commit()) return std::unexpected(Error::ProtectionError);
 			return {};
 		}
 
 		template<address T>
-		constexpr std::expected<void, Error> Patch(void** ppAddress, const size_t index, T value)
+		std::expected<void, Error> Patch(void** ppAddress, const size_t index, T value)
 		{
 			if (!ppAddress) return std::unexpected(Error::InvalidAddress);
 
@@ -1,5 +1,6 @@
 ﻿#pragma once
 #include <unordered_map>
+#include <vector>
 #include "shared.h"
 
 namespace TinyHook
@@ -32,6 +33,35 @@ namespace TinyHook
             return currentMethod;
         }
 
+        // Several methods in one patch transaction: nothing is hooked unless every index is valid and the table could be written
+        std::expected<bool, Error> Hook(const std::initializer_list<std::pair<uint32_t, void*>> methods)
+        {
+            mem::PatchTransaction transaction;
+            for (const auto& [index, newMethod] : methods)
+            {
+                if (!newMethod) return std::unexpected(Error::InvalidDetour);
+                if (index >= tableSize) return std::unexpected(Error::IndexOutOfBounds);
+                if (const auto result = Utils::Patch(transaction, &pVTable[index], newMethod); !result)
+                {
+                    return std::unexpected(result.error());
+                }
+            }
+
+            // Read before the commit: the originals are what the table holds now
+            std::vector<std::pair<uint32_t, void*>> currentMethods;
+            for (const auto& [index, newMethod] : methods) currentMethods.emplace_back(index, pVTable[index]);
+
+            if (!transaction.Commit()) return std::unexpected(Error::ProtectionError);
+
+            for (size_t i = 0; i < currentMethods.size(); i++)
+            {
+                const auto& [index, currentMethod] = currentMethods[i];
+                mOriginalMethods.try_emplace(index, currentMethod);
+                Manager::RegisterHook(std::data(methods)[i].second, currentMethod);
+            }
+            return true;
+        }
+
         constexpr std::expected<bool, Error> Unhook(const uint32_t index)
         {
             if (index >= tableSize) return std::unexpected(Error::IndexOutOfBounds);
@@ -49,17 +79,27 @@ namespace TinyHook
             return true;
         }
 
-        void UnhookAll()
+        // Detours stay registered (and hooked) if the table can't be written back
+        std::expected<bool, Error> UnhookAll()
         {
+            mem::PatchTransaction transaction;
+            std::vector<void*> detours;
             for (const auto& [index, originalMethod] : mOriginalMethods)
             {
                 if (const auto currentMethod = pVTable[index]; currentMethod != originalMethod)
                 {
-                    const auto result = Utils::Patch(pVTable, index, originalMethod);
-                    Manager::UnregisterHook(currentMethod);
+                    if (const auto result = Utils::Patch(transaction, &pVTable[index], originalMethod); !result)
+                    {
+                        return std::unexpected(result.error());
+                    }
+                    detours.push_back(currentMethod);
                 }
             }
+            if (!transaction.Commit()) return std::unexpected(Error::ProtectionError);
+
+            for (const auto detour : detours) Manager::UnregisterHook(detour);
             mOriginalMethods.clear();
+            return true;
         }
 
         [[nodiscard]] size_t GetHookCount() const noexcept
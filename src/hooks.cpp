@@ -1,6 +1,9 @@
 ﻿#include "hooks.h"
 
 #include "Mem/mem.h"
+#include "Mem/sigcache.h"
+#include "Mem/siggen.h"
+#include "signatures.h"
 
 namespace // Some utility functions
 {
@@ -58,7 +61,8 @@ namespace Hooks
 		HookType type;
 
 		const char* module = nullptr;
-		const char* pattern = nullptr;
+		mem::SignatureView pattern{};
+		mutable bool bScanned = false; // Already went through a batched scan
 
 		template<typename T>
 		HookEntry(void* address, T detour, const char* name, const HookType hookType) : address(address), detour(reinterpret_cast<void*>(detour)), name(name), type(hookType) {}
@@ -67,16 +71,16 @@ namespace Hooks
 		HookEntry(void* address, T detour, const HookType hookType) : HookEntry(address, detour, "Unknown", hookType) {}
 
 		template<typename T>
-		HookEntry(const char* moduleName, const char* pattern, T detour, const char* name, const HookType hookType) : detour(reinterpret_cast<void*>(detour)), name(name), type(hookType), module(moduleName), pattern(pattern) {}
+		HookEntry(const char* moduleName, const mem::SignatureView& pattern, T detour, const char* name, const HookType hookType) : detour(reinterpret_cast<void*>(detour)), name(name), type(hookType), module(moduleName), pattern(pattern) {}
 
 		template<typename T>
-		HookEntry(const char* moduleName, const char* pattern, T detour, const HookType hookType) : HookEntry(moduleName, pattern, detour, "Unknown", hookType) {}
+		HookEntry(const char* moduleName, const mem::SignatureView& pattern, T detour, const HookType hookType) : HookEntry(moduleName, pattern, detour, "Unknown", hookType) {}
 
 		template<typename T>
-		HookEntry(const char* pattern, T detour, const char* name, const HookType hookType) : HookEntry(static_cast<const char*>(nullptr), pattern, detour, name, hookType) {}
+		HookEntry(const mem::SignatureView& pattern, T detour, const char* name, const HookType hookType) : HookEntry(static_cast<const char*>(nullptr), pattern, detour, name, hookType) {}
 
 		template<typename T>
-		HookEntry(const char* pattern, T detour, const HookType hookType) : HookEntry(pattern, detour, "Unknown", hookType) {}
+		HookEntry(const mem::SignatureView& pattern, T detour, const HookType hookType) : HookEntry(pattern, detour, "Unknown", hookType) {}
 
 		std::expected<void*, TinyHook::Error> TryResolveAddress() const
 		{
@@ -85,11 +89,18 @@ namespace Hooks
 				const HMODULE hModule = TryGetModuleHandle(module);
 				if (!hModule) return std::unexpected(TinyHook::Error::InvalidModule);
 
-				address = mem::PatternScan(hModule, pattern);
+				if (!bScanned) SetMatch(mem::PatternScanCached(hModule, pattern)); // Precomputed RVA when the module build is known
 				if (!address) return std::unexpected(TinyHook::Error::InvalidAddress);
 			}
 			return address;
 		}
+
+		// Patterns with a capture ("E8 [call]") hook the address it references instead of the match
+		void SetMatch(const BYTE* pMatch) const
+		{
+			address = pattern.captureCount ? mem::ResolveCapture(pMatch, pattern) : const_cast<BYTE*>(pMatch);
+			bScanned = true;
+		}
 	};
 
 	static inline HookEntry List[]
@@ -106,29 +117,79 @@ namespace Hooks
 			HookType::Mid
 		},
 		{
-			"DEAD BEEF ?? BABE FACE", // Just a placeholder, will search for it in the executable module (e.g: game.exe)
+			Signatures::Game::example_mid, // Patterns live in signatures.h (parsed at compile time), will search for it in the executable module (e.g: game.exe)
 			Detours::ExampleMidDetour,
 			HookType::Mid
 		},
 		{
-			"module.dll", // Name of the module to search for the pattern
-			"DEAD C0DE ?? B01D FACE", // Will search for it in the specified module
+			Signatures::Game::example_module, // Name of the module to search for the pattern
+			Signatures::Game::example_module_mid, // Will search for it in the specified module
 			Detours::ExampleMidDetour,
 			HookType::Mid
 		},
 	};
 
+	// Resolves every pending pattern with a single pass per module
+	static void ResolvePatterns()
+	{
+		std::unordered_map<HMODULE, std::vector<const HookEntry*>> pending;
+		for (const auto& entry : Hooks::List)
+		{
+			if (entry.address || entry.pattern.empty()) continue;
+			if (const HMODULE hModule = TryGetModuleHandle(entry.module)) pending[hModule].push_back(&entry);
+		}
+
+		for (auto& [hModule, entries] : pending)
+		{
+			const mem::PEView image(hModule);
+			const std::string moduleName = mem::detail::GetModuleName(hModule);
+
+			// Entries already known for this module build skip the scan
+			std::erase_if(entries, [&](const HookEntry* entry)
+			{
+				const BYTE* pMatch = mem::signatureCache.Find(image, moduleName, entry->pattern);
+				if (pMatch) entry->SetMatch(pMatch);
+				return pMatch != nullptr;
+			});
+			if (entries.empty()) continue;
+
+			std::vector<mem::SignatureView> signatures;
+			signatures.reserve(entries.size());
+			for (const auto* entry : entries) signatures.push_back(entry->pattern);
+
+			const auto results = mem::PatternScanBatch(hModule, signatures);
+			for (size_t i = 0; i < entries.size(); i++)
+			{
+				entries[i]->SetMatch(results[i]);
+				mem::signatureCache.Store(image, moduleName, entries[i]->pattern, results[i]);
+			}
+		}
+	}
+
 	extern void SetupAllHooks()
 	{
 		LOG_NOTICE("Starting hooking procedures...");
+		ResolvePatterns();
 		for (auto& entry : Hooks::List)
 		{
-			if (!entry.address && entry.pattern)
+			if (!entry.address && !entry.pattern.empty())
 			{
 				if (auto result = entry.TryResolveAddress(); !result)
 				{
 					auto err = result.error();
 					LOG_ERROR("Pattern scan failed in module '{}' for '{}': {} (code: {}).", entry.module, entry.name, TinyHook::Utils::GetErrorMessage(err), static_cast<int>(err));
+#if LOGGING_ENABLED
+					// Likely broken by an update: report the closest match and a fresh signature for it, it is never hooked automatically
+					if (err == TinyHook::Error::InvalidAddress)
+					{
+						const HMODULE hModule = TryGetModuleHandle(entry.module);
+						if (const auto candidates = mem::PatternScanFuzzy(hModule, entry.pattern, 2, 1); !candidates.empty())
+						{
+							const auto& best = candidates.front();
+							LOG_WARNING("Closest match for '{}' at 0x{:X} ({} byte(s) differ), new signature: {}", entry.name, reinterpret_cast<uintptr_t>(best.address), best.mismatches, mem::GenerateSignature(hModule, best.address));
+						}
+					}
+#endif
 					continue;
 				}
 			}
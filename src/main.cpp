@@ -2,11 +2,15 @@
 #include <ScreenCleaner/ScreenCleaner.h>
 
 #include "hooks.h"
+#include "Mem/sigcache.h"
+#include "resolved_signatures.h"
 #include "misc/logger.h"
 #include "ui/overlay.h"
 
 namespace
 {
+	constexpr const char* signatureCachePath = "signatures.cache";
+
 	std::string_view stristr(std::string_view haystack, const std::string_view needle)
 	{
 		if (needle.empty()) return haystack;
@@ -115,6 +119,8 @@ namespace
 		{
 			LOG_CRITICAL("Couldn't hook game rendering.");
 		}
+
+		if (mem::signatureCache.IsDirty()) mem::signatureCache.Save(signatureCachePath);
 	}
 }
 
@@ -132,7 +138,10 @@ extern void MainThread()
 	SetupQuill("log.txt");
 #endif
 
+	mem::signatureCache.SetPrecomputed(Signatures::Resolved::modules);
+	if (!mem::signatureCache.Load(signatureCachePath)) LOG_INFO("No signature cache found, patterns will be scanned.");
 	Hooks::SetupAllHooks();
+	if (mem::signatureCache.IsDirty()) mem::signatureCache.Save(signatureCachePath);
 	ScreenCleaner::Init();
 	std::thread(HookRendering).detach();
 }
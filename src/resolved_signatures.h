@@ -0,0 +1,9 @@
+﻿#pragma once
+#include "Mem/sigcache.h"
+
+// Signature RVAs precomputed for known module builds, regenerate it with tools/sigresolve.cpp instead of editing it.
+// Entries are only used while the module fingerprint matches, patterns are scanned as usual otherwise.
+namespace Signatures::Resolved
+{
+	inline constexpr std::span<const mem::ResolvedModule> modules{};
+}
@@ -0,0 +1,74 @@
+﻿#pragma once
+#include "Mem/signature.h"
+
+// Every pattern of the project, kept in one place so tools/sigresolve.cpp can resolve them offline (see resolved_signatures.h)
+namespace Signatures
+{
+	namespace Game // Hooks::List
+	{
+		inline constexpr mem::Signature example_mid = "DEAD BEEF ?? BABE FACE"; // Just a placeholder (parsed at compile time), searched in the executable module (e.g: game.exe)
+		inline constexpr auto example_module = "module.dll";
+		inline constexpr mem::Signature example_module_mid = "DEAD C0DE ?? B01D FACE"; // Searched in example_module
+	}
+
+	namespace Steam
+	{
+		namespace x64
+		{
+			inline constexpr auto game_overlay_renderer = "GameOverlayRenderer64.dll";
+			inline constexpr auto steam_overlay_vulkan_layer = "SteamOverlayVulkanLayer64.dll";
+			inline constexpr mem::Signature d3d_present_pattern = "48 8B 05 [rel32] 44 8B C5 8B D6";
+			inline constexpr mem::Signature d3d9_present_pattern = "48 8B 05 [rel32] 4C 8B C5 49 8B D7";
+			inline constexpr mem::Signature d3d9_swapchain_present_pattern = "4C 8B 15 [rel32] 4C 8B C5";
+			inline constexpr mem::Signature opengl_swap_buffers_pattern = "48 8B 05 [rel32] 48 8B CB FF D0 80 3D";
+		}
+
+		namespace x86
+		{
+			inline constexpr auto game_overlay_renderer = "GameOverlayRenderer.dll";
+			inline constexpr auto steam_overlay_vulkan_layer = "SteamOverlayVulkanLayer.dll";
+			inline constexpr mem::Signature d3d_present_pattern = "A1 [abs32] 53 FF 75 ?? FF 75 ?? FF D0 8B 4D ?? 64 89 0D ?? ?? ?? ?? 5F 5E 5B 8B E5 5D C2 ?? ?? 68 ?? ?? ?? ?? C7 45 ?? ?? ?? ?? ?? FF 15 ?? ?? ?? ?? 8B 75";
+			inline constexpr mem::Signature d3d9_present_pattern = "A1 [abs32] 51 53 FF D0";
+			inline constexpr mem::Signature d3d9_swapchain_present_pattern = "A1 [abs32] 56 FF 75 ?? FF 75 ?? FF 75 ?? FF 75 ?? 57";
+			inline constexpr mem::Signature opengl_swap_buffers_pattern = "A1 [abs32] 56 FF D0 80 3D";
+		}
+	}
+
+	namespace Discord
+	{
+		inline constexpr auto discord_hook = "DiscordHook64.dll";
+		inline constexpr mem::Signature present_pattern = "55 41 ?? 41 ?? 56 57 53 48 83 EC ?? 48 8D ?? ?? ?? 44 89";
+		inline constexpr mem::Signature resize_buffers_pattern = "55 41 ?? 56 57 53 48 83 EC ?? 48 8D ?? ?? ?? 44 89 ?? 44 89 ?? 89 D3 49 89 ?? E8 ?? ?? ?? ?? 8B 4D";
+	}
+
+	enum class Arch : std::uint8_t
+	{
+		Any,
+		x86,
+		x64
+	};
+
+	struct Entry
+	{
+		const char* name;
+		const char* module;	// nullptr = executable module
+		mem::SignatureView signature;
+		Arch arch;
+	};
+
+	inline constexpr Entry List[]
+	{
+		{ "Game::example_mid", nullptr, Game::example_mid, Arch::Any },
+		{ "Game::example_module_mid", Game::example_module, Game::example_module_mid, Arch::Any },
+		{ "Steam::x64::d3d_present_pattern", Steam::x64::game_overlay_renderer, Steam::x64::d3d_present_pattern, Arch::x64 },
+		{ "Steam::x64::d3d9_present_pattern", Steam::x64::game_overlay_renderer, Steam::x64::d3d9_present_pattern, Arch::x64 },
+		{ "Steam::x64::d3d9_swapchain_present_pattern", Steam::x64::game_overlay_renderer, Steam::x64::d3d9_swapchain_present_pattern, Arch::x64 },
+		{ "Steam::x64::opengl_swap_buffers_pattern", Steam::x64::game_overlay_renderer, Steam::x64::opengl_swap_buffers_pattern, Arch::x64 },
+		{ "Steam::x86::d3d_present_pattern", Steam::x86::game_overlay_renderer, Steam::x86::d3d_present_pattern, Arch::x86 },
+		{ "Steam::x86::d3d9_present_pattern", Steam::x86::game_overlay_renderer, Steam::x86::d3d9_present_pattern, Arch::x86 },
+		{ "Steam::x86::d3d9_swapchain_present_pattern", Steam::x86::game_overlay_renderer, Steam::x86::d3d9_swapchain_present_pattern, Arch::x86 },
+		{ "Steam::x86::opengl_swap_buffers_pattern", Steam::x86::game_overlay_renderer, Steam::x86::opengl_swap_buffers_pattern, Arch::x86 },
+		{ "Discord::present_pattern", Discord::discord_hook, Discord::present_pattern, Arch::x64 },
+		{ "Discord::resize_buffers_pattern", Discord::discord_hook, Discord::resize_buffers_pattern, Arch::x64 },
+	};
+}
@@ -1,20 +1,23 @@
 ﻿#pragma once
 #include <windows.h>
-#include <Mem/mem.h>
+#include <Mem/sigcache.h>
 
 #include "../overlay.h"
+#include "../../signatures.h"
 
 namespace Overlay::Discord
 {
+	using namespace Signatures::Discord;
+
 	inline bool Hook()
 	{
-		if (const auto hModule = GetModuleHandleA("DiscordHook64.dll"))
+		if (const auto hModule = GetModuleHandleA(discord_hook))
 		{
 			if (Overlay::graphicsAPI == D3D11)
 			{
-				if (void* pPresent = mem::PatternScan(hModule, "55 41 ?? 41 ?? 56 57 53 48 83 EC ?? 48 8D ?? ?? ?? 44 89"))
+				if (void* pPresent = mem::PatternScanCached(hModule, present_pattern))
 				{
-					if (void* pResizeBuffers = mem::PatternScan(hModule, "55 41 ?? 56 57 53 48 83 EC ?? 48 8D ?? ?? ?? 44 89 ?? 44 89 ?? 89 D3 49 89 ?? E8 ?? ?? ?? ?? 8B 4D"))
+					if (void* pResizeBuffers = mem::PatternScanCached(hModule, resize_buffers_pattern))
 					{
 						LOG_NOTICE("Hooking Discord overlay...");
 						HooksManager::Create<InlineHook>(pPresent, PTR_AND_NAME(DirectX11::PresentHook));
@@ -3,7 +3,8 @@
 
 #include "Vulkan.h"
 #include "../overlay.h"
-#include "Mem/mem.h"
+#include "../../signatures.h"
+#include "Mem/sigcache.h"
 #include "TinyHook/tinyhook.h"
 
 namespace Overlay::Steam
@@ -24,30 +25,16 @@ namespace Overlay::Steam
 	}
 
 #ifdef _WIN64
-	constexpr auto game_overlay_renderer = "GameOverlayRenderer64.dll";
-	constexpr auto steam_overlay_vulkan_layer = "SteamOverlayVulkanLayer64.dll";
-	constexpr auto d3d_present_pattern = "48 8B 05 ?? ?? ?? ?? 44 8B C5 8B D6";
-	constexpr auto d3d9_present_pattern = "48 8B 05 ?? ?? ?? ?? 4C 8B C5 49 8B D7";
-	constexpr auto d3d9_swapchain_present_pattern = "4C 8B 15 ?? ?? ?? ?? 4C 8B C5";
-	constexpr auto opengl_swap_buffers_pattern = "48 8B 05 ?? ?? ?? ?? 48 8B CB FF D0 80 3D";
-
-	static uintptr_t* GetPointerFromRef(const uintptr_t instructionStart)
-	{
-		return reinterpret_cast<uintptr_t*>(instructionStart + 7 + *reinterpret_cast<int32_t*>(instructionStart + 3));
-	}
+	using namespace Signatures::Steam::x64;
 #else
-	constexpr auto game_overlay_renderer = "GameOverlayRenderer.dll";
-	constexpr auto steam_overlay_vulkan_layer = "SteamOverlayVulkanLayer.dll";
-	constexpr auto d3d_present_pattern = "A1 ?? ?? ?? ?? 53 FF 75 ?? FF 75 ?? FF D0 8B 4D ?? 64 89 0D ?? ?? ?? ?? 5F 5E 5B 8B E5 5D C2 ?? ?? 68 ?? ?? ?? ?? C7 45 ?? ?? ?? ?? ?? FF 15 ?? ?? ?? ?? 8B 75";
-	constexpr auto d3d9_present_pattern = "A1 ?? ?? ?? ?? 51 53 FF D0";
-	constexpr auto d3d9_swapchain_present_pattern = "A1 ?? ?? ?? ?? 56 FF 75 ?? FF 75 ?? FF 75 ?? FF 75 ?? 57";
-	constexpr auto opengl_swap_buffers_pattern = "A1 ?? ?? ?? ?? 56 FF D0 80 3D";
+	using namespace Signatures::Steam::x86;
+#endif
 
-	static uintptr_t* GetPointerFromRef(const uintptr_t instructionStart)
+	// Address of the function pointer loaded by the pattern's mov
+	static uintptr_t* FindPointerSlot(const HMODULE hModule, const mem::SignatureView& pattern)
 	{
-		return *reinterpret_cast<uintptr_t**>(instructionStart + 1);
+		return mem::ResolveCapture<uintptr_t*>(mem::PatternScanCached(hModule, pattern), pattern);
 	}
-#endif
 
 	inline bool Hook()
 	{
@@ -57,27 +44,24 @@ namespace Overlay::Steam
 			LOG_NOTICE("Detected Steam overlay...");
 			if (Overlay::graphicsAPI & D3D9)
 			{
-				if (const uintptr_t xRefDevicePresent = mem::PatternScan<uintptr_t>(hModule, d3d9_present_pattern))
+				if (const auto pPresent = FindPointerSlot(hModule, d3d9_present_pattern))
 				{
-					const auto pPresent = GetPointerFromRef(xRefDevicePresent);
 					const auto pReset = pPresent - 1; // previous ptr
 					SwapPointer(pPresent, PTR_AND_NAME(DirectX9::Present));
 					SwapPointer(pReset, PTR_AND_NAME(DirectX9::Reset));
 					anySuccess = true;
 				}
 
-				if (const uintptr_t xRefSwapChainPresent = mem::PatternScan<uintptr_t>(hModule, d3d9_swapchain_present_pattern))
+				if (const auto pPresent = FindPointerSlot(hModule, d3d9_swapchain_present_pattern))
 				{
-					const auto pPresent = GetPointerFromRef(xRefSwapChainPresent);
 					SwapPointer(pPresent, PTR_AND_NAME(DirectX9::SwapChainPresent));
 					anySuccess = true;
 				}
 			}
 			if (Overlay::graphicsAPI & D3D11 || Overlay::graphicsAPI & D3D12)
 			{
-				if (const uintptr_t xRefPresent = mem::PatternScan<uintptr_t>(hModule, d3d_present_pattern))
+				if (const auto pPresent = FindPointerSlot(hModule, d3d_present_pattern))
 				{
-					const auto pPresent = GetPointerFromRef(xRefPresent);
 					const auto pResizeBuffers = pPresent + 1; // next ptr
 					if (Overlay::graphicsAPI & D3D11)
 					{
@@ -97,9 +81,8 @@ namespace Overlay::Steam
 			}
 			if (Overlay::graphicsAPI & GraphicsAPI::OpenGL)
 			{
-				if (const uintptr_t xRefSwapBuffers = mem::PatternScan<uintptr_t>(hModule, opengl_swap_buffers_pattern))
+				if (const auto pWglSwapBuffers = FindPointerSlot(hModule, opengl_swap_buffers_pattern))
 				{
-					const auto pWglSwapBuffers = GetPointerFromRef(xRefSwapBuffers);
 					SwapPointer(pWglSwapBuffers, PTR_AND_NAME(OpenGL::WglSwapBuffers));
 					anySuccess = true;
 				}
@@ -1,16 +1,37 @@
 ﻿#include "menu.h"
 
+#include <algorithm>
+#include <format>
+#include <optional>
 #include <windows.h>
 
 #include "font_awesome.hpp"
 #include "imgui.h"
 #include "imgui_impl_win32.h"
+#include "Mem/saferead.h"
+#include "Mem/siggen.h"
 #include "overlay.h"
 #include "roboto_mono.hpp"
 #include "components/widgets.h"
 
 namespace
 {
+	// Current value at a scan result, read without faulting
+	std::string FormatValue(const mem::ValueType type, const std::uintptr_t address)
+	{
+		std::optional<std::string> value;
+		switch (type)
+		{
+		case mem::ValueType::Int8: if (const auto v = mem::SafeRead<std::int8_t>(address)) value = std::to_string(*v); break;
+		case mem::ValueType::Int16: if (const auto v = mem::SafeRead<std::int16_t>(address)) value = std::to_string(*v); break;
+		case mem::ValueType::Int32: if (const auto v = mem::SafeRead<std::int32_t>(address)) value = std::to_string(*v); break;
+		case mem::ValueType::Int64: if (const auto v = mem::SafeRead<std::int64_t>(address)) value = std::to_string(*v); break;
+		case mem::ValueType::Float: if (const auto v = mem::SafeRead<float>(address)) value = std::format("{}", *v); break;
+		case mem::ValueType::Double: if (const auto v = mem::SafeRead<double>(address)) value = std::format("{}", *v); break;
+		}
+		return value.value_or("??");
+	}
+
 	void SetupThemeStyle()
 	{
 		ImGui::StyleColorsDark();
@@ -153,6 +174,160 @@ void Menu::DrawMenu()
 		ImGui::Separator();
 		const auto& openKey = Keybinds::GetKeyBind(&Menu::bOpen);
 		ImGui::Text("Press %s %s to open/close this menu.", openKey->keyIcon.c_str(), openKey->keyName.c_str()); // Icons can also be used inside text with std::format or similar
+		ImGui::Separator();
+		ImGui::SetNextItemWidth(200.0f);
+		ImGui::InputTextWithHint("##signature_address", "Address (hex)", Menu::Variables::signatureAddress, sizeof(Menu::Variables::signatureAddress), ImGuiInputTextFlags_CharsHexadecimal);
+		ImGui::SameLine();
+		if (ImGui::Button(ICON_FA_FINGERPRINT" Generate signature"))
+		{
+			Menu::Functions::GenerateSignature();
+		}
+		if (!Menu::Variables::generatedSignature.empty()) ImGui::TextWrapped("%s", Menu::Variables::generatedSignature.c_str());
+		ImGui::Separator();
+		ImGui::SetNextItemWidth(200.0f);
+		ImGui::InputTextWithHint("##pointer_scan_target", "Target address (hex)", Menu::Variables::pointerScanTarget, sizeof(Menu::Variables::pointerScanTarget), ImGuiInputTextFlags_CharsHexadecimal);
+		ImGui::SameLine();
+		if (Menu::Variables::pointerScanner.IsRunning())
+		{
+			if (ImGui::Button(ICON_FA_STOP" Cancel")) Menu::Variables::pointerScanner.Cancel();
+		}
+		else if (ImGui::Button(ICON_FA_ROUTE" Pointer scan"))
+		{
+			Menu::Functions::StartPointerScan();
+		}
+		ImGui::SetNextItemWidth(200.0f);
+		ImGui::SliderInt("Max depth", &Menu::Variables::pointerScanDepth, 1, 8);
+		ImGui::SetNextItemWidth(200.0f);
+		ImGui::InputInt("Max offset", &Menu::Variables::pointerScanOffset, 8, 0x100, ImGuiInputTextFlags_CharsHexadecimal);
+
+		const auto progress = Menu::Variables::pointerScanner.GetProgress();
+		switch (progress.phase)
+		{
+		case mem::PointerScanner::Phase::Collecting:
+		case mem::PointerScanner::Phase::Searching:
+		{
+			const float fraction = progress.total ? static_cast<float>(progress.done) / static_cast<float>(progress.total) : 0.0f;
+			const std::string label = progress.phase == mem::PointerScanner::Phase::Collecting ? std::format("Collecting {} / {} MB, {} pointers", progress.done >> 20, progress.total >> 20, progress.pointers) : std::format("Depth {}, {} paths", progress.depth, progress.results);
+			ImGui::ProgressBar(fraction, { 400.0f, 0.0f }, label.c_str());
+			break;
+		}
+		case mem::PointerScanner::Phase::Done: ImGui::Text("%zu paths written to pointerscan.bin", progress.results); break;
+		case mem::PointerScanner::Phase::Failed: ImGui::TextUnformatted("Pointer scan failed."); break;
+		case mem::PointerScanner::Phase::Cancelled: ImGui::Text("Pointer scan cancelled, %zu paths written.", progress.results); break;
+		default: break;
+		}
+
+		ImGui::Separator();
+		const bool bScanning = Menu::Variables::bValueScanning;
+		const bool bScanned = !bScanning && Menu::Variables::valueScanner.HasScanned();
+		ImGui::SetNextItemWidth(200.0f);
+		if (bScanned) ImGui::BeginDisabled();
+		ImGui::Combo("Value type", &Menu::Variables::valueScanType, "Int8\0Int16\0Int32\0Int64\0Float\0Double\0");
+		if (bScanned) ImGui::EndDisabled();
+		ImGui::SetNextItemWidth(200.0f);
+		ImGui::Combo("Compare", &Menu::Variables::valueScanCompare, "Exact\0Range\0Unknown\0Changed\0Unchanged\0Increased\0Decreased\0");
+		const auto compare = static_cast<mem::ScanCompare>(Menu::Variables::valueScanCompare);
+		if (compare == mem::ScanCompare::Exact || compare == mem::ScanCompare::Range)
+		{
+			ImGui::SetNextItemWidth(200.0f);
+			ImGui::InputTextWithHint("##value_scan_value", "Value", Menu::Variables::valueScanValue, sizeof(Menu::Variables::valueScanValue));
+			if (compare == mem::ScanCompare::Range)
+			{
+				ImGui::SameLine();
+				ImGui::SetNextItemWidth(200.0f);
+				ImGui::InputTextWithHint("##value_scan_upper", "Upper value", Menu::Variables::valueScanUpper, sizeof(Menu::Variables::valueScanUpper));
+			}
+		}
+
+		if (bScanning) ImGui::BeginDisabled();
+		if (ImGui::Button(ICON_FA_MAGNIFYING_GLASS" First scan")) Menu::Functions::StartValueScan(true);
+		ImGui::SameLine();
+		if (!bScanned) ImGui::BeginDisabled();
+		if (ImGui::Button(ICON_FA_MAGNIFYING_GLASS" Next scan")) Menu::Functions::StartValueScan(false);
+		ImGui::SameLine();
+		if (ImGui::Button(ICON_FA_XMARK" Reset") && !Menu::Variables::bValueScanning)
+		{
+			Menu::Variables::valueScanner.Reset();
+			Menu::Variables::valueScanResults.clear();
+		}
+		if (!bScanned) ImGui::EndDisabled();
+		if (bScanning) ImGui::EndDisabled();
+
+		// Read again: a scan started by the buttons above already owns the scanner and the results
+		if (Menu::Variables::bValueScanning) ImGui::TextUnformatted("Scanning...");
+		else if (bScanned)
+		{
+			ImGui::Text("%zu results (%zu KB)", Menu::Variables::valueScanner.Count(), Menu::Variables::valueScanner.MemoryUsage() / 1024);
+			if (!Menu::Variables::valueScanResults.empty() && ImGui::BeginChild("##value_scan_results", { 400.0f, 150.0f }, true))
+			{
+				for (const auto& result : Menu::Variables::valueScanResults)
+				{
+					ImGui::Text("0x%llX  %s", static_cast<unsigned long long>(result.address), FormatValue(Menu::Variables::valueScanner.Type(), result.address).c_str());
+				}
+			}
+			if (!Menu::Variables::valueScanResults.empty()) ImGui::EndChild();
+		}
 	}
 	ImGui::End();
 }
+
+void Menu::Functions::GenerateSignature()
+{
+	using namespace Menu::Variables;
+
+	const auto address = static_cast<uintptr_t>(std::strtoull(signatureAddress, nullptr, 16));
+	HMODULE hModule = nullptr;
+	if (!address || !GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, reinterpret_cast<LPCSTR>(address), &hModule))
+	{
+		generatedSignature = "Address isn't inside a loaded module.";
+		return;
+	}
+
+	generatedSignature = mem::GenerateSignature(hModule, reinterpret_cast<const void*>(address));
+	if (generatedSignature.empty())
+	{
+		generatedSignature = "No unique signature found.";
+		return;
+	}
+
+	ImGui::SetClipboardText(generatedSignature.c_str()); // Ready to paste in Hooks::List
+	LOG_INFO("Generated signature for 0x{:X}: {}", address, generatedSignature);
+}
+
+void Menu::Functions::StartPointerScan()
+{
+	using namespace Menu::Variables;
+
+	mem::PointerScanOptions options;
+	options.target = static_cast<uintptr_t>(std::strtoull(pointerScanTarget, nullptr, 16));
+	options.maxDepth = static_cast<unsigned>(pointerScanDepth);
+	options.maxOffset = static_cast<unsigned>(std::max(pointerScanOffset, 0));
+	if (!options.target) return;
+
+	pointerScanner.Start(options);
+	LOG_INFO("Pointer scan started for 0x{:X}, depth {}, max offset 0x{:X}", options.target, options.maxDepth, options.maxOffset);
+}
+
+void Menu::Functions::StartValueScan(const bool bFirstScan)
+{
+	using namespace Menu::Variables;
+
+	if (bValueScanning) return;
+
+	mem::ScanQuery query;
+	query.type = bFirstScan ? static_cast<mem::ValueType>(valueScanType) : valueScanner.Type();
+	query.compare = static_cast<mem::ScanCompare>(valueScanCompare);
+	const bool bReal = query.type == mem::ValueType::Float || query.type == mem::ValueType::Double;
+	const auto parse = [bReal](const char* text) { return bReal ? mem::ScanValue(std::strtod(text, nullptr)) : mem::ScanValue(std::strtoll(text, nullptr, 0)); };
+	query.value = parse(valueScanValue);
+	query.upper = parse(valueScanUpper);
+
+	bValueScanning = true;
+	valueScanThread = std::jthread([query, bFirstScan]
+	{
+		const size_t count = bFirstScan ? valueScanner.FirstScan(query) : valueScanner.NextScan(query);
+		valueScanResults = valueScanner.Results(100);
+		LOG_INFO("Value scan: {} results", count);
+		bValueScanning = false;
+	});
+}
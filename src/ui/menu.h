@@ -1,4 +1,11 @@
 ﻿#pragma once
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Mem/pointerscan.h"
+#include "Mem/valuescan.h"
 
 namespace Menu
 {
@@ -11,11 +18,28 @@ namespace Menu
 
 	namespace Functions
 	{
-		
+		void GenerateSignature();
+		void StartPointerScan();
+		void StartValueScan(bool bFirstScan);
 	}
 
 	namespace Variables
 	{
-		
+		inline char signatureAddress[19]{};	// Hex address typed in the menu ("0x" + 16 digits)
+		inline std::string generatedSignature;
+
+		inline char pointerScanTarget[19]{};	// Hex address to find pointer paths to
+		inline int pointerScanDepth = 5;
+		inline int pointerScanOffset = 0x1000;
+		inline mem::PointerScanner pointerScanner;	// Results are written to pointerscan.bin
+
+		inline int valueScanType = static_cast<int>(mem::ValueType::Int32);
+		inline int valueScanCompare = static_cast<int>(mem::ScanCompare::Exact);
+		inline char valueScanValue[32]{};
+		inline char valueScanUpper[32]{};	// Range only
+		inline mem::ValueScanner valueScanner;
+		inline std::vector<mem::ScanResult> valueScanResults;	// First results of the last scan, only touched by the scan thread while bValueScanning
+		inline std::atomic<bool> bValueScanning = false;
+		inline std::jthread valueScanThread;
 	}
 }
@@ -0,0 +1,85 @@
+﻿// N sequential mem::detail::FindPattern scans against one mem::detail::FindPatterns pass, for 12 (src/signatures.h) up to 128 signatures
+// over a synthetic code-like buffer. The extra signatures are 16-byte excerpts of the buffer with a rel32 wildcard. make -C tools build/batchbench
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "Mem/mem.h"
+#include "../src/signatures.h"
+#include "bench.h"
+
+namespace
+{
+	// Owns the bytes of the generated signatures
+	struct Excerpt
+	{
+		std::vector<BYTE> bytes;
+		std::vector<BYTE> mask;
+		mem::SignatureView signature;
+	};
+
+	// "xx xx xx ?? ?? ?? ?? xx ..." copied from the second half of the buffer, so the matches are spread over it
+	std::vector<Excerpt> Excerpts(const std::vector<std::uint8_t>& buffer, const size_t count)
+	{
+		constexpr size_t size = 16;
+		std::mt19937_64 rng(7);
+		std::vector<Excerpt> excerpts(count);
+		for (auto& excerpt : excerpts)
+		{
+			const size_t offset = buffer.size() / 2 + rng() % (buffer.size() / 2 - size);
+			excerpt.bytes.assign(buffer.begin() + offset, buffer.begin() + offset + size);
+			excerpt.mask.assign(size, 0xFF);
+			for (size_t i = 3; i < 7; i++) excerpt.bytes[i] = excerpt.mask[i] = 0x00;
+
+			excerpt.signature = { excerpt.bytes.data(), excerpt.mask.data(), size };
+			mem::detail::SelectAnchors(excerpt.signature);
+		}
+		return excerpts;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const size_t nSize = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 128) << 20;
+	auto buffer = bench::CodeLikeBuffer(nSize);
+
+	const size_t nProject = std::size(Signatures::List);
+	for (size_t i = 0; i < nProject; i++) bench::Plant(buffer, nSize - (nProject - i) * 256, Signatures::List[i].signature);
+
+	constexpr size_t maxSignatures = 128;
+	const auto excerpts = Excerpts(buffer, maxSignatures - nProject);
+	std::vector<mem::SignatureView> signatures;
+	for (const auto& entry : Signatures::List) signatures.push_back(entry.signature);
+	for (const auto& excerpt : excerpts) signatures.push_back(excerpt.signature);
+
+	std::printf("%zu MB\n%10s %14s %14s %8s\n", nSize >> 20, "signatures", "sequential ms", "batched ms", "speedup");
+
+	bool bSame = true;
+	for (const size_t count : { nProject, size_t{ 32 }, size_t{ 64 }, maxSignatures })
+	{
+		const std::span<const mem::SignatureView> batch(signatures.data(), count);
+
+		std::vector<const BYTE*> sequential(count);
+		const double sequentialSeconds = bench::Time([&]
+		{
+			for (size_t i = 0; i < count; i++) sequential[i] = mem::detail::FindPattern(buffer.data(), nSize, batch[i], false);
+		}, 1);
+
+		std::vector<const BYTE*> batched(count);
+		const double batchedSeconds = bench::Time([&]
+		{
+			std::ranges::fill(batched, nullptr);
+			mem::detail::FindPatterns(buffer.data(), nSize, batch, batched, false);
+		});
+
+		std::printf("%10zu %14.1f %14.1f %7.1fx", count, sequentialSeconds * 1e3, batchedSeconds * 1e3, sequentialSeconds / batchedSeconds);
+		if (batched != sequential)
+		{
+			std::printf(" (results differ)");
+			bSame = false;
+		}
+		std::printf("\n");
+	}
+	std::printf(bSame ? "batched results match the sequential scans\n" : "batched results differ\n");
+	return bSame ? 0 : 1;
+}
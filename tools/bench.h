@@ -0,0 +1,67 @@
+﻿#pragma once
+// Helpers of the tools/*bench.cpp programs: synthetic code-like buffers, planted matches and timings
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "Mem/signature.h"
+
+namespace bench
+{
+	// Bytes drawn with roughly the frequencies of x86 code (zero padding, REX.W, mov, call, int3), so anchors see realistic hit rates
+	inline std::vector<std::uint8_t> CodeLikeBuffer(const size_t nSize, const std::uint32_t seed = 42)
+	{
+		std::array<double, 256> weights;
+		weights.fill(1.0);
+		for (const auto& [value, weight] : { std::pair{ 0x00, 60.0 }, { 0xFF, 20.0 }, { 0x48, 20.0 }, { 0x8B, 20.0 }, { 0x89, 12.0 }, { 0xCC, 12.0 }, { 0xE8, 8.0 }, { 0x0F, 8.0 }, { 0x24, 6.0 }, { 0x44, 6.0 }, { 0x4C, 4.0 }, { 0xC3, 4.0 } })
+		{
+			weights[value] = weight;
+		}
+
+		// Sampled through a 64K table indexed by 16 random bits, hundreds of MB take a second instead of a minute
+		std::mt19937 rng(seed);
+		std::discrete_distribution<int> distribution(weights.begin(), weights.end());
+		std::vector<std::uint8_t> table(1 << 16);
+		for (auto& byte : table) byte = static_cast<std::uint8_t>(distribution(rng));
+
+		std::vector<std::uint8_t> buffer(nSize);
+		for (size_t i = 0; i < nSize; i += 2)
+		{
+			const std::uint32_t bits = rng();
+			buffer[i] = table[bits & 0xFFFF];
+			if (i + 1 < nSize) buffer[i + 1] = table[bits >> 16];
+		}
+		return buffer;
+	}
+
+	// Writes the fixed bits of the signature at offset, wildcard bits keep the buffer content
+	inline void Plant(std::vector<std::uint8_t>& buffer, const size_t offset, const mem::SignatureView& signature)
+	{
+		for (size_t i = 0; i < signature.size; i++)
+		{
+			buffer[offset + i] = static_cast<std::uint8_t>((buffer[offset + i] & ~signature.mask[i]) | signature.bytes[i]);
+		}
+	}
+
+	// Best of 'repeats' runs, in seconds
+	template<typename Fn>
+	double Time(Fn&& fn, const int repeats = 3)
+	{
+		double best = 1e300;
+		for (int i = 0; i < repeats; i++)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			fn();
+			best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		}
+		return best;
+	}
+
+	inline double GBps(const size_t nBytes, const double seconds)
+	{
+		return nBytes / seconds / 1e9;
+	}
+}
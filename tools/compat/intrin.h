@@ -0,0 +1,28 @@
+﻿#pragma once
+// MSVC CPU identification intrinsics on top of the GCC / clang builtins (see windows.h).
+// Renamed through macros, since some versions of <cpuid.h> declare their own __cpuidex and __cpuid is a macro there.
+#include <cpuid.h>
+#include <immintrin.h>
+
+inline void CompatCpuidex(int info[4], const int leaf, const int subleaf)
+{
+	__cpuid_count(leaf, subleaf, info[0], info[1], info[2], info[3]);
+}
+
+inline void CompatCpuid(int info[4], const int leaf)
+{
+	CompatCpuidex(info, leaf, 0);
+}
+
+// GCC only allows the _xgetbv builtin in functions targeting XSAVE
+inline unsigned long long CompatXgetbv(const unsigned int index)
+{
+	unsigned int eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+	return static_cast<unsigned long long>(edx) << 32 | eax;
+}
+
+#undef __cpuid
+#define __cpuid CompatCpuid
+#define __cpuidex CompatCpuidex
+#define _xgetbv CompatXgetbv
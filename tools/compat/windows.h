@@ -0,0 +1,354 @@
+﻿#pragma once
+// Subset of <windows.h> the Mem sources need, so the tools can be built on Linux with g++ or clang (see tools/Makefile).
+// PE types match the Windows SDK layout. Memory functions only handle the current process and are backed by
+// /proc/self/maps, mmap and mprotect. __try / __except become try / catch: faults are not caught in these builds.
+#include <alloca.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <strings.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+typedef std::uint8_t BYTE, UINT8, * PBYTE;
+typedef std::int8_t INT8;
+typedef std::uint16_t WORD;
+typedef std::uint32_t DWORD, * PDWORD, * LPDWORD;
+typedef std::int32_t LONG;
+typedef std::int64_t LONGLONG;
+typedef std::uint64_t ULONGLONG;
+typedef std::uintptr_t ULONG_PTR, DWORD_PTR;
+typedef std::size_t SIZE_T;
+typedef int BOOL;
+typedef unsigned int UINT;
+typedef char CHAR, * LPSTR;
+typedef const char* LPCSTR;
+typedef void* LPVOID, * HANDLE;
+typedef const void* LPCVOID;
+typedef struct HINSTANCE__* HMODULE, * HINSTANCE;
+
+#define TRUE 1
+#define FALSE 0
+#define WINAPI
+#define MAX_PATH 260
+#define MAXDWORD 0xFFFFFFFF
+
+#define _alloca alloca
+#define _stricmp strcasecmp
+#define __try try
+#define __except(filter) catch (...)
+#define EXCEPTION_EXECUTE_HANDLER 1
+
+#define PAGE_NOACCESS 0x01
+#define PAGE_READONLY 0x02
+#define PAGE_READWRITE 0x04
+#define PAGE_WRITECOPY 0x08
+#define PAGE_EXECUTE 0x10
+#define PAGE_EXECUTE_READ 0x20
+#define PAGE_EXECUTE_READWRITE 0x40
+#define PAGE_EXECUTE_WRITECOPY 0x80
+#define PAGE_GUARD 0x100
+#define MEM_COMMIT 0x1000
+#define MEM_RESERVE 0x2000
+#define MEM_RELEASE 0x8000
+#define MEM_FREE 0x10000
+#define MEM_PRIVATE 0x20000
+
+#define IMAGE_DOS_SIGNATURE 0x5A4D
+#define IMAGE_NT_SIGNATURE 0x00004550
+#define IMAGE_NT_OPTIONAL_HDR32_MAGIC 0x10B
+#define IMAGE_NT_OPTIONAL_HDR64_MAGIC 0x20B
+#define IMAGE_NUMBEROF_DIRECTORY_ENTRIES 16
+#define IMAGE_SIZEOF_SHORT_NAME 8
+#define IMAGE_DIRECTORY_ENTRY_EXPORT 0
+#define IMAGE_DIRECTORY_ENTRY_IMPORT 1
+#define IMAGE_DIRECTORY_ENTRY_BASERELOC 5
+#define IMAGE_REL_BASED_ABSOLUTE 0
+#define IMAGE_REL_BASED_HIGH 1
+#define IMAGE_REL_BASED_LOW 2
+#define IMAGE_REL_BASED_HIGHLOW 3
+#define IMAGE_REL_BASED_HIGHADJ 4
+#define IMAGE_REL_BASED_DIR64 10
+#define IMAGE_FILE_MACHINE_I386 0x014C
+#define IMAGE_FILE_MACHINE_AMD64 0x8664
+#define IMAGE_SCN_CNT_CODE 0x00000020
+#define IMAGE_SCN_CNT_INITIALIZED_DATA 0x00000040
+#define IMAGE_SCN_CNT_UNINITIALIZED_DATA 0x00000080
+#define IMAGE_SCN_MEM_DISCARDABLE 0x02000000
+#define IMAGE_SCN_MEM_EXECUTE 0x20000000
+#define IMAGE_SCN_MEM_READ 0x40000000
+#define IMAGE_SCN_MEM_WRITE 0x80000000
+
+typedef struct _IMAGE_DOS_HEADER
+{
+	WORD e_magic, e_cblp, e_cp, e_crlc, e_cparhdr, e_minalloc, e_maxalloc, e_ss, e_sp, e_csum, e_ip, e_cs, e_lfarlc, e_ovno;
+	WORD e_res[4];
+	WORD e_oemid, e_oeminfo;
+	WORD e_res2[10];
+	LONG e_lfanew;
+} IMAGE_DOS_HEADER, * PIMAGE_DOS_HEADER;
+
+typedef struct _IMAGE_FILE_HEADER
+{
+	WORD Machine;
+	WORD NumberOfSections;
+	DWORD TimeDateStamp;
+	DWORD PointerToSymbolTable;
+	DWORD NumberOfSymbols;
+	WORD SizeOfOptionalHeader;
+	WORD Characteristics;
+} IMAGE_FILE_HEADER, * PIMAGE_FILE_HEADER;
+
+typedef struct _IMAGE_DATA_DIRECTORY
+{
+	DWORD VirtualAddress;
+	DWORD Size;
+} IMAGE_DATA_DIRECTORY, * PIMAGE_DATA_DIRECTORY;
+
+typedef struct _IMAGE_OPTIONAL_HEADER
+{
+	WORD Magic;
+	BYTE MajorLinkerVersion, MinorLinkerVersion;
+	DWORD SizeOfCode, SizeOfInitializedData, SizeOfUninitializedData, AddressOfEntryPoint, BaseOfCode, BaseOfData;
+	DWORD ImageBase, SectionAlignment, FileAlignment;
+	WORD MajorOperatingSystemVersion, MinorOperatingSystemVersion, MajorImageVersion, MinorImageVersion, MajorSubsystemVersion, MinorSubsystemVersion;
+	DWORD Win32VersionValue, SizeOfImage, SizeOfHeaders, CheckSum;
+	WORD Subsystem, DllCharacteristics;
+	DWORD SizeOfStackReserve, SizeOfStackCommit, SizeOfHeapReserve, SizeOfHeapCommit;
+	DWORD LoaderFlags, NumberOfRvaAndSizes;
+	IMAGE_DATA_DIRECTORY DataDirectory[IMAGE_NUMBEROF_DIRECTORY_ENTRIES];
+} IMAGE_OPTIONAL_HEADER32, * PIMAGE_OPTIONAL_HEADER32;
+
+typedef struct _IMAGE_OPTIONAL_HEADER64
+{
+	WORD Magic;
+	BYTE MajorLinkerVersion, MinorLinkerVersion;
+	DWORD SizeOfCode, SizeOfInitializedData, SizeOfUninitializedData, AddressOfEntryPoint, BaseOfCode;
+	ULONGLONG ImageBase;
+	DWORD SectionAlignment, FileAlignment;
+	WORD MajorOperatingSystemVersion, MinorOperatingSystemVersion, MajorImageVersion, MinorImageVersion, MajorSubsystemVersion, MinorSubsystemVersion;
+	DWORD Win32VersionValue, SizeOfImage, SizeOfHeaders, CheckSum;
+	WORD Subsystem, DllCharacteristics;
+	ULONGLONG SizeOfStackReserve, SizeOfStackCommit, SizeOfHeapReserve, SizeOfHeapCommit;
+	DWORD LoaderFlags, NumberOfRvaAndSizes;
+	IMAGE_DATA_DIRECTORY DataDirectory[IMAGE_NUMBEROF_DIRECTORY_ENTRIES];
+} IMAGE_OPTIONAL_HEADER64, * PIMAGE_OPTIONAL_HEADER64;
+
+typedef struct _IMAGE_NT_HEADERS
+{
+	DWORD Signature;
+	IMAGE_FILE_HEADER FileHeader;
+	IMAGE_OPTIONAL_HEADER32 OptionalHeader;
+} IMAGE_NT_HEADERS32, * PIMAGE_NT_HEADERS32;
+
+typedef struct _IMAGE_NT_HEADERS64
+{
+	DWORD Signature;
+	IMAGE_FILE_HEADER FileHeader;
+	IMAGE_OPTIONAL_HEADER64 OptionalHeader;
+} IMAGE_NT_HEADERS64, * PIMAGE_NT_HEADERS64;
+
+typedef IMAGE_NT_HEADERS64 IMAGE_NT_HEADERS, * PIMAGE_NT_HEADERS;
+
+typedef struct _IMAGE_SECTION_HEADER
+{
+	BYTE Name[IMAGE_SIZEOF_SHORT_NAME];
+	union
+	{
+		DWORD PhysicalAddress;
+		DWORD VirtualSize;
+	} Misc;
+	DWORD VirtualAddress, SizeOfRawData, PointerToRawData, PointerToRelocations, PointerToLinenumbers;
+	WORD NumberOfRelocations, NumberOfLinenumbers;
+	DWORD Characteristics;
+} IMAGE_SECTION_HEADER, * PIMAGE_SECTION_HEADER;
+
+typedef struct _IMAGE_BASE_RELOCATION
+{
+	DWORD VirtualAddress;
+	DWORD SizeOfBlock;
+} IMAGE_BASE_RELOCATION, * PIMAGE_BASE_RELOCATION;
+
+typedef struct _IMAGE_EXPORT_DIRECTORY
+{
+	DWORD Characteristics, TimeDateStamp;
+	WORD MajorVersion, MinorVersion;
+	DWORD Name, Base, NumberOfFunctions, NumberOfNames, AddressOfFunctions, AddressOfNames, AddressOfNameOrdinals;
+} IMAGE_EXPORT_DIRECTORY, * PIMAGE_EXPORT_DIRECTORY;
+
+static_assert(sizeof(IMAGE_DOS_HEADER) == 64 && sizeof(IMAGE_FILE_HEADER) == 20 && sizeof(IMAGE_SECTION_HEADER) == 40);
+static_assert(sizeof(IMAGE_NT_HEADERS32) == 248 && sizeof(IMAGE_NT_HEADERS64) == 264);
+
+#define IMAGE_FIRST_SECTION(ntHeaders) reinterpret_cast<PIMAGE_SECTION_HEADER>(reinterpret_cast<ULONG_PTR>(ntHeaders) + offsetof(IMAGE_NT_HEADERS, OptionalHeader) + (ntHeaders)->FileHeader.SizeOfOptionalHeader)
+
+typedef struct _MEMORY_BASIC_INFORMATION
+{
+	LPVOID BaseAddress;
+	LPVOID AllocationBase;
+	DWORD AllocationProtect;
+	SIZE_T RegionSize;
+	DWORD State;
+	DWORD Protect;
+	DWORD Type;
+} MEMORY_BASIC_INFORMATION, * PMEMORY_BASIC_INFORMATION;
+
+typedef struct _SYSTEM_INFO
+{
+	WORD wProcessorArchitecture, wReserved;
+	DWORD dwPageSize;
+	LPVOID lpMinimumApplicationAddress, lpMaximumApplicationAddress;
+	DWORD_PTR dwActiveProcessorMask;
+	DWORD dwNumberOfProcessors, dwProcessorType, dwAllocationGranularity;
+	WORD wProcessorLevel, wProcessorRevision;
+} SYSTEM_INFO, * LPSYSTEM_INFO;
+
+namespace compat
+{
+	inline DWORD ToPageProtection(const int protection)
+	{
+		if (protection & PROT_EXEC) return protection & PROT_WRITE ? PAGE_EXECUTE_READWRITE : protection & PROT_READ ? PAGE_EXECUTE_READ : PAGE_EXECUTE;
+		if (protection & PROT_WRITE) return PAGE_READWRITE;
+		return protection & PROT_READ ? PAGE_READONLY : PAGE_NOACCESS;
+	}
+
+	inline int ToProt(const DWORD protection)
+	{
+		switch (protection & 0xFF)
+		{
+		case PAGE_READONLY: return PROT_READ;
+		case PAGE_READWRITE: case PAGE_WRITECOPY: return PROT_READ | PROT_WRITE;
+		case PAGE_EXECUTE: return PROT_EXEC;
+		case PAGE_EXECUTE_READ: return PROT_READ | PROT_EXEC;
+		case PAGE_EXECUTE_READWRITE: case PAGE_EXECUTE_WRITECOPY: return PROT_READ | PROT_WRITE | PROT_EXEC;
+		default: return PROT_NONE;
+		}
+	}
+}
+
+inline void GetSystemInfo(const LPSYSTEM_INFO pInfo)
+{
+	*pInfo = {};
+	pInfo->dwPageSize = static_cast<DWORD>(sysconf(_SC_PAGESIZE));
+	pInfo->dwAllocationGranularity = 64 * 1024;
+	pInfo->dwNumberOfProcessors = static_cast<DWORD>(sysconf(_SC_NPROCESSORS_ONLN));
+	pInfo->lpMinimumApplicationAddress = reinterpret_cast<LPVOID>(0x10000);
+	pInfo->lpMaximumApplicationAddress = reinterpret_cast<LPVOID>(sizeof(void*) == 8 ? 0x7FFFFFFEFFFF : 0xBFFEFFFF);
+}
+
+// Mapping containing the address, or the gap before the next one, from /proc/self/maps
+inline SIZE_T VirtualQuery(const LPCVOID pAddress, const PMEMORY_BASIC_INFORMATION pInfo, const SIZE_T)
+{
+	const auto address = reinterpret_cast<std::uintptr_t>(pAddress);
+	FILE* pMaps = std::fopen("/proc/self/maps", "r");
+	if (!pMaps) return 0;
+
+	*pInfo = {};
+	std::uintptr_t gapStart = 0;
+	std::uintptr_t gapEnd = sizeof(void*) == 8 ? 0x800000000000 : 0xC0000000;
+	char line[512];
+	while (std::fgets(line, sizeof(line), pMaps))
+	{
+		unsigned long long start, end;
+		char perms[5] = {};
+		if (std::sscanf(line, "%llx-%llx %4s", &start, &end, perms) != 3) continue;
+		if (address >= end)
+		{
+			gapStart = static_cast<std::uintptr_t>(end);
+			continue;
+		}
+		if (address < start)
+		{
+			gapEnd = static_cast<std::uintptr_t>(start);
+			break;
+		}
+
+		const int protection = (perms[0] == 'r' ? PROT_READ : 0) | (perms[1] == 'w' ? PROT_WRITE : 0) | (perms[2] == 'x' ? PROT_EXEC : 0);
+		pInfo->BaseAddress = pInfo->AllocationBase = reinterpret_cast<LPVOID>(start);
+		pInfo->RegionSize = static_cast<SIZE_T>(end - start);
+		pInfo->State = MEM_COMMIT;
+		pInfo->Protect = pInfo->AllocationProtect = compat::ToPageProtection(protection);
+		pInfo->Type = MEM_PRIVATE;
+		std::fclose(pMaps);
+		return sizeof(*pInfo);
+	}
+	std::fclose(pMaps);
+	if (address >= gapEnd) return 0;
+
+	pInfo->BaseAddress = reinterpret_cast<LPVOID>(gapStart);
+	pInfo->RegionSize = gapEnd - gapStart;
+	pInfo->State = MEM_FREE;
+	pInfo->Protect = PAGE_NOACCESS;
+	return sizeof(*pInfo);
+}
+
+inline BOOL VirtualProtect(const LPVOID pAddress, const SIZE_T nSize, const DWORD flNewProtect, const PDWORD pflOldProtect)
+{
+	MEMORY_BASIC_INFORMATION mbi;
+	if (!VirtualQuery(pAddress, &mbi, sizeof(mbi)) || mbi.State != MEM_COMMIT) return FALSE;
+
+	const std::uintptr_t pageSize = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+	const std::uintptr_t first = reinterpret_cast<std::uintptr_t>(pAddress) & ~(pageSize - 1);
+	const std::uintptr_t last = (reinterpret_cast<std::uintptr_t>(pAddress) + nSize + pageSize - 1) & ~(pageSize - 1);
+	if (mprotect(reinterpret_cast<void*>(first), last - first, compat::ToProt(flNewProtect))) return FALSE;
+	if (pflOldProtect) *pflOldProtect = mbi.Protect;
+	return TRUE;
+}
+
+inline LPVOID VirtualAlloc(const LPVOID pAddress, const SIZE_T nSize, const DWORD, const DWORD flProtect)
+{
+	void* p = mmap(pAddress, nSize, compat::ToProt(flProtect), MAP_PRIVATE | MAP_ANONYMOUS | (pAddress ? MAP_FIXED_NOREPLACE : 0), -1, 0);
+	return p == MAP_FAILED ? nullptr : p;
+}
+
+// Whole mapping for MEM_RELEASE, as VirtualFree with a size of 0
+inline BOOL VirtualFree(const LPVOID pAddress, SIZE_T nSize, const DWORD)
+{
+	MEMORY_BASIC_INFORMATION mbi;
+	if (!nSize && VirtualQuery(pAddress, &mbi, sizeof(mbi))) nSize = mbi.RegionSize;
+	return munmap(pAddress, nSize) == 0;
+}
+
+inline HANDLE GetCurrentProcess()
+{
+	return reinterpret_cast<HANDLE>(-1);
+}
+
+inline BOOL VirtualProtectEx(HANDLE, const LPVOID pAddress, const SIZE_T nSize, const DWORD flNewProtect, const PDWORD pflOldProtect)
+{
+	return VirtualProtect(pAddress, nSize, flNewProtect, pflOldProtect);
+}
+
+inline BOOL WriteProcessMemory(HANDLE, const LPVOID pAddress, const LPCVOID pBuffer, const SIZE_T nSize, SIZE_T* pWritten)
+{
+	std::memcpy(pAddress, pBuffer, nSize);
+	if (pWritten) *pWritten = nSize;
+	return TRUE;
+}
+
+inline BOOL ReadProcessMemory(HANDLE, const LPCVOID pAddress, const LPVOID pBuffer, const SIZE_T nSize, SIZE_T* pRead)
+{
+	std::memcpy(pBuffer, pAddress, nSize);
+	if (pRead) *pRead = nSize;
+	return TRUE;
+}
+
+inline BOOL FlushInstructionCache(HANDLE, LPCVOID, SIZE_T)
+{
+	return TRUE;
+}
+
+// Only the executable itself has a file name here
+inline DWORD GetModuleFileNameA(const HMODULE hModule, const LPSTR pBuffer, const DWORD nSize)
+{
+	if (hModule || !nSize) return 0;
+	const ssize_t length = readlink("/proc/self/exe", pBuffer, nSize - 1);
+	if (length < 0) return 0;
+	pBuffer[length] = '\0';
+	return static_cast<DWORD>(length);
+}
+
+inline HMODULE GetModuleHandleA(LPCSTR)
+{
+	return nullptr;
+}
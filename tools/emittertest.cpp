@@ -0,0 +1,158 @@
+﻿// mem::x86::Emitter encodings, checked byte for byte and by running the emitted code from executable pages: one anywhere,
+// one more than 4 GB away from the functions it calls so only the absolute forms reach them. Linux x64: make -C tools test
+#include <cstring>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "Mem/emitter.h"
+#include "Mem/mem.h"
+#include "test.h"
+
+using mem::x86::Emitter;
+using mem::x86::Register;
+
+namespace
+{
+	extern "C" __attribute__((noinline)) long long Callee()
+	{
+		return 1234;
+	}
+
+	std::uint8_t* MapExecutable(const std::uintptr_t hint)
+	{
+		const long pageSize = sysconf(_SC_PAGESIZE);
+		void* p = mmap(reinterpret_cast<void*>(hint), pageSize, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS | (hint ? MAP_FIXED_NOREPLACE : 0), -1, 0);
+		return p == MAP_FAILED ? nullptr : static_cast<std::uint8_t*>(p);
+	}
+
+	// Page at least 4 GB above the callee, out of rel32 reach
+	std::uint8_t* MapFar()
+	{
+		const auto callee = reinterpret_cast<std::uintptr_t>(&Callee);
+		for (std::uintptr_t distance = std::uintptr_t{ 4 } << 30; distance < std::uintptr_t{ 1 } << 44; distance <<= 1)
+		{
+			if (std::uint8_t* p = MapExecutable((callee + distance) & ~std::uintptr_t{ 0xFFFF })) return p;
+		}
+		return nullptr;
+	}
+
+	long long Run(const std::uint8_t* pCode)
+	{
+		return reinterpret_cast<long long (*)()>(const_cast<std::uint8_t*>(pCode))();
+	}
+
+	bool Equals(const std::span<const std::uint8_t> code, const std::vector<std::uint8_t>& expected)
+	{
+		return code.size() == expected.size() && std::memcmp(code.data(), expected.data(), code.size()) == 0;
+	}
+
+	void Encodings()
+	{
+		std::uint8_t buffer[32];
+
+		CHECK(Equals(Emitter(buffer).Mov(Register::Rax, 5).Code(), { 0xB8, 5, 0, 0, 0 }));
+		CHECK(Equals(Emitter(buffer).Mov(Register::R9, 5).Code(), { 0x41, 0xB9, 5, 0, 0, 0 }));
+		CHECK(Equals(Emitter(buffer).Mov(Register::Rcx, static_cast<std::uint64_t>(-2)).Code(), { 0x48, 0xC7, 0xC1, 0xFE, 0xFF, 0xFF, 0xFF }));
+		CHECK(Emitter(buffer).Mov(Register::R10, 0x123456789).Size() == 10 && buffer[0] == 0x49 && buffer[1] == 0xBA);
+		CHECK(Equals(Emitter(buffer).Push(Register::R12).Pop(Register::Rbx).Ret().Code(), { 0x41, 0x54, 0x5B, 0xC3 }));
+
+		// Shortest jump from the emitter address
+		CHECK(Equals(Emitter(buffer, 0x1000).Jmp(0x1010).Code(), { 0xEB, 0x0E }));
+		CHECK(Equals(Emitter(buffer, 0x1000).Jmp(0x0F00).Code(), { 0xE9, 0xFB, 0xFE, 0xFF, 0xFF }));
+		CHECK(Equals(Emitter(buffer, 0x1000).JmpRel32(0x1010).Code(), { 0xE9, 0x0B, 0, 0, 0 }));
+		CHECK(Equals(Emitter(buffer, 0x1000).Jmp(0x123456789ABC).Code(), { 0xFF, 0x25, 0, 0, 0, 0, 0xBC, 0x9A, 0x78, 0x56, 0x34, 0x12, 0, 0 }));
+		CHECK(Emitter(buffer, 0x1000).Call(0x2000).Size() == 5 && buffer[0] == 0xE8);
+		CHECK(Emitter(buffer, 0x1000).Call(0x123456789ABC).Size() == 16 && buffer[0] == 0xFF && buffer[1] == 0x15);
+
+		// Multi-byte NOPs, largest first
+		CHECK(Equals(Emitter(buffer).Nop(12).Code(), { 0x66, 0x0F, 0x1F, 0x84, 0, 0, 0, 0, 0, 0x0F, 0x1F, 0x00 }));
+
+		// Nothing more is written after a failure
+		std::uint8_t small[4];
+		Emitter overflow(small);
+		overflow.Ret().Jmp(0x1000).Ret();
+		CHECK(overflow.Failed() && overflow.Size() == 1);
+
+		Emitter unreachable(buffer, 0x1000);
+		CHECK(unreachable.JmpRel32(0x1000 + (std::uintptr_t{ 1 } << 32)).Failed() && unreachable.Size() == 0);
+
+		// x86: rel32 wraps around the 4 GB address space, no REX registers and no absolute forms
+		Emitter x86(buffer, 0x1000, false);
+		int32_t displacement;
+		CHECK(x86.Jmp(0xFFFF0000).Size() == 5 && !x86.Failed());
+		std::memcpy(&displacement, buffer + 1, sizeof(displacement));
+		CHECK(static_cast<std::uint32_t>(0x1005 + displacement) == 0xFFFF0000);
+		CHECK(Emitter(buffer, 0, false).Push(Register::R8).Failed());
+		CHECK(Emitter(buffer, 0, false).JmpAbsolute(0x1000).Failed());
+		CHECK(Emitter(buffer, 0, false).Mov(Register::Rax, 0x100000000).Failed());
+	}
+
+	void Execution()
+	{
+		std::uint8_t* pNear = MapExecutable(0);
+		std::uint8_t* pFar = MapFar();
+		CHECK(pNear && pFar);
+		if (!pNear || !pFar) return;
+
+		const std::span<std::uint8_t> code(pNear, 256);
+		const auto callee = reinterpret_cast<std::uintptr_t>(&Callee);
+
+		Emitter(code).Mov(Register::Rax, static_cast<std::uint64_t>(-2)).Ret();
+		CHECK(Run(pNear) == -2);
+		Emitter(code).Mov(Register::Rax, 0x1122334455667788).Ret();
+		CHECK(Run(pNear) == 0x1122334455667788);
+		Emitter(code).Mov(Register::Rax, 0xDEADBEEF).Ret();
+		CHECK(Run(pNear) == 0xDEADBEEF);
+		Emitter(code).Push(Register::R12).Mov(Register::R12, 0x7777777777).Push(Register::R12).Pop(Register::Rax).Pop(Register::R12).Ret();
+		CHECK(Run(pNear) == 0x7777777777);
+
+		// jmp rel8 over NOPs, then a long NOP run falling through
+		Emitter(code).Jmp(reinterpret_cast<std::uintptr_t>(pNear) + 10).Nop(8).Nop(37).Mov(Register::Rax, 7).Ret();
+		CHECK(pNear[0] == 0xEB && Run(pNear) == 7);
+
+		// rel32 back to the start of the page
+		Emitter back(code.subspan(128), reinterpret_cast<std::uintptr_t>(pNear) + 128);
+		CHECK(back.Jmp(reinterpret_cast<std::uintptr_t>(pNear)).Size() == 5 && Run(pNear + 128) == 7);
+
+		// Out of rel32 reach: call [rip+2] (rbx keeps the stack aligned) and jmp [rip+0]
+		const std::span<std::uint8_t> farCode(pFar, 256);
+		CHECK(Emitter(farCode).JmpRel32(callee).Failed());
+		CHECK(!Emitter(farCode).Push(Register::Rbx).Call(callee).Pop(Register::Rbx).Ret().Failed());
+		CHECK(Run(pFar) == 1234);
+		CHECK(Emitter(farCode).Jmp(callee).Size() == Emitter::absJmpSize);
+		CHECK(Run(pFar) == 1234);
+
+		munmap(pNear, sysconf(_SC_PAGESIZE));
+		munmap(pFar, sysconf(_SC_PAGESIZE));
+	}
+
+	// The mem:: wrappers refuse to patch what the emitter can't encode
+	void Wrappers()
+	{
+		std::uint8_t* pPage = MapExecutable(0);
+		CHECK(pPage);
+		if (!pPage) return;
+
+		const auto callee = reinterpret_cast<std::uintptr_t>(&Callee);
+		CHECK(mem::AbsoluteJump(pPage, &callee) && Run(pPage) == 1234);
+
+		const auto relative = mem::detail::RelativeJumpBytes(static_cast<std::uintptr_t>(-0x100));
+		CHECK(Equals(relative, { 0xE9, 0x00, 0xFF, 0xFF, 0xFF }));
+		CHECK(mem::detail::RelativeJumpBytes(std::uintptr_t{ 1 } << 32).empty());
+
+		std::memset(pPage, 0xCC, 16);
+		CHECK(!mem::RelativeJump(pPage, std::uintptr_t{ 1 } << 32));
+		CHECK(pPage[0] == 0xCC && pPage[4] == 0xCC);
+
+		munmap(pPage, sysconf(_SC_PAGESIZE));
+	}
+}
+
+int main()
+{
+	Encodings();
+	Execution();
+	Wrappers();
+	return test::Result();
+}
@@ -0,0 +1,128 @@
+﻿#pragma once
+// PE32 / PE32+ images built in memory for the tools/*test.cpp programs, as the file on disk and as the loader would map it
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <span>
+#include <string_view>
+#include <vector>
+#include <windows.h>
+
+namespace fakepe
+{
+	constexpr DWORD fileAlignment = 0x200;
+	constexpr DWORD sectionAlignment = 0x1000;
+	constexpr DWORD headersSize = 0x400;
+
+	struct Section
+	{
+		std::string_view name;
+		DWORD characteristics;
+		std::vector<std::uint8_t> data;
+		DWORD virtualSize = 0;	// 0: the data size, more for an uninitialized tail
+	};
+
+	struct Image
+	{
+		std::vector<std::uint8_t> file;
+		std::vector<std::uint8_t> mapped;	// SizeOfImage bytes, sections at their RVA
+	};
+
+	constexpr DWORD Align(const DWORD value, const DWORD alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	// Sections are laid out in order from RVA 0x1000, each on its own page
+	inline Image Build(const bool bIs64, const std::span<const Section> sections, const DWORD timeDateStamp = 0x5F000000, const DWORD checkSum = 0)
+	{
+		IMAGE_DOS_HEADER dosHeader{};
+		dosHeader.e_magic = IMAGE_DOS_SIGNATURE;
+		dosHeader.e_lfanew = 0x80;
+
+		IMAGE_FILE_HEADER fileHeader{};
+		fileHeader.Machine = bIs64 ? IMAGE_FILE_MACHINE_AMD64 : IMAGE_FILE_MACHINE_I386;
+		fileHeader.NumberOfSections = static_cast<WORD>(sections.size());
+		fileHeader.TimeDateStamp = timeDateStamp;
+		fileHeader.SizeOfOptionalHeader = static_cast<WORD>(bIs64 ? sizeof(IMAGE_OPTIONAL_HEADER64) : sizeof(IMAGE_OPTIONAL_HEADER32));
+
+		std::vector<IMAGE_SECTION_HEADER> headers(sections.size());
+		DWORD rva = sectionAlignment;
+		DWORD rawPointer = headersSize;
+		for (size_t i = 0; i < sections.size(); i++)
+		{
+			auto& header = headers[i];
+			std::memcpy(header.Name, sections[i].name.data(), std::min<size_t>(sections[i].name.size(), sizeof(header.Name)));
+			header.Misc.VirtualSize = sections[i].virtualSize ? sections[i].virtualSize : static_cast<DWORD>(sections[i].data.size());
+			header.VirtualAddress = rva;
+			header.SizeOfRawData = Align(static_cast<DWORD>(sections[i].data.size()), fileAlignment);
+			header.PointerToRawData = header.SizeOfRawData ? rawPointer : 0;
+			header.Characteristics = sections[i].characteristics;
+			rva += Align(std::max<DWORD>(header.Misc.VirtualSize, 1), sectionAlignment);
+			rawPointer += header.SizeOfRawData;
+		}
+		const DWORD sizeOfImage = rva;
+
+		Image image;
+		image.file.resize(rawPointer);
+		std::memcpy(image.file.data(), &dosHeader, sizeof(dosHeader));
+
+		BYTE* pNtHeaders = image.file.data() + dosHeader.e_lfanew;
+		const DWORD signature = IMAGE_NT_SIGNATURE;
+		std::memcpy(pNtHeaders, &signature, sizeof(signature));
+		std::memcpy(pNtHeaders + sizeof(signature), &fileHeader, sizeof(fileHeader));
+
+		const auto fillOptionalHeader = [&](auto optionalHeader)
+		{
+			optionalHeader.Magic = bIs64 ? IMAGE_NT_OPTIONAL_HDR64_MAGIC : IMAGE_NT_OPTIONAL_HDR32_MAGIC;
+			optionalHeader.ImageBase = static_cast<decltype(optionalHeader.ImageBase)>(bIs64 ? 0x140000000 : 0x400000);
+			optionalHeader.SectionAlignment = sectionAlignment;
+			optionalHeader.FileAlignment = fileAlignment;
+			optionalHeader.SizeOfImage = sizeOfImage;
+			optionalHeader.SizeOfHeaders = headersSize;
+			optionalHeader.CheckSum = checkSum;
+			optionalHeader.NumberOfRvaAndSizes = IMAGE_NUMBEROF_DIRECTORY_ENTRIES;
+			std::memcpy(pNtHeaders + sizeof(signature) + sizeof(fileHeader), &optionalHeader, sizeof(optionalHeader));
+		};
+		if (bIs64) fillOptionalHeader(IMAGE_OPTIONAL_HEADER64{});
+		else fillOptionalHeader(IMAGE_OPTIONAL_HEADER32{});
+
+		std::memcpy(pNtHeaders + sizeof(signature) + sizeof(fileHeader) + fileHeader.SizeOfOptionalHeader, headers.data(), headers.size() * sizeof(IMAGE_SECTION_HEADER));
+
+		image.mapped.assign(sizeOfImage, 0);
+		std::memcpy(image.mapped.data(), image.file.data(), headersSize);
+		for (size_t i = 0; i < sections.size(); i++)
+		{
+			std::ranges::copy(sections[i].data, image.file.begin() + headers[i].PointerToRawData);
+			std::ranges::copy(sections[i].data, image.mapped.begin() + headers[i].VirtualAddress);
+		}
+		return image;
+	}
+
+	// Points a data directory at an RVA, in both layouts (the directory content is up to the sections)
+	inline void SetDataDirectory(Image& image, const DWORD index, const DWORD rva, const DWORD size)
+	{
+		for (auto* pBytes : { &image.file, &image.mapped })
+		{
+			BYTE* pNtHeaders = pBytes->data() + reinterpret_cast<const IMAGE_DOS_HEADER*>(pBytes->data())->e_lfanew;
+			const bool bIs64 = reinterpret_cast<const IMAGE_NT_HEADERS32*>(pNtHeaders)->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC;
+			auto& directory = bIs64 ? reinterpret_cast<IMAGE_NT_HEADERS64*>(pNtHeaders)->OptionalHeader.DataDirectory[index] : reinterpret_cast<IMAGE_NT_HEADERS32*>(pNtHeaders)->OptionalHeader.DataDirectory[index];
+			directory = { rva, size };
+		}
+	}
+
+	inline bool SaveFile(const std::filesystem::path& path, const std::span<const std::uint8_t> bytes)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		return static_cast<bool>(file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size())));
+	}
+
+	inline std::vector<std::uint8_t> LoadFile(const std::filesystem::path& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		return { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+	}
+}
@@ -0,0 +1,232 @@
+﻿// mem::PatchTransaction page grouping against mprotect: runs of consecutive pages unprotected in one call, split where the
+// protection changes, and aborted commits that write nothing. Linux: make -C tools test
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <utility>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "Mem/patch.h"
+#include "Mem/region.h"
+#include "test.h"
+
+namespace
+{
+	const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+	// The mprotect backend, with the ranges it was asked to unprotect recorded and one address refused
+	class RecordingProtector final : public mem::PageProtector
+	{
+	public:
+		std::vector<std::pair<std::uintptr_t, size_t>> unprotected;
+		size_t calls = 0;
+		std::uintptr_t refused = 0;
+
+		size_t Unprotect(const std::uintptr_t address, const size_t size, std::uint32_t& previous) override
+		{
+			calls++;
+			if (address == refused) return 0;
+
+			const size_t nSize = backend.Unprotect(address, size, previous);
+			if (nSize) unprotected.emplace_back(address, nSize);
+			return nSize;
+		}
+
+		bool Restore(const std::uintptr_t address, const size_t size, const std::uint32_t previous) override
+		{
+			calls++;
+			return backend.Restore(address, size, previous);
+		}
+
+	private:
+		mem::PageProtector& backend = mem::PageProtector::Default();
+	};
+
+	std::uint8_t* MapPages(const size_t nPages, const int protection)
+	{
+		void* p = mmap(nullptr, nPages * pageSize, protection, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		mem::RegionProvider::Default().Invalidate();
+		return p == MAP_FAILED ? nullptr : static_cast<std::uint8_t*>(p);
+	}
+
+	std::optional<mem::RegionAccess> AccessOf(const std::uint8_t* p)
+	{
+		mem::RegionProvider::Default().Invalidate();
+		const auto region = mem::RegionProvider::Default().Find(reinterpret_cast<std::uintptr_t>(p));
+		return region ? std::optional(region->access) : std::nullopt;
+	}
+
+	bool IsProtectedCode(const std::uint8_t* p)
+	{
+		const auto access = AccessOf(p);
+		return access && mem::HasAccess(*access, mem::RegionAccess::Execute) && !mem::HasAccess(*access, mem::RegionAccess::Write);
+	}
+
+	bool IsZero(const std::uint8_t* p, const size_t nSize)
+	{
+		for (size_t i = 0; i < nSize; i++) if (p[i]) return false;
+		return true;
+	}
+
+	// 42 writes over 4 consecutive pages, one of them across a page boundary: a single run
+	void OneRun()
+	{
+		std::uint8_t* p = MapPages(4, PROT_READ | PROT_EXEC);
+		CHECK(p);
+		if (!p) return;
+
+		RecordingProtector protector;
+		mem::PatchTransaction transaction(protector);
+		for (std::uint64_t i = 0; i < 20; i++) transaction.Write(p + i * 8, i + 1);
+		for (std::uint64_t i = 0; i < 20; i++) transaction.Write(p + pageSize + i * 8, i + 1);
+		std::uint8_t straddle[16];
+		memset(straddle, 0xAB, sizeof(straddle));
+		transaction.Write(p + 3 * pageSize - 8, straddle, sizeof(straddle));
+		transaction.Write(p + 8, std::uint64_t{ ~0ull });	// Over the second write
+
+		CHECK(transaction.Commit());
+		const auto& stats = transaction.GetStats();
+		CHECK(stats.writes == 42 && stats.pages == 4 && stats.runs == 1);
+		CHECK(stats.syscalls == 2 && protector.calls == 2);
+		CHECK(stats.naiveSyscalls == 84 && transaction.SyscallsSaved() == 82);
+		CHECK(protector.unprotected.size() == 1 && protector.unprotected[0] == std::pair(reinterpret_cast<std::uintptr_t>(p), 4 * pageSize));
+
+		std::uint64_t value;
+		memcpy(&value, p + 8, sizeof(value));
+		CHECK(value == ~0ull);
+		memcpy(&value, p + pageSize + 8, sizeof(value));
+		CHECK(value == 2);
+		CHECK(p[3 * pageSize - 8] == 0xAB && p[3 * pageSize + 7] == 0xAB);
+		CHECK(IsProtectedCode(p) && IsProtectedCode(p + 3 * pageSize));
+
+		// Reverse order: the overlapped bytes go back to zero, not to the first write
+		CHECK(transaction.Rollback() && !transaction.IsCommitted());
+		CHECK(IsZero(p, 4 * pageSize));
+		CHECK(transaction.GetStats().syscalls == 4);
+		CHECK(IsProtectedCode(p));
+
+		munmap(p, 4 * pageSize);
+	}
+
+	// Writes on pages 0, 2 and 4 (each twice): three runs of one page
+	void SeparateRuns()
+	{
+		std::uint8_t* p = MapPages(5, PROT_READ | PROT_EXEC);
+		CHECK(p);
+		if (!p) return;
+
+		RecordingProtector protector;
+		mem::PatchTransaction transaction(protector);
+		for (const size_t page : { 4, 0, 2, 0, 4, 2 }) transaction.Write(p + page * pageSize + 16, static_cast<std::uint32_t>(page + 1));
+
+		CHECK(transaction.Commit());
+		const auto& stats = transaction.GetStats();
+		CHECK(stats.pages == 3 && stats.runs == 3 && stats.syscalls == 6);
+		CHECK(protector.unprotected.size() == 3);
+		for (size_t i = 0; i < protector.unprotected.size(); i++)
+		{
+			CHECK(protector.unprotected[i] == std::pair(reinterpret_cast<std::uintptr_t>(p + 2 * i * pageSize), pageSize));
+		}
+		CHECK(p[16] == 1 && p[2 * pageSize + 16] == 3 && p[4 * pageSize + 16] == 5);
+		CHECK(IsZero(p + pageSize, pageSize) && IsZero(p + 3 * pageSize, pageSize));
+
+		munmap(p, 5 * pageSize);
+	}
+
+	// Consecutive pages with different protections: the run is split, each part restored to its own protection
+	void MixedProtection()
+	{
+		std::uint8_t* p = MapPages(3, PROT_READ | PROT_EXEC);
+		CHECK(p);
+		if (!p) return;
+		mprotect(p + pageSize, pageSize, PROT_READ);
+		mem::RegionProvider::Default().Invalidate();
+
+		RecordingProtector protector;
+		mem::PatchTransaction transaction(protector);
+		std::uint8_t bytes[3 * 4096];
+		memset(bytes, 0x5A, sizeof(bytes));
+		transaction.Write(p + 8, bytes, 3 * pageSize - 16);
+
+		CHECK(transaction.Commit());
+		CHECK(transaction.GetStats().pages == 3 && transaction.GetStats().runs == 3 && transaction.GetStats().syscalls == 6);
+		CHECK(p[8] == 0x5A && p[3 * pageSize - 9] == 0x5A);
+		CHECK(IsProtectedCode(p) && IsProtectedCode(p + 2 * pageSize));
+
+		const auto middle = AccessOf(p + pageSize);
+		CHECK(middle && *middle == mem::RegionAccess::Read);
+
+		munmap(p, 3 * pageSize);
+	}
+
+	// A writable page (heap vtable, RW import table) next to a code page: only the code page changes protection, the data page
+	// doesn't become executable
+	void WritablePage()
+	{
+		std::uint8_t* p = MapPages(2, PROT_READ | PROT_EXEC);
+		CHECK(p);
+		if (!p) return;
+		mprotect(p + pageSize, pageSize, PROT_READ | PROT_WRITE);
+		mem::RegionProvider::Default().Invalidate();
+
+		RecordingProtector protector;
+		mem::PatchTransaction transaction(protector);
+		transaction.Write(p + pageSize + 8, std::uint64_t{ 7 });
+		CHECK(transaction.Commit());
+		CHECK(transaction.GetStats().syscalls == 0 && transaction.GetStats().runs == 0 && protector.calls == 1);
+		CHECK(p[pageSize + 8] == 7);
+		CHECK(transaction.Rollback() && p[pageSize + 8] == 0 && transaction.GetStats().syscalls == 0);
+
+		mem::PatchTransaction mixed(protector);
+		mixed.Write(p + pageSize - 4, std::uint64_t{ ~0ull });
+		CHECK(mixed.Commit());
+		CHECK(mixed.GetStats().pages == 2 && mixed.GetStats().runs == 1 && mixed.GetStats().syscalls == 2);
+		CHECK(p[pageSize - 4] == 0xFF && p[pageSize + 3] == 0xFF);
+		CHECK(IsProtectedCode(p));
+
+		const auto access = AccessOf(p + pageSize);
+		CHECK(access && *access == (mem::RegionAccess::Read | mem::RegionAccess::Write));
+
+		munmap(p, 2 * pageSize);
+	}
+
+	// The third page can't be unprotected: nothing is written and the first run gets its protection back
+	void RefusedPage()
+	{
+		std::uint8_t* p = MapPages(3, PROT_READ | PROT_EXEC);
+		CHECK(p);
+		if (!p) return;
+
+		RecordingProtector protector;
+		protector.refused = reinterpret_cast<std::uintptr_t>(p + 2 * pageSize);
+		mem::PatchTransaction transaction(protector);
+		transaction.Write(p, std::uint32_t{ 5 });
+		transaction.Write(p + 2 * pageSize, std::uint32_t{ 6 });
+
+		CHECK(!transaction.Commit() && !transaction.IsCommitted());
+		CHECK(p[0] == 0 && p[2 * pageSize] == 0);
+		CHECK(protector.calls == 3);	// Page 0 unprotected, page 2 refused, page 0 restored
+		CHECK(IsProtectedCode(p));
+		CHECK(!transaction.Rollback());
+
+		munmap(p, 3 * pageSize);
+	}
+}
+
+int main()
+{
+	if (pageSize != 4096)
+	{
+		std::puts("skipped: 4 KB pages expected");
+		return 0;
+	}
+
+	OneRun();
+	SeparateRuns();
+	MixedProtection();
+	WritablePage();
+	RefusedPage();
+	return test::Result();
+}
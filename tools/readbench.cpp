@@ -0,0 +1,85 @@
+﻿// Reads per second of mem::SafeRead against fault-based probing (SIGSEGV handler + siglongjmp, the Linux equivalent of FindDMAAddy's __try),
+// on readable memory, on an unmapped page and on a mix of both. Linux only: make -C tools build/readbench
+#include <chrono>
+#include <csetjmp>
+#include <csignal>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "Mem/saferead.h"
+
+namespace
+{
+	sigjmp_buf probeJump;
+
+	void OnFault(int)
+	{
+		siglongjmp(probeJump, 1);
+	}
+
+	bool ProbeRead(const std::uintptr_t address, std::uint64_t& value)
+	{
+		if (sigsetjmp(probeJump, 1)) return false;
+		value = *reinterpret_cast<const volatile std::uint64_t*>(address);
+		return true;
+	}
+
+	template<typename Read>
+	void Run(const char* name, const std::vector<std::uintptr_t>& addresses, Read&& read)
+	{
+		std::uint64_t sum = 0;
+		size_t nFailed = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (const std::uintptr_t address : addresses)
+		{
+			std::uint64_t value = 0;
+			if (read(address, value)) sum += value;
+			else nFailed++;
+		}
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::printf("  %-10s %12.0f reads/s  (%zu failed, checksum %llx)\n", name, addresses.size() / seconds, nFailed, static_cast<unsigned long long>(sum));
+	}
+}
+
+int main()
+{
+	struct sigaction action{};
+	action.sa_handler = OnFault;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGSEGV, &action, nullptr);
+	sigaction(SIGBUS, &action, nullptr);
+
+	std::vector<std::uint64_t> heap(1 << 20, 1);
+	const long pageSize = sysconf(_SC_PAGESIZE);
+	void* pUnmapped = mmap(nullptr, pageSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	munmap(pUnmapped, pageSize);
+
+	std::mt19937_64 rng(42);
+	const auto readable = [&] { return reinterpret_cast<std::uintptr_t>(&heap[rng() % heap.size()]); };
+	const auto unmapped = [&] { return reinterpret_cast<std::uintptr_t>(pUnmapped) + (rng() % (pageSize / 8)) * 8; };
+
+	const struct
+	{
+		const char* name;
+		size_t count;
+		double invalidRatio;
+	} cases[] = { { "readable", 10'000'000, 0.0 }, { "unmapped", 200'000, 1.0 }, { "1% unmapped", 2'000'000, 0.01 } };
+
+	mem::SafeReader reader;
+	for (const auto& test : cases)
+	{
+		std::vector<std::uintptr_t> addresses(test.count);
+		std::bernoulli_distribution invalid(test.invalidRatio);
+		for (auto& address : addresses) address = invalid(rng) ? unmapped() : readable();
+
+		std::printf("%s:\n", test.name);
+		Run("SafeRead", addresses, [&](const std::uintptr_t address, std::uint64_t& value) { return reader.ReadBuffer(address, &value, sizeof(value)); });
+		Run("probe", addresses, ProbeRead);
+	}
+
+	const auto& stats = reader.GetStats();
+	std::printf("SafeRead: %zu direct, %zu refreshes, %zu system reads, %zu failures\n", stats.direct, stats.refreshes, stats.system, stats.failures);
+}
@@ -0,0 +1,71 @@
+﻿// Throughput (GB/s) of mem::detail::FindPattern per kernel against a first/last byte loop (the scan before the anchored kernels),
+// for every signature of src/signatures.h planted at the end of a synthetic code-like buffer. make -C tools build/scanbench
+#include <cstdio>
+#include <cstdlib>
+
+#include "Mem/mem.h"
+#include "../src/signatures.h"
+#include "bench.h"
+
+namespace
+{
+	// First and last byte checked before the full compare, no anchors and no SIMD
+	const BYTE* FirstLastScan(const BYTE* pBase, const size_t nSize, const mem::SignatureView& signature)
+	{
+		const size_t end = signature.size - 1;
+		for (size_t n = 0; n + signature.size <= nSize; n++)
+		{
+			if ((pBase[n] & signature.mask[0]) != signature.bytes[0] || (pBase[n + end] & signature.mask[end]) != signature.bytes[end]) continue;
+
+			size_t i = 1;
+			while (i < end && (pBase[n + i] & signature.mask[i]) == signature.bytes[i]) i++;
+			if (i >= end) return pBase + n;
+		}
+		return nullptr;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	using mem::detail::ScanKernel;
+
+	const size_t nSize = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 128) << 20;
+	auto buffer = bench::CodeLikeBuffer(nSize);
+
+	// Each signature planted once near the end, so every scan covers almost the whole buffer
+	const size_t nSignatures = std::size(Signatures::List);
+	for (size_t i = 0; i < nSignatures; i++) bench::Plant(buffer, nSize - (nSignatures - i) * 256, Signatures::List[i].signature);
+
+	const struct
+	{
+		const char* name;
+		ScanKernel kernel;
+	} kernels[] = { { "scalar", ScanKernel::Scalar }, { "SSE2", ScanKernel::SSE2 }, { "AVX2", ScanKernel::AVX2 }, { "auto", ScanKernel::Auto } };
+
+	std::printf("%zu MB, GB/s:\n%-44s %5s %10s", nSize >> 20, "signature", "size", "first/last");
+	for (const auto& kernel : kernels) std::printf(" %8s", kernel.name);
+	std::printf("\n");
+
+	bool bSame = true;
+	for (const auto& entry : Signatures::List)
+	{
+		const BYTE* pExpected = nullptr;
+		const double reference = bench::Time([&] { pExpected = FirstLastScan(buffer.data(), nSize, entry.signature); }, 1);
+		std::printf("%-44s %5zu %10.2f", entry.name, entry.signature.size, bench::GBps(pExpected - buffer.data(), reference));
+
+		for (const auto& kernel : kernels)
+		{
+			const BYTE* pMatch = nullptr;
+			const double seconds = bench::Time([&] { pMatch = mem::detail::FindPattern(buffer.data(), nSize, entry.signature, false, kernel.kernel); });
+			std::printf(" %8.2f", bench::GBps(pExpected - buffer.data(), seconds));
+			if (pMatch != pExpected)
+			{
+				std::printf(" (mismatch)");
+				bSame = false;
+			}
+		}
+		std::printf("\n");
+	}
+	std::printf(bSame ? "all kernels found the same matches\n" : "kernels disagree\n");
+	return bSame ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+﻿// mem::PEView section filtering on PE files loaded from disk: a PE32+ and a PE32 image written to a temporary file and read back
+// (file layout), the same image as the loader maps it, and module scans limited to code or read-only data.
+// PE files given as arguments are checked too (every range of a filter is the data of matching sections). make -C tools test
+#include <cstdio>
+#include <unistd.h>
+
+#include "Mem/mem.h"
+#include "fakepe.h"
+#include "test.h"
+
+namespace
+{
+	constexpr DWORD code = IMAGE_SCN_CNT_CODE | IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_MEM_READ;
+	constexpr DWORD readOnlyData = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ;
+	constexpr DWORD data = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_WRITE;
+	constexpr DWORD relocations = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_DISCARDABLE;
+
+	constexpr mem::Signature codePattern = "48 8B 05 ?? ?? ?? ?? 48 85 C0 74";
+	constexpr mem::Signature stringPattern = "73 65 63 74 69 6F 6E 74 65 73 74";	// "sectiontest"
+
+	std::vector<std::uint8_t> Filled(const size_t nSize, const std::uint8_t value)
+	{
+		return std::vector<std::uint8_t>(nSize, value);
+	}
+
+	// .text + .init (adjacent code), .rdata, .data with an uninitialized tail, .reloc. Both patterns are planted in every section.
+	fakepe::Image BuildImage(const bool bIs64)
+	{
+		std::vector<fakepe::Section> sections = {
+			{ ".text", code, Filled(0x2000, 0xCC) },
+			{ ".init", code, Filled(0x600, 0xCC) },
+			{ ".rdata", readOnlyData, Filled(0x1000, 0x00) },
+			{ ".data", data, Filled(0x200, 0x00), 0x3000 },
+			{ ".reloc", relocations, Filled(0x100, 0x00) },
+		};
+		for (auto& section : sections)
+		{
+			std::ranges::copy(std::span(stringPattern.bytes, stringPattern.size), section.data.begin() + 0x10);
+			std::ranges::copy(std::span(codePattern.bytes, codePattern.size), section.data.begin() + 0x80);
+		}
+		return fakepe::Build(bIs64, sections);
+	}
+
+	bool Same(const std::vector<std::span<const BYTE>>& ranges, const std::vector<std::pair<size_t, size_t>>& expected, const BYTE* pBase)
+	{
+		if (ranges.size() != expected.size()) return false;
+		for (size_t i = 0; i < ranges.size(); i++)
+		{
+			if (static_cast<size_t>(ranges[i].data() - pBase) != expected[i].first || ranges[i].size() != expected[i].second) return false;
+		}
+		return true;
+	}
+
+	void FileLayout(const bool bIs64)
+	{
+		const auto path = std::filesystem::temp_directory_path() / ("sectiontest_" + std::to_string(getpid()) + (bIs64 ? "_64.exe" : "_32.exe"));
+		CHECK(fakepe::SaveFile(path, BuildImage(bIs64).file));
+		const auto file = fakepe::LoadFile(path);
+		std::filesystem::remove(path);
+
+		const mem::PEView image(file.data(), file.size(), mem::ImageLayout::File);
+		CHECK(image.IsValid() && image.Is64() == bIs64 && image.Sections().size() == 5);
+		if (!image.IsValid()) return;
+
+		// Raw data: .text at 0x400, .init right after, then .rdata 0x2A00, .data 0x3A00 (0x200 on disk), .reloc 0x3C00
+		CHECK(Same(image.SectionRanges(mem::SectionFilter::Code), { { 0x400, 0x2600 } }, file.data()));
+		CHECK(Same(image.SectionRanges(mem::SectionFilter::ReadOnlyData), { { 0x2A00, 0x1000 } }, file.data()));
+		CHECK(Same(image.SectionRanges(mem::SectionFilter::Data), { { 0x3A00, 0x200 } }, file.data()));
+		CHECK(Same(image.SectionRanges(mem::SectionFilter::Any), { { 0x400, 0x3900 } }, file.data()));
+
+		const auto codeRanges = image.SectionRanges(mem::SectionFilter::Code);
+		CHECK(mem::detail::FindPattern(codeRanges[0].data(), codeRanges[0].size(), stringPattern, false) == file.data() + 0x410);
+		CHECK(image.PointerToRva(file.data() + 0x2A10) == 0x4010);
+		CHECK(image.RvaToPointer(0x4010) == file.data() + 0x2A10);
+		CHECK(!image.RvaToPointer(0x5000 + 0x200));	// Uninitialized part of .data
+
+		std::printf("PE%s on disk: code filter covers %zu of %zu bytes\n", bIs64 ? "32+" : "32", codeRanges[0].size(), file.size());
+	}
+
+	void MappedLayout()
+	{
+		const auto mapped = BuildImage(true).mapped;
+		const mem::PEView image(mapped.data(), mapped.size());
+		CHECK(image.IsValid() && image.SizeOfImage() == mapped.size());
+
+		// RVAs: .text 0x1000, .init 0x3000, .rdata 0x4000, .data 0x5000 (0x3000 with its tail), .reloc 0x8000
+		CHECK(Same(image.SectionRanges(mem::SectionFilter::Code), { { 0x1000, 0x2600 } }, mapped.data()));
+		CHECK(Same(image.SectionRanges(mem::SectionFilter::ReadOnlyData), { { 0x4000, 0x1000 } }, mapped.data()));
+		CHECK(Same(image.SectionRanges(mem::SectionFilter::Data), { { 0x5000, 0x3000 } }, mapped.data()));
+		CHECK(Same(image.SectionRanges(mem::SectionFilter::Any), { { 0x1000, 0x2600 }, { 0x4000, 0x4100 } }, mapped.data()));
+
+		// Module scans stay in the filtered sections: headers are skipped, the string is found in .rdata only when asked for
+		const auto hModule = const_cast<std::uint8_t*>(mapped.data());
+		CHECK(mem::PatternScan(hModule, codePattern) == hModule + 0x1080);
+		CHECK(mem::PatternScan(hModule, stringPattern) == hModule + 0x1010);
+		CHECK(mem::PatternScan(hModule, stringPattern, false, mem::SectionFilter::ReadOnlyData) == hModule + 0x4010);
+		CHECK(mem::PatternScan(hModule, codePattern, false, mem::SectionFilter::Data) == hModule + 0x5080);
+
+		size_t nCode = 0;
+		for (const auto& range : mem::detail::ModuleRanges(hModule, mem::SectionFilter::Code)) nCode += range.size();
+		CHECK(nCode == 0x2600);
+	}
+
+	// Real images: each range of a filter is inside the file and made of matching sections only
+	void CheckFile(const char* path)
+	{
+		const auto file = fakepe::LoadFile(path);
+		const mem::PEView image(file.data(), file.size(), mem::ImageLayout::File);
+		CHECK(image.IsValid());
+		if (!image.IsValid()) return;
+
+		for (const auto& filter : { mem::SectionFilter::Code, mem::SectionFilter::ReadOnlyData, mem::SectionFilter::Data })
+		{
+			size_t nFiltered = 0, nExpected = 0;
+			for (const auto& range : image.SectionRanges(filter))
+			{
+				CHECK(range.data() >= file.data() && range.data() + range.size() <= file.data() + file.size());
+				nFiltered += range.size();
+			}
+			for (const auto& section : image.Sections())
+			{
+				if (filter.Matches(section.Characteristics)) nExpected += image.SectionData(section).size();
+			}
+			CHECK(nFiltered == nExpected);
+		}
+
+		size_t nCode = 0;
+		for (const auto& range : image.SectionRanges(mem::SectionFilter::Code)) nCode += range.size();
+		std::printf("%s: PE%s, %zu sections, code filter covers %zu of %zu bytes (%.0f%%)\n", path, image.Is64() ? "32+" : "32", image.Sections().size(), nCode, file.size(), 100.0 * nCode / file.size());
+	}
+}
+
+int main(int argc, char** argv)
+{
+	FileLayout(true);
+	FileLayout(false);
+	MappedLayout();
+	for (int i = 1; i < argc; i++) CheckFile(argv[i]);
+	return test::Result();
+}
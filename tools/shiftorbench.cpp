@@ -0,0 +1,73 @@
+﻿// Shift-or against the anchored kernels of mem::detail::FindPattern, for the 53-byte x86 Steam present pattern and a short one, as the
+// anchor pair false hits get denser (pair planted every k bytes without the rest of the pattern). The crossover is where shift-or
+// overtakes the SIMD kernel; "auto" shows what PreferShiftOr picks. make -C tools build/shiftorbench [MB]
+#include <cstdio>
+#include <cstdlib>
+
+#include "Mem/mem.h"
+#include "../src/signatures.h"
+#include "bench.h"
+
+int main(int argc, char** argv)
+{
+	using mem::detail::ScanKernel;
+
+	const size_t nSize = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 64) << 20;
+	const auto base = bench::CodeLikeBuffer(nSize);
+
+	const struct
+	{
+		const char* name;
+		mem::SignatureView signature;
+	} patterns[] = { { "Steam::x86::d3d_present_pattern", Signatures::Steam::x86::d3d_present_pattern }, { "Steam::x64::d3d_present_pattern", Signatures::Steam::x64::d3d_present_pattern } };
+
+	const struct
+	{
+		const char* name;
+		ScanKernel kernel;
+	} kernels[] = { { "scalar", ScanKernel::Scalar }, { "SIMD", ScanKernel::AVX2 }, { "shift-or", ScanKernel::ShiftOr }, { "auto", ScanKernel::Auto } };
+
+	bool bSame = true;
+	for (const auto& pattern : patterns)
+	{
+		const auto& signature = pattern.signature;
+		std::printf("%s (%zu bytes), %zu MB, GB/s:\n%12s", pattern.name, signature.size, nSize >> 20, "false hits");
+		for (const auto& kernel : kernels) std::printf(" %9s", kernel.name);
+		std::printf("\n");
+
+		for (const size_t stride : { size_t{ 0 }, size_t{ 1024 }, size_t{ 256 }, size_t{ 128 }, size_t{ 64 }, size_t{ 32 }, size_t{ 24 }, size_t{ 16 }, size_t{ 12 }, size_t{ 8 } })
+		{
+			auto buffer = base;
+			if (stride)
+			{
+				for (size_t n = 0; n + signature.size < nSize; n += stride)
+				{
+					buffer[n + signature.anchor] = signature.bytes[signature.anchor];
+					buffer[n + signature.secondAnchor] = signature.bytes[signature.secondAnchor];
+				}
+			}
+			bench::Plant(buffer, nSize - 4096, signature);
+
+			if (stride) std::printf("%6s1/%-4zu", "", stride);
+			else std::printf("%12s", "none");
+
+			const BYTE* pExpected = nullptr;
+			for (const auto& kernel : kernels)
+			{
+				const BYTE* pMatch = nullptr;
+				const double seconds = bench::Time([&] { pMatch = mem::detail::FindPattern(buffer.data(), nSize, signature, false, kernel.kernel); });
+				if (!pExpected) pExpected = pMatch;
+
+				std::printf(" %9.2f", bench::GBps(pExpected - buffer.data(), seconds));
+				if (pMatch != pExpected)
+				{
+					std::printf(" (mismatch)");
+					bSame = false;
+				}
+			}
+			std::printf("\n");
+		}
+	}
+	std::printf(bSame ? "all kernels found the same matches\n" : "kernels disagree\n");
+	return bSame ? 0 : 1;
+}
@@ -0,0 +1,233 @@
+﻿// mem::SignatureCache over fake module buffers: fingerprints, cold and warm lookups, validation of the pattern bytes at the cached
+// RVA, updated builds, the file format round trip and precomputed results. make -C tools test
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+#include "Mem/sigcache.h"
+#include "fakepe.h"
+#include "test.h"
+
+namespace
+{
+	constexpr DWORD code = IMAGE_SCN_CNT_CODE | IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_MEM_READ;
+	constexpr DWORD data = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_WRITE;
+
+	constexpr mem::Signature present = "48 8B 05 ?? ?? ?? ?? 44 8B C5 8B D6";
+	constexpr mem::Signature resize = "55 41 ?? 56 57 53 48 83 EC";
+	constexpr DWORD presentRva = 0x1000 + 0x1234;
+	constexpr DWORD resizeRva = 0x1000 + 0x2F00;
+
+	// .text (12 KB) with both patterns planted, .data. The build number goes in TimeDateStamp, codeByte fills .text.
+	fakepe::Image BuildModule(const DWORD build, const std::uint8_t codeByte = 0xCC)
+	{
+		std::vector<std::uint8_t> text(0x3000, codeByte);
+		for (const auto& [signature, rva] : { std::pair{ present.view(), presentRva }, { resize.view(), resizeRva } })
+		{
+			for (size_t i = 0; i < signature.size; i++) text[rva - 0x1000 + i] = signature.mask[i] ? signature.bytes[i] : 0x11;
+		}
+		const fakepe::Section sections[] = { { ".text", code, std::move(text) }, { ".data", data, std::vector<std::uint8_t>(0x200, 0) } };
+		return fakepe::Build(true, sections, build, 0xABCD);
+	}
+
+	const BYTE* Scan(const mem::PEView& image, const mem::SignatureView& signature)
+	{
+		for (const auto& range : image.SectionRanges(mem::SectionFilter::Code))
+		{
+			if (const BYTE* pMatch = mem::detail::FindPattern(range.data(), range.size(), signature, false)) return pMatch;
+		}
+		return nullptr;
+	}
+
+	void Fingerprints()
+	{
+		const auto module = BuildModule(1);
+		const auto fingerprint = mem::ModuleFingerprint::FromImage(mem::PEView(module.mapped.data(), module.mapped.size()));
+		CHECK(fingerprint.timeDateStamp == 1 && fingerprint.checkSum == 0xABCD && fingerprint.sizeOfImage == 0x5000);
+
+		// Same build on disk and mapped
+		CHECK(mem::ModuleFingerprint::FromImage(mem::PEView(module.file.data(), module.file.size(), mem::ImageLayout::File)) == fingerprint);
+
+		const auto rebuilt = BuildModule(2);
+		CHECK(mem::ModuleFingerprint::FromImage(mem::PEView(rebuilt.mapped.data(), rebuilt.mapped.size())) != fingerprint);
+
+		// Same headers, other code
+		const auto patched = BuildModule(1, 0x90);
+		const auto patchedFingerprint = mem::ModuleFingerprint::FromImage(mem::PEView(patched.mapped.data(), patched.mapped.size()));
+		CHECK(patchedFingerprint.timeDateStamp == 1 && patchedFingerprint.codeHash != fingerprint.codeHash);
+
+		CHECK(mem::HashSignature(present) != mem::HashSignature(resize));
+	}
+
+	// x86 image with absolute addresses in sampled code, rebased by 0x10000 the way the loader would under ASLR
+	void RebasedImage()
+	{
+		constexpr DWORD imageBase = 0x400000;
+		constexpr DWORD delta = 0x10000;
+		constexpr DWORD fixups[] = { 0x1010, 0x1038, 0x203E, 0x3000, 0x3800 };	// 0x203E: 2 bytes at the end of a sample, 2 after it
+
+		std::vector<std::uint8_t> text(0x3000, 0xCC);
+		for (const DWORD rva : fixups)
+		{
+			const DWORD address = imageBase + 0x4000 + (rva & 0xFF);
+			std::memcpy(&text[rva - 0x1000], &address, sizeof(address));
+		}
+
+		// One block per page, HIGHLOW entries, padded to a DWORD boundary with an ABSOLUTE entry
+		std::vector<std::uint8_t> reloc;
+		for (const DWORD page : { 0x1000u, 0x2000u, 0x3000u })
+		{
+			std::vector<WORD> entries;
+			for (const DWORD rva : fixups) if ((rva & ~0xFFFu) == page) entries.push_back(static_cast<WORD>(IMAGE_REL_BASED_HIGHLOW << 12 | (rva & 0xFFF)));
+			if (entries.size() % 2) entries.push_back(IMAGE_REL_BASED_ABSOLUTE << 12);
+
+			const IMAGE_BASE_RELOCATION block{ page, static_cast<DWORD>(sizeof(IMAGE_BASE_RELOCATION) + entries.size() * sizeof(WORD)) };
+			const auto pBlock = reinterpret_cast<const std::uint8_t*>(&block);
+			reloc.insert(reloc.end(), pBlock, pBlock + sizeof(block));
+			const auto pEntries = reinterpret_cast<const std::uint8_t*>(entries.data());
+			reloc.insert(reloc.end(), pEntries, pEntries + entries.size() * sizeof(WORD));
+		}
+		const DWORD relocSize = static_cast<DWORD>(reloc.size());
+
+		constexpr DWORD relocations = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_DISCARDABLE;
+		const fakepe::Section sections[] = { { ".text", code, std::move(text) }, { ".data", data, std::vector<std::uint8_t>(0x200, 0) }, { ".reloc", relocations, std::move(reloc) } };
+		auto module = fakepe::Build(false, sections, 7, 0x1234);
+		fakepe::SetDataDirectory(module, IMAGE_DIRECTORY_ENTRY_BASERELOC, 0x5000, relocSize);
+
+		auto rebased = module.mapped;
+		for (const DWORD rva : fixups)
+		{
+			DWORD address;
+			std::memcpy(&address, &rebased[rva], sizeof(address));
+			address += delta;
+			std::memcpy(&rebased[rva], &address, sizeof(address));
+		}
+		CHECK(!std::ranges::equal(rebased, module.mapped));
+
+		const mem::PEView file(module.file.data(), module.file.size(), mem::ImageLayout::File);
+		CHECK(mem::RelocationMap(file).IsRelocated(0x1010) && mem::RelocationMap(file).IsRelocated(0x3803));
+		const auto fingerprint = mem::ModuleFingerprint::FromImage(file);
+		CHECK(mem::ModuleFingerprint::FromImage(mem::PEView(rebased.data(), rebased.size())) == fingerprint);
+		CHECK(mem::ModuleFingerprint::FromImage(mem::PEView(module.mapped.data(), module.mapped.size())) == fingerprint);
+
+		// Bytes next to a fixup are still hashed
+		rebased[0x1014] = 0x90;
+		CHECK(mem::ModuleFingerprint::FromImage(mem::PEView(rebased.data(), rebased.size())) != fingerprint);
+	}
+
+	void ColdAndWarm()
+	{
+		auto module = BuildModule(1);
+		const mem::PEView image(module.mapped.data(), module.mapped.size());
+		mem::SignatureCache cache;
+
+		CHECK(!cache.Find(image, "game.exe", present));
+		const BYTE* pMatch = Scan(image, present);
+		CHECK(pMatch == module.mapped.data() + presentRva);
+		cache.Store(image, "game.exe", present, pMatch);
+		CHECK(cache.IsDirty());
+		CHECK(cache.Find(image, "game.exe", present) == pMatch);
+		CHECK(!cache.Find(image, "other.dll", present));
+		CHECK(!cache.Find(image, "game.exe", resize));
+
+		// The bytes at the cached RVA no longer match: miss, not a wrong address
+		module.mapped[presentRva] = 0x90;
+		CHECK(!cache.Find(image, "game.exe", present));
+		module.mapped[presentRva] = 0x48;
+		CHECK(cache.Find(image, "game.exe", present) == pMatch);
+
+		// Another section filter is another entry, the .text match isn't returned for a .data scan
+		CHECK(mem::HashSignature(present) != mem::HashSignature(present, mem::SectionFilter::Data));
+		CHECK(!cache.Find(image, "game.exe", present, mem::SectionFilter::Data));
+		const BYTE* pData = module.mapped.data() + 0x4000;
+		std::copy_n(present.bytes, present.size, module.mapped.begin() + 0x4000);
+		cache.Store(image, "game.exe", present, pData, mem::SectionFilter::Data);
+		CHECK(cache.Find(image, "game.exe", present, mem::SectionFilter::Data) == pData);
+		CHECK(cache.Find(image, "game.exe", present) == pMatch);
+	}
+
+	void UpdatedBuild()
+	{
+		const auto first = BuildModule(1);
+		const auto second = BuildModule(2);
+		const mem::PEView firstImage(first.mapped.data(), first.mapped.size());
+		const mem::PEView secondImage(second.mapped.data(), second.mapped.size());
+		mem::SignatureCache cache;
+
+		cache.Store(firstImage, "game.exe", present, Scan(firstImage, present));
+		cache.Store(firstImage, "game.exe", resize, Scan(firstImage, resize));
+		CHECK(!cache.Find(secondImage, "game.exe", present));
+
+		// Storing for the new build drops what was recorded for the old one
+		cache.Store(secondImage, "game.exe", present, Scan(secondImage, present));
+		CHECK(cache.Find(secondImage, "game.exe", present) == second.mapped.data() + presentRva);
+		CHECK(!cache.Find(secondImage, "game.exe", resize));
+		CHECK(!cache.Find(firstImage, "game.exe", present));
+	}
+
+	void SaveAndLoad()
+	{
+		const auto path = std::filesystem::temp_directory_path() / ("sigcachetest_" + std::to_string(getpid()) + ".bin");
+		{
+			const auto module = BuildModule(1);
+			const mem::PEView image(module.mapped.data(), module.mapped.size());
+			mem::SignatureCache cache;
+			cache.Store(image, "game.exe", present, Scan(image, present));
+			cache.Store(image, "game.exe", resize, Scan(image, resize));
+			CHECK(cache.Save(path) && !cache.IsDirty());
+		}
+
+		// Next launch: another buffer, and the file layout of the same build
+		const auto module = BuildModule(1);
+		const mem::PEView mapped(module.mapped.data(), module.mapped.size());
+		const mem::PEView file(module.file.data(), module.file.size(), mem::ImageLayout::File);
+		mem::SignatureCache cache;
+		CHECK(cache.Load(path) && !cache.IsDirty());
+		CHECK(cache.Find(mapped, "game.exe", present) == module.mapped.data() + presentRva);
+		CHECK(cache.Find(mapped, "game.exe", resize) == module.mapped.data() + resizeRva);
+		CHECK(cache.Find(file, "game.exe", resize) == file.RvaToPointer(resizeRva) && file.RvaToPointer(resizeRva));
+
+		// Bad files are refused and leave the cache as it was
+		auto bytes = fakepe::LoadFile(path);
+		bytes.resize(bytes.size() - 3);
+		CHECK(fakepe::SaveFile(path, bytes));
+		CHECK(!cache.Load(path));
+		bytes[0] ^= 0xFF;
+		CHECK(fakepe::SaveFile(path, bytes));
+		CHECK(!cache.Load(path));
+		CHECK(cache.Find(mapped, "game.exe", present));
+
+		std::filesystem::remove(path);
+		CHECK(!cache.Load(path));
+	}
+
+	void Precomputed()
+	{
+		const auto module = BuildModule(1);
+		const mem::PEView image(module.mapped.data(), module.mapped.size());
+
+		std::array<mem::ResolvedSignature, 2> signatures = { { { mem::HashSignature(present), presentRva }, { mem::HashSignature(resize), resizeRva } } };
+		std::ranges::sort(signatures, {}, &mem::ResolvedSignature::key);
+		const mem::ResolvedModule resolved[] = { { "Game.exe", mem::ModuleFingerprint::FromImage(image), signatures } };
+
+		mem::SignatureCache cache;
+		cache.SetPrecomputed(resolved);
+		CHECK(cache.Find(image, "game.exe", present) == module.mapped.data() + presentRva);
+		CHECK(cache.Find(image, "game.exe", resize) == module.mapped.data() + resizeRva);
+		CHECK(!cache.Find(image, "other.dll", present));
+
+		const auto rebuilt = BuildModule(2);
+		CHECK(!cache.Find(mem::PEView(rebuilt.mapped.data(), rebuilt.mapped.size()), "game.exe", present));
+	}
+}
+
+int main()
+{
+	Fingerprints();
+	RebasedImage();
+	ColdAndWarm();
+	UpdatedBuild();
+	SaveAndLoad();
+	Precomputed();
+	return test::Result();
+}
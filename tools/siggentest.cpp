@@ -0,0 +1,180 @@
+﻿// mem::GenerateSignature on PE files read from disk (ImageLayout::File) and the mem::x86::Decode lengths it relies on: generated
+// patterns are unique in the code sections, with RIP-relative, rel32 and in-image absolute operands as ??. PE files given as arguments
+// get signatures for addresses spread over their code, each checked for a single match at that address. make -C tools test
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Mem/mem.h"
+#include "Mem/siggen.h"
+#include "Mem/x86.h"
+#include "fakepe.h"
+#include "test.h"
+
+namespace
+{
+	constexpr DWORD code = IMAGE_SCN_CNT_CODE | IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_MEM_READ;
+	constexpr DWORD data = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_WRITE;
+
+	struct Encoding
+	{
+		const char* name;
+		bool bIs64;
+		std::vector<BYTE> bytes;
+		BYTE length;
+		BYTE dispSize = 0;
+		BYTE immSize = 0;
+		bool bRipRelative = false;
+		bool bAbsoluteMemory = false;
+	};
+
+	void DecodeLengths()
+	{
+		const Encoding encodings[] = {
+			// VEX
+			{ "vzeroupper", true, { 0xC5, 0xF8, 0x77 }, 3 },
+			{ "vmovss xmm0, [rip+disp32]", true, { 0xC5, 0xFA, 0x10, 0x05, 1, 2, 3, 4 }, 8, 4, 0, true },
+			{ "vpextrb eax, xmm0, 1", true, { 0xC4, 0xE3, 0x79, 0x14, 0xC0, 0x01 }, 6, 0, 1 },
+			{ "vbroadcastss xmm0, [rip+disp32]", true, { 0xC4, 0xE2, 0x79, 0x18, 0x05, 1, 2, 3, 4 }, 9, 4, 0, true },
+			{ "vpshufd xmm0, xmm1, 0x1B", true, { 0xC5, 0xF9, 0x70, 0xC1, 0x1B }, 5, 0, 1 },
+			{ "vzeroupper (x86)", false, { 0xC5, 0xF8, 0x77 }, 3 },
+			{ "lds eax, [disp32] (x86)", false, { 0xC5, 0x05, 1, 2, 3, 4 }, 6, 4, 0, false, true },
+			// EVEX
+			{ "vmovups zmm0, [rip+disp32]", true, { 0x62, 0xF1, 0x7C, 0x48, 0x10, 0x05, 1, 2, 3, 4 }, 10, 4, 0, true },
+			{ "vmovups zmm0, [rax+disp8]", true, { 0x62, 0xF1, 0x7C, 0x48, 0x10, 0x40, 0x01 }, 7, 1 },
+			{ "vextracti32x4 xmm1, zmm0, 1", true, { 0x62, 0xF3, 0x7D, 0x48, 0x39, 0xC1, 0x01 }, 7, 0, 1 },
+			// moffs
+			{ "mov rax, [moffs64]", true, { 0x48, 0xA1, 1, 2, 3, 4, 5, 6, 7, 8 }, 10, 8, 0, false, true },
+			{ "mov eax, [moffs32] (addr32)", true, { 0x67, 0xA1, 1, 2, 3, 4 }, 6, 4, 0, false, true },
+			{ "mov eax, [moffs32] (x86)", false, { 0xA1, 1, 2, 3, 4 }, 5, 4, 0, false, true },
+			{ "mov [moffs32], al (x86)", false, { 0xA2, 1, 2, 3, 4 }, 5, 4, 0, false, true },
+			// F6 / F7: an immediate for test only (ModRM.reg 0 or 1)
+			{ "test cl, 1", true, { 0xF6, 0xC1, 0x01 }, 3, 0, 1 },
+			{ "test ecx, imm32", true, { 0xF7, 0xC1, 1, 2, 3, 4 }, 6, 0, 4 },
+			{ "test cx, imm16", true, { 0x66, 0xF7, 0xC1, 1, 2 }, 5, 0, 2 },
+			{ "test qword [rip+disp32], imm32", true, { 0x48, 0xF7, 0x05, 1, 2, 3, 4, 5, 6, 7, 8 }, 11, 4, 4, true },
+			{ "test byte [rip+disp32], imm8", true, { 0xF6, 0x05, 1, 2, 3, 4, 0x01 }, 7, 4, 1, true },
+			{ "not ecx", true, { 0xF7, 0xD1 }, 2 },
+			{ "neg byte [rax]", true, { 0xF6, 0x18 }, 2 },
+			// Branches and immediates
+			{ "call rel32", true, { 0xE8, 1, 2, 3, 4 }, 5, 0, 4 },
+			{ "jz rel32", true, { 0x0F, 0x84, 1, 2, 3, 4 }, 6, 0, 4 },
+			{ "mov rcx, imm64", true, { 0x48, 0xB9, 1, 2, 3, 4, 5, 6, 7, 8 }, 10, 0, 8 },
+		};
+
+		for (const auto& encoding : encodings)
+		{
+			// Room after the instruction, so a wrong length isn't hidden by the end of the buffer
+			std::vector<BYTE> bytes = encoding.bytes;
+			bytes.resize(bytes.size() + 16, 0xCC);
+
+			mem::x86::Instruction instruction;
+			const bool bDecoded = mem::x86::Decode(bytes.data(), bytes.size(), encoding.bIs64, instruction);
+			const bool bSame = bDecoded && instruction.length == encoding.length && instruction.dispSize == encoding.dispSize && instruction.immSize == encoding.immSize
+				&& instruction.bRipRelative == encoding.bRipRelative && instruction.bAbsoluteMemory == encoding.bAbsoluteMemory;
+			if (!bSame) std::fprintf(stderr, "%s: length %u, disp %u, imm %u\n", encoding.name, instruction.length, instruction.dispSize, instruction.immSize);
+			CHECK(bSame);
+
+			// Cut short: the decoder refuses instead of reading past the end
+			CHECK(!mem::x86::Decode(encoding.bytes.data(), encoding.bytes.size() - 1, encoding.bIs64, instruction));
+		}
+	}
+
+	// Matches of a generated pattern in the code sections of the image
+	std::vector<const BYTE*> Matches(const mem::PEView& image, const std::string& pattern)
+	{
+		BYTE bytes[256], mask[256];
+		mem::SignatureView signature{ bytes, mask };
+		if (!mem::detail::ParsePattern(pattern, bytes, mask, signature.size)) return {};
+		mem::detail::SelectAnchors(signature);
+
+		std::vector<const BYTE*> matches;
+		for (const auto& range : image.SectionRanges(mem::SectionFilter::Code))
+		{
+			for (const BYTE* pMatch : mem::PatternScanAll(const_cast<PBYTE>(range.data()), static_cast<DWORD>(range.size()), signature)) matches.push_back(pMatch);
+		}
+		return matches;
+	}
+
+	// The instructions at 'offset' of .text, and a near copy whose operands differ and whose last instruction differs too
+	fakepe::Image BuildImage(const bool bIs64, const std::vector<BYTE>& target, const std::vector<BYTE>& copy)
+	{
+		std::vector<BYTE> text(0x2000, 0xCC);
+		std::ranges::copy(target, text.begin() + 0x100);
+		std::ranges::copy(copy, text.begin() + 0x800);
+		std::ranges::copy(copy, text.begin() + 0x1800);
+		const fakepe::Section sections[] = { { ".text", code, std::move(text) }, { ".data", data, std::vector<BYTE>(0x200, 0) } };
+		return fakepe::Build(bIs64, sections);
+	}
+
+	void Check(const bool bIs64, const std::vector<BYTE>& target, const std::vector<BYTE>& copy, const char* expected)
+	{
+		const auto module = BuildImage(bIs64, target, copy);
+		const mem::PEView image(module.file.data(), module.file.size(), mem::ImageLayout::File);
+		const BYTE* pTarget = image.RvaToPointer(0x1000 + 0x100);
+		CHECK(image.IsValid() && pTarget);
+		if (!pTarget) return;
+
+		const std::string pattern = mem::GenerateSignature(image, pTarget);
+		if (pattern != expected) std::fprintf(stderr, "generated \"%s\"\n", pattern.c_str());
+		CHECK(pattern == expected);
+
+		const auto matches = Matches(image, pattern);
+		CHECK(matches.size() == 1 && matches[0] == pTarget);
+
+		// Too short to tell the copies apart, and outside the code
+		CHECK(mem::GenerateSignature(image, pTarget, 8).empty());
+		CHECK(mem::GenerateSignature(image, image.RvaToPointer(0x3000)).empty());
+	}
+
+	void X64()
+	{
+		// mov rax, [rip+disp32]; call rel32; mov rcx, imm64 (in the image); mov eax, imm32 (not an address); ret
+		const std::vector<BYTE> target = { 0x48, 0x8B, 0x05, 0x10, 0x20, 0x00, 0x00, 0xE8, 0x44, 0x03, 0x00, 0x00, 0x48, 0xB9, 0x34, 0x12, 0x00, 0x40, 0x01, 0x00, 0x00, 0x00, 0xB8, 0x78, 0x56, 0x34, 0x12, 0xC3 };
+		const std::vector<BYTE> copy = { 0x48, 0x8B, 0x05, 0x90, 0x00, 0x00, 0x00, 0xE8, 0x00, 0xF0, 0xFF, 0xFF, 0x48, 0xB9, 0x00, 0x20, 0x00, 0x40, 0x01, 0x00, 0x00, 0x00, 0xB8, 0x21, 0x43, 0x65, 0x87, 0xC3 };
+		Check(true, target, copy, "48 8B 05 ?? ?? ?? ?? E8 ?? ?? ?? ?? 48 B9 ?? ?? ?? ?? ?? ?? ?? ?? B8 78 56 34 12");
+	}
+
+	void X86()
+	{
+		// mov eax, [moffs32]; mov ecx, [disp32]; push imm32 (in the image); push 5
+		const std::vector<BYTE> target = { 0xA1, 0x00, 0x30, 0x40, 0x00, 0x8B, 0x0D, 0x04, 0x30, 0x40, 0x00, 0x68, 0x00, 0x11, 0x40, 0x00, 0x6A, 0x05, 0xC3 };
+		const std::vector<BYTE> copy = { 0xA1, 0x10, 0x30, 0x40, 0x00, 0x8B, 0x0D, 0x14, 0x30, 0x40, 0x00, 0x68, 0x00, 0x18, 0x40, 0x00, 0x6A, 0x06, 0xC3 };
+		Check(false, target, copy, "A1 ?? ?? ?? ?? 8B 0D ?? ?? ?? ?? 68 ?? ?? ?? ?? 6A 05");
+	}
+
+	// Real images: signatures for up to 32 addresses spread over the code, every one found once, at its address
+	void CheckFile(const char* path)
+	{
+		const auto file = fakepe::LoadFile(path);
+		const mem::PEView image(file.data(), file.size(), mem::ImageLayout::File);
+		CHECK(image.IsValid());
+		if (!image.IsValid()) return;
+
+		const auto ranges = image.SectionRanges(mem::SectionFilter::Code);
+		size_t nTried = 0, nGenerated = 0;
+		for (const auto& range : ranges)
+		{
+			for (size_t offset = 0; offset < range.size() && nTried < 32; offset += std::max<size_t>(range.size() / 16, 1))
+			{
+				nTried++;
+				const std::string pattern = mem::GenerateSignature(image, range.data() + offset);
+				if (pattern.empty()) continue;	// Not an instruction boundary, or padding repeated everywhere
+
+				nGenerated++;
+				const auto matches = Matches(image, pattern);
+				CHECK(matches.size() == 1 && matches[0] == range.data() + offset);
+			}
+		}
+		std::printf("%s: %zu of %zu addresses got a unique signature\n", path, nGenerated, nTried);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	DecodeLengths();
+	X64();
+	X86();
+	for (int i = 1; i < argc; i++) CheckFile(argv[i]);
+	return test::Result();
+}
@@ -0,0 +1,190 @@
+﻿// Resolves every pattern of src/signatures.h in PE files on disk and prints src/resolved_signatures.h, so known builds need no runtime scan.
+//	sigresolve game.exe [GameOverlayRenderer64.dll ...] > src/resolved_signatures.h
+// The first file is the executable module (patterns without module), the others are matched by file name.
+// Standalone console program, built with the Mem sources by tools/Makefile on Linux (make -C tools build/sigresolve), or on Windows:
+//	cl /std:c++latest /O2 /EHsc /I include tools/sigresolve.cpp include/Mem/emitter.cpp include/Mem/mem.cpp include/Mem/pe.cpp include/Mem/region.cpp include/Mem/sigcache.cpp
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Mem/mem.h"
+#include "Mem/sigcache.h"
+#include "../src/signatures.h"
+
+namespace
+{
+	// Read-only mapping of a whole file
+	class MappedFile
+	{
+	public:
+		explicit MappedFile(const char* path)
+		{
+#ifdef _WIN32
+			hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (hFile == INVALID_HANDLE_VALUE) return;
+
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(hFile, &size) || !size.QuadPart) return;
+			hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!hMapping) return;
+
+			pData = static_cast<const BYTE*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+			if (pData) nSize = static_cast<size_t>(size.QuadPart);
+#else
+			const int fd = open(path, O_RDONLY);
+			if (fd < 0) return;
+
+			struct stat info{};
+			if (fstat(fd, &info) == 0 && info.st_size > 0)
+			{
+				if (void* pMapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0); pMapping != MAP_FAILED)
+				{
+					pData = static_cast<const BYTE*>(pMapping);
+					nSize = static_cast<size_t>(info.st_size);
+				}
+			}
+			close(fd);
+#endif
+		}
+
+		~MappedFile()
+		{
+#ifdef _WIN32
+			if (pData) UnmapViewOfFile(pData);
+			if (hMapping) CloseHandle(hMapping);
+			if (hFile != INVALID_HANDLE_VALUE) CloseHandle(hFile);
+#else
+			if (pData) munmap(const_cast<BYTE*>(pData), nSize);
+#endif
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		[[nodiscard]] const BYTE* Data() const noexcept { return pData; }
+		[[nodiscard]] size_t Size() const noexcept { return nSize; }
+
+	private:
+		const BYTE* pData = nullptr;
+		size_t nSize = 0;
+#ifdef _WIN32
+		HANDLE hFile = INVALID_HANDLE_VALUE;
+		HANDLE hMapping = nullptr;
+#endif
+	};
+
+	bool SameModule(const std::string& fileName, const char* moduleName)
+	{
+		return std::ranges::equal(fileName, std::string_view(moduleName), [](const char a, const char b) { return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b)); });
+	}
+
+	std::string Identifier(const std::string& fileName)
+	{
+		std::string identifier = fileName;
+		std::ranges::replace_if(identifier, [](const char c) { return !std::isalnum(static_cast<unsigned char>(c)); }, '_');
+		return identifier;
+	}
+}
+
+int main(const int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::fprintf(stderr, "usage: %s <executable> [module ...] > resolved_signatures.h\n", argv[0]);
+		return 1;
+	}
+
+	std::string modules;
+	std::string tables;
+	int nFailed = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const MappedFile file(argv[i]);
+		const mem::PEView image(file.Data(), file.Size(), mem::ImageLayout::File);
+		if (!image.IsValid())
+		{
+			std::fprintf(stderr, "%s: not a PE file\n", argv[i]);
+			return 1;
+		}
+
+		const std::string fileName = std::filesystem::path(argv[i]).filename().string();
+		const auto arch = image.Is64() ? Signatures::Arch::x64 : Signatures::Arch::x86;
+
+		std::vector<const Signatures::Entry*> entries;
+		std::vector<mem::SignatureView> signatures;
+		for (const auto& entry : Signatures::List)
+		{
+			if (entry.arch != Signatures::Arch::Any && entry.arch != arch) continue;
+			if (entry.module ? !SameModule(fileName, entry.module) : i != 1) continue;
+			entries.push_back(&entry);
+			signatures.push_back(entry.signature);
+		}
+		if (entries.empty()) continue;
+
+		// One pass per code range for all signatures, then a uniqueness check of each match
+		const auto ranges = image.SectionRanges(mem::SectionFilter::Code);
+		std::vector<const BYTE*> results(signatures.size());
+		for (const auto& range : ranges) mem::detail::FindPatterns(range.data(), range.size(), signatures, results, false);
+
+		std::vector<mem::ResolvedSignature> resolved;
+		for (size_t j = 0; j < entries.size(); j++)
+		{
+			if (!results[j])
+			{
+				std::fprintf(stderr, "%s: %s not found\n", fileName.c_str(), entries[j]->name);
+				nFailed++;
+				continue;
+			}
+
+			size_t nMatches = 0;
+			for (const auto& range : ranges) nMatches += mem::CountMatches(mem::PatternScanAll(const_cast<PBYTE>(range.data()), static_cast<DWORD>(range.size()), signatures[j]), 2);
+			if (nMatches > 1) std::fprintf(stderr, "%s: %s isn't unique, the first match is used\n", fileName.c_str(), entries[j]->name);
+
+			resolved.push_back({ mem::HashSignature(signatures[j], mem::SectionFilter::Code), image.PointerToRva(results[j]) });
+		}
+		if (resolved.empty()) continue;
+		std::ranges::sort(resolved, {}, &mem::ResolvedSignature::key);
+
+		const auto fingerprint = mem::ModuleFingerprint::FromImage(image);
+		const std::string table = Identifier(fileName) + "_signatures";
+
+		char line[160];
+		tables += "\tinline constexpr mem::ResolvedSignature " + table + "[]\n\t{\n";
+		for (const auto& [key, rva] : resolved)
+		{
+			std::snprintf(line, sizeof(line), "\t\t{ 0x%016llX, 0x%08X },\n", static_cast<unsigned long long>(key), static_cast<unsigned>(rva));
+			tables += line;
+		}
+		tables += "\t};\n\n";
+
+		std::snprintf(line, sizeof(line), "{ 0x%08X, 0x%08X, 0x%08X, 0x%016llX }", static_cast<unsigned>(fingerprint.timeDateStamp), static_cast<unsigned>(fingerprint.checkSum), static_cast<unsigned>(fingerprint.sizeOfImage), static_cast<unsigned long long>(fingerprint.codeHash));
+		modules += "\t\t{ \"" + fileName + "\", " + line + ", " + table + " },\n";
+	}
+
+	std::printf("\xEF\xBB\xBF#pragma once\n#include \"Mem/sigcache.h\"\n\n");
+	std::printf("// Signature RVAs precomputed for known module builds, regenerate it with tools/sigresolve.cpp instead of editing it.\n");
+	std::printf("// Entries are only used while the module fingerprint matches, patterns are scanned as usual otherwise.\n");
+	std::printf("namespace Signatures::Resolved\n{\n");
+	if (modules.empty())
+	{
+		std::printf("\tinline constexpr std::span<const mem::ResolvedModule> modules{};\n}\n");
+	}
+	else
+	{
+		std::printf("%s\tinline constexpr mem::ResolvedModule moduleTable[]\n\t{\n%s\t};\n\n", tables.c_str(), modules.c_str());
+		std::printf("\tinline constexpr std::span<const mem::ResolvedModule> modules = moduleTable;\n}\n");
+	}
+	return nFailed ? 2 : 0;
+}
@@ -0,0 +1,117 @@
+﻿// mem::StringReferences on PE32+ and PE32 images, in the file layout and as mapped: ASCII and UTF-16 literals of .rdata found through
+// lea/mov [rip + disp32] (x64) and push/mov imm32 (x86) in .text, strings without references and too short ones. make -C tools test
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include "Mem/strref.h"
+#include "fakepe.h"
+#include "test.h"
+
+namespace
+{
+	constexpr DWORD code = IMAGE_SCN_CNT_CODE | IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_MEM_READ;
+	constexpr DWORD readOnlyData = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ;
+
+	constexpr DWORD textRva = 0x1000;
+	constexpr DWORD rdataRva = 0x2000;
+
+	// String RVAs in .rdata
+	constexpr DWORD presentRva = rdataRva + 0x10;		// "Present failed"
+	constexpr DWORD resizeRva = rdataRva + 0x40;		// L"Resize buffers"
+	constexpr DWORD unreferencedRva = rdataRva + 0x80;	// "unreferenced string"
+	constexpr DWORD shortRva = rdataRva + 0xC0;			// "abc", under the minimum length
+
+	// Instruction RVAs in .text, and the string each one references
+	struct Reference
+	{
+		DWORD rva;
+		std::vector<BYTE> opcode;	// Bytes before the 32-bit operand
+		DWORD string;
+	};
+
+	std::vector<BYTE> Rdata()
+	{
+		std::vector<BYTE> rdata(0x1000, 0);
+		const auto put = [&](const DWORD rva, const std::string_view text, const bool bWide)
+		{
+			for (size_t i = 0; i < text.size(); i++) rdata[rva - rdataRva + (bWide ? i * 2 : i)] = static_cast<BYTE>(text[i]);
+		};
+		put(presentRva, "Present failed", false);
+		put(resizeRva, "Resize buffers", true);
+		put(unreferencedRva, "unreferenced string", false);
+		put(shortRva, "abc", false);
+		return rdata;
+	}
+
+	fakepe::Image BuildImage(const bool bIs64, const std::vector<Reference>& references)
+	{
+		std::vector<BYTE> text(0x1000, 0xCC);
+		for (const auto& reference : references)
+		{
+			const DWORD operandRva = reference.rva + static_cast<DWORD>(reference.opcode.size());
+			const DWORD operand = bIs64 ? reference.string - (operandRva + 4) : 0x400000 + reference.string;
+			std::ranges::copy(reference.opcode, text.begin() + (reference.rva - textRva));
+			std::memcpy(&text[operandRva - textRva], &operand, sizeof(operand));
+		}
+		const fakepe::Section sections[] = { { ".text", code, std::move(text) }, { ".rdata", readOnlyData, Rdata() } };
+		return fakepe::Build(bIs64, sections);
+	}
+
+	void Check(const bool bIs64, const std::vector<Reference>& references)
+	{
+		const auto module = BuildImage(bIs64, references);
+		for (const bool bFile : { true, false })
+		{
+			const auto& bytes = bFile ? module.file : module.mapped;
+			const mem::PEView image(bytes.data(), bytes.size(), bFile ? mem::ImageLayout::File : mem::ImageLayout::Mapped);
+			const mem::StringReferences strings(image);
+			const auto at = [&](const DWORD rva) { return image.RvaToPointer(rva); };
+
+			CHECK(strings.Size() == 2);
+			CHECK(strings.FindFirst("Present failed") == at(textRva + 0x100));
+			const auto present = strings.Find("Present failed");
+			CHECK(present.size() == 2 && present[1] == at(textRva + 0x300));
+
+			// UTF-16, looked up by its ASCII text
+			const auto resize = strings.Find("Resize buffers");
+			CHECK(resize.size() == 2 && resize[0] == at(textRva + 0x200) && resize[1] == at(textRva + 0x400));
+
+			CHECK(strings.Find("unreferenced string").empty() && !strings.FindFirst("unreferenced string"));
+			CHECK(!strings.FindFirst("abc") && !strings.FindFirst("Present"));
+			CHECK(mem::StringReferences(image, 3).FindFirst("abc") == at(textRva + 0x500));
+		}
+	}
+
+	void X64()
+	{
+		Check(true, {
+			{ textRva + 0x100, { 0x48, 0x8D, 0x0D }, presentRva },		// lea rcx, [rip + disp32]
+			{ textRva + 0x200, { 0x48, 0x8D, 0x15 }, resizeRva },		// lea rdx, [rip + disp32]
+			{ textRva + 0x300, { 0x4C, 0x8D, 0x05 }, presentRva },		// lea r8, [rip + disp32]
+			{ textRva + 0x400, { 0x8B, 0x05 }, resizeRva },				// mov eax, [rip + disp32], no REX
+			{ textRva + 0x500, { 0x48, 0x8D, 0x0D }, shortRva },
+			{ textRva + 0x600, { 0x48, 0x8D, 0x0D }, unreferencedRva + 1 },	// Inside a string, not a reference to it
+		});
+	}
+
+	void X86()
+	{
+		Check(false, {
+			{ textRva + 0x100, { 0x68 }, presentRva },	// push imm32
+			{ textRva + 0x200, { 0xB9 }, resizeRva },	// mov ecx, imm32
+			{ textRva + 0x300, { 0x68 }, presentRva },
+			{ textRva + 0x400, { 0xBA }, resizeRva },	// mov edx, imm32
+			{ textRva + 0x500, { 0x68 }, shortRva },
+			{ textRva + 0x600, { 0x68 }, unreferencedRva + 1 },
+		});
+	}
+}
+
+int main()
+{
+	X64();
+	X86();
+	return test::Result();
+}
@@ -0,0 +1,24 @@
+﻿#pragma once
+// Checks for the tools/*test.cpp programs: failures are printed and counted, main returns test::Result()
+#include <cstdio>
+
+namespace test
+{
+	inline int failures = 0;
+
+	inline void Check(const bool bPassed, const char* expression, const char* file, const int line)
+	{
+		if (bPassed) return;
+		std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, expression);
+		failures++;
+	}
+
+	inline int Result()
+	{
+		if (failures) std::fprintf(stderr, "%d check(s) failed\n", failures);
+		else std::puts("ok");
+		return failures ? 1 : 0;
+	}
+}
+
+#define CHECK(expression) test::Check(static_cast<bool>(expression), #expression, __FILE__, __LINE__)
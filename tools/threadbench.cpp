@@ -0,0 +1,45 @@
+﻿// Scaling of mem::detail::FindPatternParallel from 1 to 8 threads over a large synthetic code-like buffer (512 MB by default),
+// with the match near the end (whole buffer scanned) and at 10% (later chunks cancelled). make -C tools build/threadbench [MB]
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "Mem/mem.h"
+#include "../src/signatures.h"
+#include "bench.h"
+
+int main(int argc, char** argv)
+{
+	const size_t nSize = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 512) << 20;
+	auto buffer = bench::CodeLikeBuffer(nSize);
+	const mem::SignatureView signature = Signatures::Steam::x64::d3d_present_pattern;
+
+	std::printf("%zu MB, %u hardware threads\n", nSize >> 20, std::thread::hardware_concurrency());
+
+	bool bSame = true;
+	for (const double position : { 0.999, 0.1 })
+	{
+		const size_t offset = static_cast<size_t>(nSize * position);
+		bench::Plant(buffer, offset, signature);
+		const BYTE* pExpected = mem::detail::FindPattern(buffer.data(), nSize, signature, false);
+
+		std::printf("match at %.1f%%:\n%8s %10s %8s %8s\n", position * 100, "threads", "ms", "GB/s", "speedup");
+		double single = 0;
+		for (const unsigned nThreads : { 1u, 2u, 4u, 8u })
+		{
+			const BYTE* pMatch = nullptr;
+			const double seconds = bench::Time([&] { pMatch = mem::detail::FindPatternParallel(buffer.data(), nSize, signature, false, nThreads); });
+			if (nThreads == 1) single = seconds;
+
+			std::printf("%8u %10.1f %8.2f %7.2fx", nThreads, seconds * 1e3, bench::GBps(offset, seconds), single / seconds);
+			if (pMatch != pExpected)
+			{
+				std::printf(" (mismatch)");
+				bSame = false;
+			}
+			std::printf("\n");
+		}
+	}
+	std::printf(bSame ? "every thread count returned the lowest match\n" : "thread counts disagree\n");
+	return bSame ? 0 : 1;
+}
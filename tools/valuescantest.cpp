@@ -0,0 +1,175 @@
+﻿// mem::ValueScanner against this process: int32, float and double values planted in an mmap'd buffer, found by FirstScan
+// (Exact, Range) and filtered by NextScan (Exact, Changed, Unchanged, Increased, Decreased). Only results inside the buffer are
+// checked, the rest of the process may hold the same values. Linux: make -C tools test
+#include <cstring>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "Mem/valuescan.h"
+#include "test.h"
+
+namespace
+{
+	constexpr size_t nPages = 16;
+	constexpr size_t pageSize = 4096;
+
+	struct Buffer
+	{
+		std::uint8_t* p = nullptr;
+
+		Buffer()
+		{
+			void* pMapping = mmap(nullptr, nPages * pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (pMapping != MAP_FAILED) p = static_cast<std::uint8_t*>(pMapping);
+		}
+		~Buffer() { if (p) munmap(p, nPages * pageSize); }
+
+		template<typename T>
+		void Set(const size_t offset, const T value) { std::memcpy(p + offset, &value, sizeof(T)); }
+		[[nodiscard]] std::uintptr_t Address(const size_t offset) const { return reinterpret_cast<std::uintptr_t>(p + offset); }
+	};
+
+	// Results of the last scan inside the buffer, by address
+	std::vector<mem::ScanResult> InBuffer(const mem::ValueScanner& scanner, const Buffer& buffer)
+	{
+		std::vector<mem::ScanResult> results;
+		for (const auto& result : scanner.Results(SIZE_MAX))
+		{
+			if (result.address >= buffer.Address(0) && result.address < buffer.Address(nPages * pageSize)) results.push_back(result);
+		}
+		return results;
+	}
+
+	bool SameAddresses(const std::vector<mem::ScanResult>& results, const Buffer& buffer, const std::vector<size_t>& offsets)
+	{
+		if (results.size() != offsets.size()) return false;
+		for (size_t i = 0; i < results.size(); i++) if (results[i].address != buffer.Address(offsets[i])) return false;
+		return true;
+	}
+
+	void Int32()
+	{
+		Buffer buffer;
+		CHECK(buffer.p);
+		if (!buffer.p) return;
+
+		constexpr std::int32_t value = 0x5EED1234;
+		const std::vector<size_t> offsets = { 0, 400, 2 * pageSize + pageSize - 4, 3 * pageSize + 8 };
+		for (const size_t offset : offsets) buffer.Set(offset, value);
+		buffer.Set(5 * pageSize + 2, value);	// Unaligned, not a candidate
+
+		mem::ValueScanner scanner;
+		CHECK(scanner.FirstScan({ mem::ValueType::Int32, mem::ScanCompare::Exact, value }) >= offsets.size());
+		auto results = InBuffer(scanner, buffer);
+		CHECK(SameAddresses(results, buffer, offsets));
+		for (const auto& result : results) CHECK(result.value.integer == value);
+
+		// Changed and Increased compare with the value of an Exact scan, which isn't stored per candidate
+		buffer.Set(400, value + 5);
+		buffer.Set(3 * pageSize + 8, value - 3);
+		scanner.NextScan({ mem::ValueType::Int32, mem::ScanCompare::Changed });
+		results = InBuffer(scanner, buffer);
+		CHECK(SameAddresses(results, buffer, { 400, 3 * pageSize + 8 }));
+		CHECK(results.size() == 2 && results[0].value.integer == value + 5 && results[1].value.integer == value - 3);
+
+		buffer.Set(400, value + 6);
+		scanner.NextScan({ mem::ValueType::Int32, mem::ScanCompare::Increased });
+		results = InBuffer(scanner, buffer);
+		CHECK(SameAddresses(results, buffer, { 400 }) && results[0].value.integer == value + 6);
+
+		scanner.NextScan({ mem::ValueType::Int32, mem::ScanCompare::Unchanged });
+		CHECK(SameAddresses(InBuffer(scanner, buffer), buffer, { 400 }));
+
+		scanner.NextScan({ mem::ValueType::Int32, mem::ScanCompare::Exact, value });
+		CHECK(InBuffer(scanner, buffer).empty());
+
+		scanner.Reset();
+		CHECK(!scanner.HasScanned() && scanner.Count() == 0 && scanner.Results().empty());
+	}
+
+	void Float()
+	{
+		Buffer buffer;
+		CHECK(buffer.p);
+		if (!buffer.p) return;
+
+		// Range is inclusive on both ends
+		buffer.Set(pageSize + 16, 1.75f);
+		buffer.Set(pageSize + 20, 2.5f);
+		buffer.Set(pageSize + 24, 3.0f);
+		buffer.Set(pageSize + 28, 1.49f);
+		buffer.Set(7 * pageSize, 1.5f);
+
+		mem::ValueScanner scanner;
+		scanner.FirstScan({ mem::ValueType::Float, mem::ScanCompare::Range, 1.5f, 2.5f });
+		auto results = InBuffer(scanner, buffer);
+		CHECK(SameAddresses(results, buffer, { pageSize + 16, pageSize + 20, 7 * pageSize }));
+		CHECK(results.size() == 3 && results[0].value.real == 1.75 && results[1].value.real == 2.5);
+
+		buffer.Set(pageSize + 16, 2.0f);
+		buffer.Set(7 * pageSize, 1.0f);
+		scanner.NextScan({ mem::ValueType::Float, mem::ScanCompare::Increased });
+		results = InBuffer(scanner, buffer);
+		CHECK(SameAddresses(results, buffer, { pageSize + 16 }) && results[0].value.real == 2.0);
+	}
+
+	void Double()
+	{
+		Buffer buffer;
+		CHECK(buffer.p);
+		if (!buffer.p) return;
+
+		constexpr double value = 12345.678;
+		for (const size_t offset : { size_t{ 8 }, 4 * pageSize + 64, 9 * pageSize + pageSize - 8 }) buffer.Set(offset, value);
+
+		mem::ValueScanner scanner;
+		scanner.FirstScan({ mem::ValueType::Double, mem::ScanCompare::Exact, value });
+		CHECK(SameAddresses(InBuffer(scanner, buffer), buffer, { 8, 4 * pageSize + 64, 9 * pageSize + pageSize - 8 }));
+
+		buffer.Set(4 * pageSize + 64, value - 0.5);
+		scanner.NextScan({ mem::ValueType::Double, mem::ScanCompare::Decreased });
+		const auto results = InBuffer(scanner, buffer);
+		CHECK(SameAddresses(results, buffer, { 4 * pageSize + 64 }) && results[0].value.real == value - 0.5);
+	}
+
+	// Dense Exact matches cost their positions only: 16 full pages of int64 candidates in far less than 8 bytes each
+	void ExactMemory()
+	{
+		Buffer buffer;
+		CHECK(buffer.p);
+		if (!buffer.p) return;
+
+		constexpr std::int64_t value = 0x1122334455667788;
+		for (size_t offset = 0; offset < nPages * pageSize; offset += sizeof(value)) buffer.Set(offset, value);
+
+		mem::ValueScanner scanner;
+		const size_t count = scanner.FirstScan({ mem::ValueType::Int64, mem::ScanCompare::Exact, value });
+		CHECK(count >= nPages * pageSize / sizeof(value));
+		CHECK(scanner.MemoryUsage() < count * sizeof(value) / 4);
+		CHECK(InBuffer(scanner, buffer).size() == nPages * pageSize / sizeof(value));
+
+		// The next non-Exact scan stores the values again
+		buffer.Set(pageSize, value + 1);
+		scanner.NextScan({ mem::ValueType::Int64, mem::ScanCompare::Unchanged });
+		const auto results = InBuffer(scanner, buffer);
+		CHECK(results.size() == nPages * pageSize / sizeof(value) - 1);
+		CHECK(!results.empty() && results.back().value.integer == value);
+		CHECK(scanner.MemoryUsage() >= scanner.Count() * sizeof(value));
+	}
+}
+
+int main()
+{
+	if (sysconf(_SC_PAGESIZE) != pageSize)
+	{
+		std::puts("skipped: 4 KB pages expected");
+		return 0;
+	}
+
+	Int32();
+	Float();
+	Double();
+	ExactMemory();
+	return test::Result();
+}